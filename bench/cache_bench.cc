@@ -0,0 +1,125 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "common/concurrent_cache.h"
+#include "common/map.h"
+#include "timer/timer.h"
+
+namespace {
+
+constexpr int kKeySpace = 1 << 18;
+constexpr int kCapacity = 1 << 14;
+constexpr int kTraceSize = 1 << 20;
+constexpr auto kTtl = std::chrono::seconds(1);
+
+using Cache = wzq::ConcurrentCache<int, int>;
+
+// 参数0.99的Zipf分布访问序列，所有用例共用同一份，每个线程从不同位置开始读
+const std::vector<int>& GetZipfTrace() {
+    static const std::vector<int>* trace = []() {
+        std::vector<double> cdf(kKeySpace);
+        double sum = 0;
+        for (int i = 0; i < kKeySpace; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i + 1), 0.99);
+            cdf[i] = sum;
+        }
+        std::mt19937_64 rng(42);
+        std::uniform_real_distribution<double> dist(0, sum);
+        // 排名打散到整个key空间，热点不会都落在同一段
+        std::vector<int> rank_to_key(kKeySpace);
+        for (int i = 0; i < kKeySpace; ++i) {
+            rank_to_key[i] = i;
+        }
+        std::shuffle(rank_to_key.begin(), rank_to_key.end(), rng);
+        auto* keys = new std::vector<int>(kTraceSize);
+        for (int& key : *keys) {
+            int rank = static_cast<int>(std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) - cdf.begin());
+            key = rank_to_key[std::min(rank, kKeySpace - 1)];
+        }
+        return keys;
+    }();
+    return *trace;
+}
+
+// 每种策略一个缓存，多线程用例的各个线程共用
+Cache& GetCache(Cache::Policy policy) {
+    static Cache* caches[2] = {nullptr, nullptr};
+    Cache*& cache = caches[static_cast<int>(policy)];
+    if (cache == nullptr) {
+        cache = new Cache(kCapacity, policy);
+    }
+    return *cache;
+}
+
+// 原来的做法：ThreadSafeMap存值，每个key一个定时器到期删除；两者都不析构，还没触发的定时器会访问map
+struct MapWithTimer {
+    wzq::ThreadSafeMap<int, int> map;
+    wzq::TimerQueue timer;
+
+    MapWithTimer() { timer.Run(); }
+};
+
+MapWithTimer& GetMapWithTimer() {
+    static auto* m = new MapWithTimer();
+    return *m;
+}
+
+// 读缓存，未命中时回源(这里直接用key当值)再放进去；hit_rate是各线程命中率的平均
+void BM_CacheZipf(benchmark::State& state) {
+    Cache& cache = GetCache(static_cast<Cache::Policy>(state.range(0)));
+    const std::vector<int>& trace = GetZipfTrace();
+    std::size_t pos = static_cast<std::size_t>(state.thread_index()) * (kTraceSize / 8);
+    int64_t hits = 0;
+    int value = 0;
+    for (auto _ : state) {
+        int key = trace[pos++ & (kTraceSize - 1)];
+        if (cache.Get(key, value)) {
+            ++hits;
+        } else {
+            cache.Put(key, key, kTtl);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_rate"] =
+        benchmark::Counter(static_cast<double>(hits) / std::max<int64_t>(state.iterations(), 1),
+                           benchmark::Counter::kAvgThreads);
+    if (state.thread_index() == 0) {
+        state.counters["size"] = static_cast<double>(cache.Size());
+    }
+}
+BENCHMARK(BM_CacheZipf)->ArgName("tinylfu")->Arg(0)->Arg(1)->ThreadRange(1, 8)->UseRealTime();
+
+// 同样的访问序列，map没有容量上限，只靠每个key的定时器在TTL后删除
+void BM_MapTimerZipf(benchmark::State& state) {
+    MapWithTimer& m = GetMapWithTimer();
+    const std::vector<int>& trace = GetZipfTrace();
+    std::size_t pos = static_cast<std::size_t>(state.thread_index()) * (kTraceSize / 8);
+    int64_t hits = 0;
+    int value = 0;
+    for (auto _ : state) {
+        int key = trace[pos++ & (kTraceSize - 1)];
+        if (m.map.GetValueFromKey(key, value)) {
+            ++hits;
+        } else {
+            m.map.Emplace(key, key);
+            m.timer.AddFuncAfterDuration(wzq::TimerQueue::ExecutionPolicy::Inline(), kTtl,
+                                         [&m, key]() { m.map.EraseKey(key); });
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_rate"] =
+        benchmark::Counter(static_cast<double>(hits) / std::max<int64_t>(state.iterations(), 1),
+                           benchmark::Counter::kAvgThreads);
+    if (state.thread_index() == 0) {
+        state.counters["size"] = static_cast<double>(m.map.Size());
+    }
+}
+BENCHMARK(BM_MapTimerZipf)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
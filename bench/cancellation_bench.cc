@@ -0,0 +1,114 @@
+#include <benchmark/benchmark.h>
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "thread/cancellation.h"
+#include "thread/thread_pool.h"
+
+namespace {
+
+// 整个进程共用一个线程池，启动线程的开销不算进测试里
+wzq::ThreadPool& GetPool() {
+    static wzq::ThreadPool* pool = []() {
+        auto* p = new wzq::ThreadPool(wzq::ThreadPool::ThreadPoolConfig{4, 4, 0, std::chrono::seconds(60)});
+        p->Start();
+        return p;
+    }();
+    return *pool;
+}
+
+double ProcessCpuMs() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+}
+
+void Work(std::atomic<int64_t>* executed, const wzq::CancellationToken& token) {
+    // 执行中的任务也轮询token，取消后提前结束
+    for (int i = 0; i < 20 && !token.IsCancelled(); ++i) {
+        auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(1);
+        while (std::chrono::steady_clock::now() < end) {
+        }
+    }
+    executed->fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * 64个客户端，每个客户端的请求分两个阶段各提交16个子任务(每个约20us)，一半客户端提交后马上断开。
+ * range(0)为1时断开的客户端取消自己的CancellationSource，两个阶段的子Source跟着取消；
+ * 为0时和原来一样所有子任务都执行完。counters里是整个进程的CPU时间和实际执行的子任务数
+ */
+void BM_ClientDisconnect(benchmark::State& state) {
+    constexpr int kClients = 64;
+    constexpr int kStages = 2;
+    constexpr int kTasksPerStage = 16;
+    const bool cancel = state.range(0) != 0;
+    wzq::ThreadPool& pool = GetPool();
+    std::atomic<int64_t> executed{0};
+    std::vector<std::shared_ptr<std::future<void>>> futures;
+    futures.reserve(kClients * kStages * kTasksPerStage);
+    double cpu_start = ProcessCpuMs();
+    for (auto _ : state) {
+        for (int c = 0; c < kClients; ++c) {
+            wzq::CancellationSource client;
+            for (int s = 0; s < kStages; ++s) {
+                wzq::CancellationSource stage(client.Token());
+                wzq::CancellationToken token = stage.Token();
+                for (int t = 0; t < kTasksPerStage; ++t) {
+                    futures.push_back(pool.Run(token, Work, &executed, token));
+                }
+            }
+            if (cancel && c % 2 == 0) {
+                client.Cancel();
+            }
+        }
+        for (auto& f : futures) {
+            try {
+                f->get();
+            } catch (const std::future_error&) {
+                // 被取消的任务
+            }
+        }
+        futures.clear();
+    }
+    state.counters["cpu_ms"] =
+        benchmark::Counter(ProcessCpuMs() - cpu_start, benchmark::Counter::kAvgIterations);
+    state.counters["executed"] = benchmark::Counter(static_cast<double>(executed.load()),
+                                                    benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ClientDisconnect)->ArgName("cancel")->Arg(0)->Arg(1)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+void BM_TokenPoll(benchmark::State& state) {
+    wzq::CancellationSource source;
+    wzq::CancellationToken token = source.Token();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(token.IsCancelled());
+    }
+}
+BENCHMARK(BM_TokenPoll);
+
+// 取消一个有range(0)个子节点的父节点
+void BM_CancelTree(benchmark::State& state) {
+    const int children = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        wzq::CancellationSource parent;
+        std::vector<wzq::CancellationSource> sources;
+        sources.reserve(children);
+        for (int i = 0; i < children; ++i) {
+            sources.emplace_back(parent.Token());
+        }
+        state.ResumeTiming();
+        parent.Cancel();
+    }
+    state.SetItemsProcessed(state.iterations() * children);
+}
+BENCHMARK(BM_CancelTree)->Arg(16)->Arg(1024);
+
+}  // namespace
@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <future>
+#include <string>
+#include <vector>
+
+#include "common/cmd.h"
+#include "common/process_pool.h"
+
+namespace {
+
+// 原来基于popen的实现，作为对比
+std::string PopenRunCmd(const std::string& cmd) {
+    std::string ret;
+    char buffer[256];
+    FILE* fdp = popen(cmd.c_str(), "r");
+    if (fdp) {
+        while (fgets(buffer, sizeof(buffer), fdp)) {
+            ret.append(buffer, strlen(buffer));
+        }
+        pclose(fdp);
+    }
+    return ret;
+}
+
+const char kCmd[] = "echo hello";
+
+void BM_Popen(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(PopenRunCmd(kCmd));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Popen)->UseRealTime();
+
+void BM_SpawnShell(benchmark::State& state) {
+    wzq::CommandOptions options;
+    options.force_shell = true;
+    for (auto _ : state) {
+        std::string out;
+        wzq::Command::Run(
+            kCmd, [&out](const char* data, std::size_t len) { out.append(data, len); }, nullptr, options);
+        benchmark::DoNotOptimize(out);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpawnShell)->UseRealTime();
+
+void BM_SpawnDirect(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(wzq::Command::RunCmd(kCmd));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SpawnDirect)->UseRealTime();
+
+// 同时有range(0)个命令在跑，调用线程只负责提交和等待
+void BM_SpawnAsync(benchmark::State& state) {
+    const int batch = static_cast<int>(state.range(0));
+    std::vector<std::future<wzq::CommandResult>> futures(batch);
+    for (auto _ : state) {
+        for (auto& f : futures) {
+            f = wzq::Command::RunAsync(kCmd, nullptr);
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_SpawnAsync)->Arg(16)->UseRealTime();
+
+// 常驻的cat进程，每次调用只是一来一回两次管道读写
+void BM_ProcessPool(benchmark::State& state) {
+    static wzq::ProcessPool pool({"cat"}, 4);
+    if (state.thread_index() == 0) {
+        pool.Start();
+    }
+    std::string response;
+    for (auto _ : state) {
+        pool.Call("hello", response);
+        benchmark::DoNotOptimize(response);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ProcessPool)->ThreadRange(1, 4)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,48 @@
+#include <benchmark/benchmark.h>
+
+#include "common/defer.h"
+
+namespace {
+
+// 捕获四个引用，超出std::function的小对象缓冲，原来的实现每次都会堆分配
+void BM_ExecuteOnScopeExit(benchmark::State& state) {
+    int a = 0, b = 0, c = 0, d = 0;
+    for (auto _ : state) {
+        wzq::ExecuteOnScopeExit guard([&]() {
+            ++a;
+            ++b;
+            ++c;
+            ++d;
+        });
+        benchmark::ClobberMemory();
+    }
+    benchmark::DoNotOptimize(a + b + c + d);
+}
+BENCHMARK(BM_ExecuteOnScopeExit);
+
+void BM_Defer(benchmark::State& state) {
+    int a = 0, b = 0, c = 0, d = 0;
+    for (auto _ : state) {
+        WZQ_DEFER {
+            ++a;
+            ++b;
+            ++c;
+            ++d;
+        };
+        benchmark::ClobberMemory();
+    }
+    benchmark::DoNotOptimize(a + b + c + d);
+}
+BENCHMARK(BM_Defer);
+
+void BM_DeferFail(benchmark::State& state) {
+    int a = 0;
+    for (auto _ : state) {
+        WZQ_DEFER_FAIL { ++a; };
+        benchmark::ClobberMemory();
+    }
+    benchmark::DoNotOptimize(a);
+}
+BENCHMARK(BM_DeferFail);
+
+}  // namespace
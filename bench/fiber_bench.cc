@@ -0,0 +1,175 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread/count_down_latch.h"
+#include "thread/fiber.h"
+#include "thread/semaphore.h"
+#include "thread/thread_pool.h"
+#include "timer/timer.h"
+
+namespace {
+
+constexpr auto kBlockTime = std::chrono::milliseconds(10);
+
+wzq::ThreadPool& GetPool(int threads) {
+    static std::mutex mutex;
+    static auto* pools = new std::map<int, wzq::ThreadPool*>();
+    std::unique_lock<std::mutex> lock(mutex);
+    wzq::ThreadPool*& pool = (*pools)[threads];
+    if (pool == nullptr) {
+        pool = new wzq::ThreadPool(wzq::ThreadPool::ThreadPoolConfig{threads, threads, 0, std::chrono::seconds(60)});
+        pool->Start();
+    }
+    return *pool;
+}
+
+wzq::TimerQueue& GetTimerQueue() {
+    static auto* queue = []() {
+        auto* q = new wzq::TimerQueue();
+        q->Run();
+        return q;
+    }();
+    return *queue;
+}
+
+// fiber切出去再切回来一次：挂起、投递到线程池、工作线程恢复它，单线程线程池上没有竞争
+void BM_FiberYield(benchmark::State& state) {
+    wzq::FiberScheduler scheduler(GetPool(1));
+    scheduler.Spawn([&state]() {
+        for (auto _ : state) {
+            wzq::Fiber::Yield();
+        }
+    });
+    scheduler.Join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FiberYield)->UseRealTime();
+
+// 两个fiber用FiberMutex轮流持有锁，每次交接都有一次挂起和唤醒
+void BM_FiberMutexHandoff(benchmark::State& state) {
+    wzq::FiberScheduler scheduler(GetPool(1));
+    wzq::FiberMutex mutex;
+    bool stop = false;
+    scheduler.Spawn([&]() {
+        for (auto _ : state) {
+            mutex.Lock();
+            wzq::Fiber::Yield();
+            mutex.Unlock();
+        }
+        stop = true;
+    });
+    scheduler.Spawn([&]() {
+        for (;;) {
+            mutex.Lock();
+            bool done = stop;
+            mutex.Unlock();
+            if (done) {
+                break;
+            }
+            wzq::Fiber::Yield();
+        }
+    });
+    scheduler.Join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FiberMutexHandoff)->UseRealTime();
+
+// 对照：两个线程用信号量来回交接一次，每次都是一次futex唤醒加一次线程切换
+void BM_ThreadPingPong(benchmark::State& state) {
+    wzq::Semaphore ping(0);
+    wzq::Semaphore pong(0);
+    bool stop = false;
+    std::thread peer([&]() {
+        for (;;) {
+            ping.Acquire();
+            if (stop) {
+                break;
+            }
+            pong.Release();
+        }
+    });
+    for (auto _ : state) {
+        ping.Release();
+        pong.Acquire();
+    }
+    stop = true;
+    ping.Release();
+    peer.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadPingPong)->UseRealTime();
+
+/**
+ * range(0)个请求同时到达，每个请求同步地阻塞kBlockTime(模拟下游调用)，测全部完成的时间。
+ * fiber版本跑在4个线程的线程池上，阻塞用TimerQueue::SleepFor只挂起fiber
+ */
+void BM_FiberBlockedRequests(benchmark::State& state) {
+    const int requests = static_cast<int>(state.range(0));
+    wzq::FiberScheduler scheduler(GetPool(4), 16 * 1024);
+    wzq::TimerQueue& timer = GetTimerQueue();
+    for (auto _ : state) {
+        wzq::CountDownLatch done(requests);
+        for (int i = 0; i < requests; ++i) {
+            scheduler.Spawn([&]() {
+                timer.SleepFor(kBlockTime);
+                done.CountDown();
+            });
+        }
+        done.Await();
+    }
+    state.SetItemsProcessed(state.iterations() * requests);
+}
+BENCHMARK(BM_FiberBlockedRequests)
+    ->ArgName("requests")
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// 对照：同样的请求直接作为任务放进线程池，阻塞占住工作线程，并发数就是线程数range(1)
+void BM_PoolBlockedRequests(benchmark::State& state) {
+    const int requests = static_cast<int>(state.range(0));
+    wzq::ThreadPool& pool = GetPool(static_cast<int>(state.range(1)));
+    for (auto _ : state) {
+        wzq::CountDownLatch done(requests);
+        for (int i = 0; i < requests; ++i) {
+            pool.Post([&]() {
+                std::this_thread::sleep_for(kBlockTime);
+                done.CountDown();
+            });
+        }
+        done.Await();
+    }
+    state.SetItemsProcessed(state.iterations() * requests);
+}
+BENCHMARK(BM_PoolBlockedRequests)
+    ->ArgNames({"requests", "threads"})
+    ->ArgsProduct({{100, 1000}, {4, 64}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// 对照：每个请求一个线程，并发没有上限，但每个请求都要创建和销毁一个线程
+void BM_ThreadPerRequest(benchmark::State& state) {
+    const int requests = static_cast<int>(state.range(0));
+    std::vector<std::thread> threads;
+    threads.reserve(requests);
+    for (auto _ : state) {
+        for (int i = 0; i < requests; ++i) {
+            threads.emplace_back([]() { std::this_thread::sleep_for(kBlockTime); });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        threads.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * requests);
+}
+BENCHMARK(BM_ThreadPerRequest)->ArgName("requests")->Arg(100)->Arg(1000)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+}  // namespace
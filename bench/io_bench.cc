@@ -0,0 +1,161 @@
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "thread/count_down_latch.h"
+#include "thread/io_executor.h"
+#include "thread/thread_pool.h"
+
+namespace {
+
+constexpr std::size_t kBlockSize = 4096;
+constexpr std::size_t kFileBlocks = 4096;  // 16MB，读第一遍之后都在页缓存里
+constexpr int kBatch = 256;
+
+// 临时文件只建一次，建好就unlink，进程退出时自动删除
+int GetFile() {
+    static int fd = []() {
+        char path[] = "/tmp/wzq_io_benchXXXXXX";
+        int fd = mkstemp(path);
+        unlink(path);
+        std::vector<char> block(kBlockSize, 'x');
+        for (std::size_t i = 0; i < kFileBlocks; ++i) {
+            ssize_t ret = pwrite(fd, block.data(), block.size(), static_cast<off_t>(i * kBlockSize));
+            (void)ret;
+        }
+        return fd;
+    }();
+    return fd;
+}
+
+wzq::ThreadPool& GetPool(int threads) {
+    static std::mutex mutex;
+    static auto* pools = new std::map<int, wzq::ThreadPool*>();
+    std::unique_lock<std::mutex> lock(mutex);
+    wzq::ThreadPool*& pool = (*pools)[threads];
+    if (pool == nullptr) {
+        pool = new wzq::ThreadPool(wzq::ThreadPool::ThreadPoolConfig{threads, threads, 0, std::chrono::seconds(60)});
+        pool->Start();
+    }
+    return *pool;
+}
+
+uint32_t XorShift(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * 每轮随机读kBatch个4KB块再全部等完，items/s就是IOPS。
+ * worker_busy是线程池线程忙的时间占比(任务耗时之和 / (线程数 * 总时间))：
+ * 阻塞读的线程整段时间都被pread占着，用IoExecutor时线程池只跑完成回调
+ */
+void BM_FileReadBlockingPool(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    wzq::ThreadPool& pool = GetPool(threads);
+    const int fd = GetFile();
+    std::vector<char> buffers(kBatch * kBlockSize);
+    std::atomic<int64_t> busy_ns{0};
+    uint32_t seed = 0x9e3779b9u;
+    const int64_t start = NowNs();
+    for (auto _ : state) {
+        wzq::CountDownLatch latch(kBatch);
+        for (int i = 0; i < kBatch; ++i) {
+            char* buf = buffers.data() + i * kBlockSize;
+            off_t offset = static_cast<off_t>(XorShift(seed) % kFileBlocks * kBlockSize);
+            pool.Post([&, buf, offset]() {
+                int64_t begin = NowNs();
+                benchmark::DoNotOptimize(pread(fd, buf, kBlockSize, offset));
+                busy_ns.fetch_add(NowNs() - begin, std::memory_order_relaxed);
+                latch.CountDown();
+            });
+        }
+        latch.Await();
+    }
+    const int64_t wall = NowNs() - start;
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    state.counters["worker_busy"] = static_cast<double>(busy_ns.load()) / (static_cast<double>(wall) * threads);
+}
+BENCHMARK(BM_FileReadBlockingPool)->ArgName("threads")->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+void BM_FileReadIoExecutor(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    wzq::ThreadPool& pool = GetPool(threads);
+    wzq::IoExecutor::Options options;
+    options.completion_pool = &pool;
+    wzq::IoExecutor io(options);
+    if (io.GetBackend() != wzq::IoExecutor::Backend::kIoUring) {
+        state.SkipWithError("io_uring not available");
+        return;
+    }
+    const int fd = GetFile();
+    std::vector<char> buffers(kBatch * kBlockSize);
+    std::atomic<int64_t> busy_ns{0};
+    uint32_t seed = 0x9e3779b9u;
+    const int64_t start = NowNs();
+    for (auto _ : state) {
+        wzq::CountDownLatch latch(kBatch);
+        for (int i = 0; i < kBatch; ++i) {
+            char* buf = buffers.data() + i * kBlockSize;
+            int64_t offset = static_cast<int64_t>(XorShift(seed) % kFileBlocks * kBlockSize);
+            io.Read(fd, buf, kBlockSize, offset, [&](int64_t result) {
+                int64_t begin = NowNs();
+                benchmark::DoNotOptimize(result);
+                busy_ns.fetch_add(NowNs() - begin, std::memory_order_relaxed);
+                latch.CountDown();
+            });
+        }
+        latch.Await();
+    }
+    const int64_t wall = NowNs() - start;
+    state.SetItemsProcessed(state.iterations() * kBatch);
+    state.counters["worker_busy"] = static_cast<double>(busy_ns.load()) / (static_cast<double>(wall) * threads);
+}
+BENCHMARK(BM_FileReadIoExecutor)->ArgName("threads")->Arg(1)->Arg(4)->Arg(16)->UseRealTime();
+
+// 用注册过的缓冲区读，省掉每次的页面映射
+void BM_FileReadFixedIoExecutor(benchmark::State& state) {
+    std::vector<char> buffers(kBatch * kBlockSize);
+    wzq::IoExecutor::Options options;
+    options.fixed_buffers = {iovec{buffers.data(), buffers.size()}};
+    wzq::IoExecutor io(options);
+    if (io.GetBackend() != wzq::IoExecutor::Backend::kIoUring) {
+        state.SkipWithError("io_uring not available");
+        return;
+    }
+    const int fd = GetFile();
+    if (!io.FixedBuffersRegistered()) {
+        state.SkipWithError("register buffers failed");
+        return;
+    }
+    uint32_t seed = 0x9e3779b9u;
+    for (auto _ : state) {
+        wzq::CountDownLatch latch(kBatch);
+        for (int i = 0; i < kBatch; ++i) {
+            char* buf = buffers.data() + i * kBlockSize;
+            int64_t offset = static_cast<int64_t>(XorShift(seed) % kFileBlocks * kBlockSize);
+            io.ReadFixed(fd, buf, kBlockSize, offset, 0, [&latch](int64_t) { latch.CountDown(); });
+        }
+        latch.Await();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_FileReadFixedIoExecutor)->UseRealTime();
+
+}  // namespace
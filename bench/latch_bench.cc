@@ -0,0 +1,109 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "thread/barrier.h"
+#include "thread/count_down_latch.h"
+#include "thread/semaphore.h"
+
+namespace {
+
+// 原来基于mutex+condition_variable的实现，作为对比
+class MutexCountDownLatch {
+   public:
+    explicit MutexCountDownLatch(uint32_t count) : count_(count) {}
+
+    void CountDown() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        --count_;
+        if (count_ == 0) {
+            cv_.notify_all();
+        }
+    }
+
+    void Await() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (count_ > 0) {
+            cv_.wait(lock);
+        }
+    }
+
+   private:
+    std::condition_variable cv_;
+    std::mutex mutex_;
+    uint32_t count_ = 0;
+};
+
+// CountDownLatch计数的上限(最高两位留给fiber等待标志)，测试期间不会减到0
+constexpr uint32_t kHugeCount = wzq::CountDownLatch::kMaxCount;
+
+// 多个线程同时CountDown同一个门闩，计数远没有到0
+template <typename Latch>
+void BM_CountDownContended(benchmark::State& state) {
+    static Latch* latch = nullptr;
+    if (state.thread_index() == 0) {
+        latch = new Latch(kHugeCount);
+    }
+    for (auto _ : state) {
+        latch->CountDown();
+    }
+    if (state.thread_index() == 0) {
+        delete latch;
+    }
+}
+BENCHMARK_TEMPLATE(BM_CountDownContended, MutexCountDownLatch)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_CountDownContended, wzq::CountDownLatch)->ThreadRange(1, 8)->UseRealTime();
+
+// 一个主线程等待range(0)个子任务，子任务由固定的4个线程完成
+template <typename Latch>
+void BM_FanIn(benchmark::State& state) {
+    const uint32_t tasks = static_cast<uint32_t>(state.range(0));
+    const int workers = 4;
+    for (auto _ : state) {
+        Latch latch(tasks);
+        std::vector<std::thread> threads;
+        for (int w = 0; w < workers; ++w) {
+            threads.emplace_back([&latch, tasks, w]() {
+                for (uint32_t i = w; i < tasks; i += workers) {
+                    latch.CountDown();
+                }
+            });
+        }
+        latch.Await();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tasks);
+}
+BENCHMARK_TEMPLATE(BM_FanIn, MutexCountDownLatch)->Arg(1000)->Arg(100000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_FanIn, wzq::CountDownLatch)->Arg(1000)->Arg(100000)->UseRealTime();
+
+void BM_BarrierRoundTrip(benchmark::State& state) {
+    static wzq::Barrier* barrier = nullptr;
+    if (state.thread_index() == 0) {
+        barrier = new wzq::Barrier(static_cast<uint32_t>(state.threads()));
+    }
+    for (auto _ : state) {
+        barrier->ArriveAndWait();
+    }
+    if (state.thread_index() == 0) {
+        delete barrier;
+    }
+}
+BENCHMARK(BM_BarrierRoundTrip)->Threads(2)->Threads(4)->UseRealTime();
+
+void BM_SemaphoreUncontended(benchmark::State& state) {
+    wzq::Semaphore sem(1);
+    for (auto _ : state) {
+        sem.Acquire();
+        sem.Release();
+    }
+}
+BENCHMARK(BM_SemaphoreUncontended);
+
+}  // namespace
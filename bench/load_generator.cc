@@ -0,0 +1,340 @@
+/**
+ * 开环压测：按预先生成的到达时刻(泊松/均匀/突发)向ThreadPool提交任务或向TimerQueue添加定时任务，
+ * 延迟从"计划开始时刻"算起，所以生成线程自己被拖慢时也会计入延迟，不会有协调遗漏。
+ *
+ * ./wzq_loadgen --target=pool --rate=20000 --duration=10 --threads=4 --service=exp:50
+ * ./wzq_loadgen --target=timer --rate=50000 --delay_ms=10 --dispatcher=timerfd
+ *
+ * 相同的--seed产生相同的到达序列和任务耗时
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/histogram.h"
+#include "thread/thread_pool.h"
+#include "timer/timer.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string target = "pool";       // pool | timer
+    std::string arrival = "poisson";   // poisson | uniform | bursty
+    std::string service = "fixed:10";  // fixed:us | exp:mean_us | bimodal:us1,us2,percent_of_us2
+    double rate = 10000;               // 每秒到达数
+    double duration = 5;               // 秒
+    int threads = 4;                   // 线程池核心线程数
+    int max_threads = 0;               // 0表示等于threads
+    int burst = 100;                   // bursty时每批的个数
+    std::string dispatcher = "futex";  // futex | timerfd，timer模式下的分发方式
+    int delay_ms = 10;                 // timer模式下定时任务的最大延迟，在[0, delay_ms]内均匀分布
+    int report_ms = 1000;              // 时间序列的输出间隔
+    uint64_t seed = 1;
+};
+
+void Usage(const char* name) {
+    std::fprintf(stderr,
+                 "usage: %s [--target=pool|timer] [--rate=N] [--duration=SEC] [--arrival=poisson|uniform|bursty]\n"
+                 "          [--burst=N] [--service=fixed:US|exp:US|bimodal:US1,US2,PERCENT] [--threads=N]\n"
+                 "          [--max_threads=N] [--dispatcher=futex|timerfd] [--delay_ms=N] [--report_ms=N]\n"
+                 "          [--seed=N]\n",
+                 name);
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == std::string::npos) {
+            return false;
+        }
+        std::string key = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (key == "target") {
+            options.target = value;
+        } else if (key == "arrival") {
+            options.arrival = value;
+        } else if (key == "service") {
+            options.service = value;
+        } else if (key == "rate") {
+            options.rate = std::atof(value.c_str());
+        } else if (key == "duration") {
+            options.duration = std::atof(value.c_str());
+        } else if (key == "threads") {
+            options.threads = std::atoi(value.c_str());
+        } else if (key == "max_threads") {
+            options.max_threads = std::atoi(value.c_str());
+        } else if (key == "burst") {
+            options.burst = std::atoi(value.c_str());
+        } else if (key == "dispatcher") {
+            options.dispatcher = value;
+        } else if (key == "delay_ms") {
+            options.delay_ms = std::atoi(value.c_str());
+        } else if (key == "report_ms") {
+            options.report_ms = std::atoi(value.c_str());
+        } else if (key == "seed") {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    if (options.max_threads < options.threads) {
+        options.max_threads = options.threads;
+    }
+    return options.rate > 0 && options.duration > 0 && options.threads > 0 && options.burst > 0 &&
+           options.report_ms > 0 && (options.target == "pool" || options.target == "timer") &&
+           (options.dispatcher == "futex" || options.dispatcher == "timerfd");
+}
+
+// 一次到达：计划开始时刻(相对起点)和任务耗时，timer模式下service是定时延迟
+struct Arrival {
+    int64_t start_ns;
+    int64_t service_ns;
+};
+
+class ServiceModel {
+   public:
+    bool Parse(const std::string& spec) {
+        std::size_t colon = spec.find(':');
+        if (colon == std::string::npos) {
+            return false;
+        }
+        kind_ = spec.substr(0, colon);
+        if (std::sscanf(spec.c_str() + colon + 1, "%lf,%lf,%lf", &a_, &b_, &percent_) < 1) {
+            return false;
+        }
+        return kind_ == "fixed" || kind_ == "exp" || kind_ == "bimodal";
+    }
+
+    int64_t Next(std::mt19937_64& rng) {
+        double us = a_;
+        if (kind_ == "exp") {
+            us = std::exponential_distribution<double>(1.0 / a_)(rng);
+        } else if (kind_ == "bimodal") {
+            us = std::uniform_real_distribution<double>(0, 100)(rng) < percent_ ? b_ : a_;
+        }
+        return static_cast<int64_t>(us * 1000);
+    }
+
+   private:
+    std::string kind_;
+    double a_ = 0;
+    double b_ = 0;
+    double percent_ = 0;
+};
+
+std::vector<Arrival> GenerateSchedule(const Options& options, ServiceModel& service) {
+    std::mt19937_64 rng(options.seed);
+    std::vector<Arrival> schedule;
+    schedule.reserve(static_cast<std::size_t>(options.rate * options.duration * 1.1));
+    const double end_ns = options.duration * 1e9;
+    const double interval_ns = 1e9 / options.rate;
+    std::exponential_distribution<double> poisson(1.0 / interval_ns);
+    std::exponential_distribution<double> burst_gap(1.0 / (interval_ns * options.burst));
+    std::uniform_int_distribution<int64_t> delay(0, static_cast<int64_t>(options.delay_ms) * 1000000);
+    double t = 0;
+    while (t < end_ns) {
+        int n = 1;
+        if (options.arrival == "poisson") {
+            t += poisson(rng);
+        } else if (options.arrival == "bursty") {
+            t += burst_gap(rng);
+            n = options.burst;
+        } else {
+            t += interval_ns;
+        }
+        for (int i = 0; i < n && t < end_ns; ++i) {
+            int64_t service_ns = options.target == "timer" ? delay(rng) : service.Next(rng);
+            schedule.push_back({static_cast<int64_t>(t), service_ns});
+        }
+    }
+    return schedule;
+}
+
+int64_t NowNs(Clock::time_point base) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - base).count();
+}
+
+void SpinFor(int64_t ns) {
+    auto end = Clock::now() + std::chrono::nanoseconds(ns);
+    while (Clock::now() < end) {
+    }
+}
+
+// 每个执行任务的线程一份直方图，压测结束后合并
+struct Recorder {
+    wzq::Histogram start_delay;  // 实际开始 - 计划开始
+    wzq::Histogram response;     // 完成 - 计划开始
+};
+
+class RecorderSet {
+   public:
+    Recorder& Local() {
+        thread_local Recorder* recorder = nullptr;
+        thread_local RecorderSet* owner = nullptr;
+        if (owner != this) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            recorders_.emplace_back(new Recorder());
+            recorder = recorders_.back().get();
+            owner = this;
+        }
+        return *recorder;
+    }
+
+    // 所有任务完成后调用
+    Recorder Merge() {
+        Recorder total;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (auto& r : recorders_) {
+            total.start_delay.Merge(r->start_delay);
+            total.response.Merge(r->response);
+        }
+        return total;
+    }
+
+   private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Recorder>> recorders_;
+};
+
+// 压测结束时直接_Exit，线程池和定时器不需要析构
+struct Target {
+    wzq::ThreadPool* pool = nullptr;
+    wzq::TimerQueue* timer = nullptr;
+};
+
+int Main(const Options& options) {
+    ServiceModel service;
+    if (options.target == "pool" && !service.Parse(options.service)) {
+        std::fprintf(stderr, "bad --service: %s\n", options.service.c_str());
+        return 1;
+    }
+    std::vector<Arrival> schedule = GenerateSchedule(options, service);
+
+    Target target;
+    if (options.target == "pool") {
+        target.pool = new wzq::ThreadPool(wzq::ThreadPool::ThreadPoolConfig{
+            options.threads, options.max_threads, 0, std::chrono::seconds(1)});
+        target.pool->Start();
+    } else {
+        target.timer = new wzq::TimerQueue(options.dispatcher == "timerfd" ? wzq::TimerQueue::DispatcherType::kTimerFd
+                                                                            : wzq::TimerQueue::DispatcherType::kFutex);
+        if (!target.timer->Run()) {
+            std::fprintf(stderr, "failed to start timer queue\n");
+            return 1;
+        }
+    }
+
+    std::printf("target=%s dispatcher=%s arrival=%s rate=%.0f/s duration=%.1fs scheduled=%zu seed=%llu\n",
+                options.target.c_str(), options.dispatcher.c_str(), options.arrival.c_str(), options.rate,
+                options.duration, schedule.size(),
+                static_cast<unsigned long long>(options.seed));
+
+    RecorderSet recorders;
+    std::atomic<uint64_t> completed{0};
+    std::atomic<bool> generating{true};
+    wzq::Histogram submit_lag;  // 生成线程自己落后计划的时间
+    const Clock::time_point base = Clock::now();
+
+    // 时间序列：每个间隔的完成数和线程池线程数
+    std::thread reporter([&]() {
+        uint64_t last = 0;
+        uint64_t due = 0;
+        int64_t next_ns = static_cast<int64_t>(options.report_ms) * 1000000;
+        std::printf("%8s %12s %10s %8s %8s\n", "time_s", "completed/s", "backlog", "threads", "waiting");
+        while (generating.load() || completed.load() < schedule.size()) {
+            int64_t now = NowNs(base);
+            if (now < next_ns) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(std::min<int64_t>(next_ns - now, 10000000)));
+                continue;
+            }
+            uint64_t done = completed.load();
+            while (due < schedule.size() && schedule[due].start_ns <= now) {
+                ++due;
+            }
+            std::printf("%8.2f %12.0f %10llu %8d %8d\n", now / 1e9,
+                        (done - last) * 1000.0 / options.report_ms,
+                        static_cast<unsigned long long>(due > done ? due - done : 0),
+                        target.pool ? target.pool->GetTotalThreadSize() : 0,
+                        target.pool ? target.pool->GetWaitingThreadSize() : 0);
+            last = done;
+            next_ns += static_cast<int64_t>(options.report_ms) * 1000000;
+        }
+    });
+
+    for (const Arrival& arrival : schedule) {
+        int64_t now = NowNs(base);
+        if (now < arrival.start_ns) {
+            // 大段时间sleep，最后一点自旋，保证按时提交
+            if (arrival.start_ns - now > 200000) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(arrival.start_ns - now - 100000));
+            }
+            while ((now = NowNs(base)) < arrival.start_ns) {
+            }
+        }
+        submit_lag.Record(now - arrival.start_ns);
+        if (target.pool) {
+            target.pool->Run([&recorders, &completed, base, arrival]() {
+                Recorder& recorder = recorders.Local();
+                recorder.start_delay.Record(NowNs(base) - arrival.start_ns);
+                SpinFor(arrival.service_ns);
+                recorder.response.Record(NowNs(base) - arrival.start_ns);
+                completed.fetch_add(1, std::memory_order_release);
+            });
+        } else {
+            // 计划到期时刻 = 计划添加时刻 + 延迟，迟到时间就是实际执行时刻减去它
+            int64_t fire_ns = arrival.start_ns + arrival.service_ns;
+            auto fire_at = wzq::TimerQueue::Clock::now() + std::chrono::nanoseconds(fire_ns - now);
+            target.timer->AddFuncAtTimePoint(fire_at, [&recorders, &completed, base, fire_ns]() {
+                Recorder& recorder = recorders.Local();
+                int64_t lateness = NowNs(base) - fire_ns;
+                recorder.start_delay.Record(lateness);
+                recorder.response.Record(lateness);
+                completed.fetch_add(1, std::memory_order_release);
+            });
+        }
+    }
+    int64_t generate_end_ns = NowNs(base);
+    generating.store(false);
+    while (completed.load(std::memory_order_acquire) < schedule.size()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    int64_t end_ns = NowNs(base);
+    reporter.join();
+
+    Recorder total = recorders.Merge();
+    std::printf("\nthroughput: offered=%.0f/s achieved=%.0f/s (generated in %.2fs, drained in %.2fs)\n",
+                schedule.size() / (generate_end_ns / 1e9), schedule.size() / (end_ns / 1e9), generate_end_ns / 1e9,
+                (end_ns - generate_end_ns) / 1e9);
+    std::printf("submit lag  (us): %s\n", submit_lag.Summary(1000).c_str());
+    if (target.pool) {
+        std::printf("start delay (us): %s\n", total.start_delay.Summary(1000).c_str());
+        std::printf("response    (us): %s\n", total.response.Summary(1000).c_str());
+    } else {
+        std::printf("lateness    (us): %s\n", total.start_delay.Summary(1000).c_str());
+    }
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        Usage(argv[0]);
+        return 1;
+    }
+    int ret = Main(options);
+    std::fflush(stdout);
+    // 不等线程池排空，直接退出进程，不走静态对象析构
+    std::_Exit(ret);
+}
@@ -0,0 +1,38 @@
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef WZQ_BENCH_VERSION
+#define WZQ_BENCH_VERSION "unknown"
+#endif
+
+// 没有指定--benchmark_out时，结果默认以JSON格式写到wzq_bench.json
+int main(int argc, char** argv) {
+    std::vector<char*> args(argv, argv + argc);
+    bool has_out = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--benchmark_out=", 16) == 0) {
+            has_out = true;
+        }
+    }
+    std::string out_arg = "--benchmark_out=wzq_bench.json";
+    std::string format_arg = "--benchmark_out_format=json";
+    if (!has_out) {
+        args.push_back(out_arg.data());
+        args.push_back(format_arg.data());
+    }
+    int new_argc = static_cast<int>(args.size());
+    benchmark::Initialize(&new_argc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(new_argc, args.data())) {
+        return 1;
+    }
+    benchmark::AddCustomContext("wzq_version", WZQ_BENCH_VERSION);
+
+    benchmark::ConsoleReporter reporter(benchmark::ConsoleReporter::OO_Tabular);
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+
+    benchmark::Shutdown();
+    return 0;
+}
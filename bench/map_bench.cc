@@ -0,0 +1,148 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "common/map.h"
+
+namespace {
+
+constexpr int kKeySpace = 1 << 16;
+
+// 所有线程共享一个预先填满的map
+wzq::ThreadSafeMap<int, int>& GetMap() {
+    static auto* map = []() {
+        auto* m = new wzq::ThreadSafeMap<int, int>();
+        for (int i = 0; i < kKeySpace; ++i) {
+            m->Emplace(i, i);
+        }
+        return m;
+    }();
+    return *map;
+}
+
+uint32_t XorShift(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// range(0)是读操作的百分比，其余是写；key在kKeySpace内均匀分布
+void BM_MapReadWriteMix(benchmark::State& state) {
+    wzq::ThreadSafeMap<int, int>& map = GetMap();
+    const uint32_t read_percent = static_cast<uint32_t>(state.range(0));
+    uint32_t seed = 0x9e3779b9u + static_cast<uint32_t>(state.thread_index()) * 7919u;
+    int value = 0;
+    for (auto _ : state) {
+        uint32_t r = XorShift(seed);
+        int key = static_cast<int>(r % kKeySpace);
+        if ((r >> 16) % 100 < read_percent) {
+            benchmark::DoNotOptimize(map.GetValueFromKey(key, value));
+        } else {
+            map.Emplace(key, key);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MapReadWriteMix)->ArgName("read%")->Arg(50)->Arg(90)->Arg(99)->ThreadRange(1, 8)->UseRealTime();
+
+// 插入再删除同一个key，测写路径上的分配和锁
+void BM_MapEmplaceErase(benchmark::State& state) {
+    wzq::ThreadSafeMap<int, int> map;
+    int key = 0;
+    for (auto _ : state) {
+        map.Emplace(key, key);
+        map.EraseKey(key);
+        key = (key + 1) & (kKeySpace - 1);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_MapEmplaceErase);
+
+std::vector<std::pair<int, int>> SortedEntries(int n) {
+    std::vector<std::pair<int, int>> kvs;
+    kvs.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        kvs.emplace_back(i, i);
+    }
+    return kvs;
+}
+
+// 刷新整张表的几种方式，range(0)是条目数：逐个Emplace、一次MultiPut、BulkLoad整体替换
+void BM_MapRefreshEmplace(benchmark::State& state) {
+    const auto kvs = SortedEntries(static_cast<int>(state.range(0)));
+    wzq::ThreadSafeMap<int, int> map;
+    for (auto _ : state) {
+        for (const auto& kv : kvs) {
+            map.Emplace(kv.first, kv.second);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MapRefreshEmplace)->Arg(100000);
+
+void BM_MapRefreshMultiPut(benchmark::State& state) {
+    const auto kvs = SortedEntries(static_cast<int>(state.range(0)));
+    wzq::ThreadSafeMap<int, int> map;
+    for (auto _ : state) {
+        map.MultiPut(kvs);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MapRefreshMultiPut)->Arg(100000);
+
+// 拷贝输入也算在里面，和上面两种一样每次都从同一份数据开始
+void BM_MapRefreshBulkLoad(benchmark::State& state) {
+    const auto kvs = SortedEntries(static_cast<int>(state.range(0)));
+    wzq::ThreadSafeMap<int, int> map;
+    for (auto _ : state) {
+        auto copy = kvs;
+        map.BulkLoad(std::move(copy));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MapRefreshBulkLoad)->Arg(100000);
+
+// 一次查range(0)个key：逐个GetValueFromKey和一次MultiGet
+void BM_MapGetLoop(benchmark::State& state) {
+    wzq::ThreadSafeMap<int, int>& map = GetMap();
+    std::vector<int> keys;
+    for (int i = 0; i < state.range(0); ++i) {
+        keys.push_back(i * 7 % kKeySpace);
+    }
+    int value = 0;
+    for (auto _ : state) {
+        for (int key : keys) {
+            benchmark::DoNotOptimize(map.GetValueFromKey(key, value));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MapGetLoop)->Arg(64)->ThreadRange(1, 4)->UseRealTime();
+
+void BM_MapMultiGet(benchmark::State& state) {
+    wzq::ThreadSafeMap<int, int>& map = GetMap();
+    std::vector<int> keys;
+    for (int i = 0; i < state.range(0); ++i) {
+        keys.push_back(i * 7 % kKeySpace);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.MultiGet(keys));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MapMultiGet)->Arg(64)->ThreadRange(1, 4)->UseRealTime();
+
+// 没有写操作时重复取快照只是拷贝一个shared_ptr
+void BM_MapSnapshotUnchanged(benchmark::State& state) {
+    wzq::ThreadSafeMap<int, int>& map = GetMap();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(map.Snapshot());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MapSnapshotUnchanged);
+
+}  // namespace
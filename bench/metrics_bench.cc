@@ -0,0 +1,49 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "common/metrics.h"
+
+namespace {
+
+// 所有线程加同一个原子变量，线程池原来的total_function_num_就是这样
+void BM_SharedAtomicCounter(benchmark::State& state) {
+    static std::atomic<int64_t> counter{0};
+    for (auto _ : state) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SharedAtomicCounter)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_StripedCounter(benchmark::State& state) {
+    static wzq::StripedCounter counter;
+    for (auto _ : state) {
+        counter.Add();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StripedCounter)->ThreadRange(1, 8)->UseRealTime();
+
+// 读要把所有分片加起来，比单个原子变量慢，但只在导出指标时发生
+void BM_StripedCounterRead(benchmark::State& state) {
+    wzq::StripedCounter counter;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(counter.Value());
+    }
+}
+BENCHMARK(BM_StripedCounterRead);
+
+void BM_StripedHistogramRecord(benchmark::State& state) {
+    static wzq::StripedHistogram histogram;
+    int64_t value = state.thread_index();
+    for (auto _ : state) {
+        histogram.Record(value);
+        value = (value * 1103515245 + 12345) & 0xfffff;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_StripedHistogramRecord)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
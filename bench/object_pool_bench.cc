@@ -0,0 +1,126 @@
+#include <benchmark/benchmark.h>
+
+#include <memory_resource>
+#include <vector>
+
+#include "common/arena.h"
+#include "common/object_pool.h"
+
+namespace {
+
+// 模拟一个短生命周期的请求对象
+struct Request {
+    int64_t id;
+    int64_t deadline;
+    char payload[48];
+};
+
+constexpr int kBatch = 1024;
+
+void BM_NewDelete(benchmark::State& state) {
+    for (auto _ : state) {
+        Request* r = new Request();
+        benchmark::DoNotOptimize(r);
+        delete r;
+    }
+}
+BENCHMARK(BM_NewDelete)->ThreadRange(1, 8);
+
+void BM_ObjectPool(benchmark::State& state) {
+    for (auto _ : state) {
+        Request* r = wzq::ObjectPool<Request>::New();
+        benchmark::DoNotOptimize(r);
+        wzq::ObjectPool<Request>::Delete(r);
+    }
+}
+BENCHMARK(BM_ObjectPool)->ThreadRange(1, 8);
+
+void BM_PmrUnsyncPool(benchmark::State& state) {
+    std::pmr::unsynchronized_pool_resource resource;
+    std::pmr::polymorphic_allocator<Request> alloc(&resource);
+    for (auto _ : state) {
+        Request* r = alloc.allocate(1);
+        alloc.construct(r);
+        benchmark::DoNotOptimize(r);
+        alloc.destroy(r);
+        alloc.deallocate(r, 1);
+    }
+}
+BENCHMARK(BM_PmrUnsyncPool)->ThreadRange(1, 8);
+
+// 一次申请一批再一起释放，空闲链表会被反复清空和填满
+void BM_NewDeleteBatch(benchmark::State& state) {
+    std::vector<Request*> v(kBatch);
+    for (auto _ : state) {
+        for (auto& r : v) r = new Request();
+        benchmark::DoNotOptimize(v.data());
+        for (auto r : v) delete r;
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_NewDeleteBatch);
+
+void BM_ObjectPoolBatch(benchmark::State& state) {
+    std::vector<Request*> v(kBatch);
+    for (auto _ : state) {
+        for (auto& r : v) r = wzq::ObjectPool<Request>::New();
+        benchmark::DoNotOptimize(v.data());
+        for (auto r : v) wzq::ObjectPool<Request>::Delete(r);
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_ObjectPoolBatch);
+
+void BM_PmrUnsyncPoolBatch(benchmark::State& state) {
+    std::pmr::unsynchronized_pool_resource resource;
+    std::pmr::polymorphic_allocator<Request> alloc(&resource);
+    std::vector<Request*> v(kBatch);
+    for (auto _ : state) {
+        for (auto& r : v) {
+            r = alloc.allocate(1);
+            alloc.construct(r);
+        }
+        benchmark::DoNotOptimize(v.data());
+        for (auto r : v) alloc.deallocate(r, 1);
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK(BM_PmrUnsyncPoolBatch);
+
+// 一个请求内构建若干临时容器，请求结束整体回收
+template <typename Resource>
+void BuildRequestScratch(Resource* resource) {
+    std::pmr::vector<int> ids(resource);
+    std::pmr::string name("request-scoped scratch string that does not fit SSO", resource);
+    for (int i = 0; i < 256; ++i) {
+        ids.push_back(i);
+    }
+    benchmark::DoNotOptimize(ids.data());
+    benchmark::DoNotOptimize(name.data());
+}
+
+void BM_ScratchDefaultResource(benchmark::State& state) {
+    for (auto _ : state) {
+        BuildRequestScratch(std::pmr::new_delete_resource());
+    }
+}
+BENCHMARK(BM_ScratchDefaultResource);
+
+void BM_ScratchPmrUnsyncPool(benchmark::State& state) {
+    std::pmr::unsynchronized_pool_resource resource;
+    for (auto _ : state) {
+        BuildRequestScratch(&resource);
+    }
+}
+BENCHMARK(BM_ScratchPmrUnsyncPool);
+
+void BM_ScratchArena(benchmark::State& state) {
+    wzq::Arena arena;
+    for (auto _ : state) {
+        BuildRequestScratch(&arena);
+        arena.Reset();
+    }
+}
+BENCHMARK(BM_ScratchArena);
+
+}  // namespace
@@ -0,0 +1,65 @@
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "common/output_container.h"
+
+namespace {
+
+const std::map<int, std::string>& BigMap() {
+    static const std::map<int, std::string> m = [] {
+        std::map<int, std::string> ret;
+        for (int i = 0; i < 1000000; ++i) {
+            ret.emplace(i, "value_" + std::to_string(i));
+        }
+        return ret;
+    }();
+    return m;
+}
+
+void BM_OstreamMap(benchmark::State& state) {
+    const auto& m = BigMap();
+    for (auto _ : state) {
+        std::ostringstream os;
+        os << m;
+        benchmark::DoNotOptimize(os.str().size());
+    }
+}
+BENCHMARK(BM_OstreamMap)->Unit(benchmark::kMillisecond);
+
+void BM_FormatBufferMap(benchmark::State& state) {
+    const auto& m = BigMap();
+    for (auto _ : state) {
+        wzq::FormatBuffer buf;
+        wzq::FormatTo(buf, m);
+        benchmark::DoNotOptimize(buf.size());
+    }
+}
+BENCHMARK(BM_FormatBufferMap)->Unit(benchmark::kMillisecond);
+
+// 预先分配好的buffer反复使用
+void BM_FormatBufferMapReused(benchmark::State& state) {
+    const auto& m = BigMap();
+    wzq::FormatBuffer buf(wzq::FormatBuffer::kNoLimit, 32 << 20);
+    for (auto _ : state) {
+        buf.Clear();
+        wzq::FormatTo(buf, m);
+        benchmark::DoNotOptimize(buf.size());
+    }
+}
+BENCHMARK(BM_FormatBufferMapReused)->Unit(benchmark::kMillisecond);
+
+// 日志里只保留前64KB
+void BM_FormatBufferMapTruncated(benchmark::State& state) {
+    const auto& m = BigMap();
+    for (auto _ : state) {
+        wzq::FormatBuffer buf(64 << 10);
+        wzq::FormatTo(buf, m);
+        benchmark::DoNotOptimize(buf.size());
+    }
+}
+BENCHMARK(BM_FormatBufferMapTruncated)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
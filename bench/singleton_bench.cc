@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+#include "singleton/singleton.h"
+
+namespace {
+
+struct Config {
+    int value = 42;
+};
+
+// 原来每次访问都走call_once的实现
+template <typename T>
+class CallOnceSingleton {
+   public:
+    static T& instance() {
+        std::call_once(once_, [] { value_ = new T(); });
+        return *value_;
+    }
+
+   private:
+    static inline T* value_ = nullptr;
+    static inline std::once_flag once_;
+};
+
+template <typename T>
+T& MeyersInstance() {
+    static T value;
+    return value;
+}
+
+void BM_CallOnce(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(CallOnceSingleton<Config>::instance().value);
+    }
+}
+BENCHMARK(BM_CallOnce)->ThreadRange(1, 4);
+
+void BM_Meyers(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MeyersInstance<Config>().value);
+    }
+}
+BENCHMARK(BM_Meyers)->ThreadRange(1, 4);
+
+void BM_SingleTon(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(wzq::SingleTon<Config>::instance().value);
+    }
+}
+BENCHMARK(BM_SingleTon)->ThreadRange(1, 4);
+
+void BM_ThreadLocalSingleton(benchmark::State& state) {
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(wzq::ThreadLocalSingleton<Config>::instance().value);
+    }
+}
+BENCHMARK(BM_ThreadLocalSingleton)->ThreadRange(1, 4);
+
+}  // namespace
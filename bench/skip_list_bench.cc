@@ -0,0 +1,157 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+#include "common/map.h"
+#include "common/skip_list_map.h"
+
+namespace {
+
+constexpr int kKeySpace = 1 << 16;
+constexpr int kScanLength = 100;
+
+uint32_t XorShift(uint32_t& s) {
+    s ^= s << 13;
+    s ^= s >> 17;
+    s ^= s << 5;
+    return s;
+}
+
+// 预先放进一半的key，之后插入和删除的概率相同，大小基本不变
+wzq::SkipListMap<int, int>& GetSkipList() {
+    static auto* map = []() {
+        auto* m = new wzq::SkipListMap<int, int>();
+        for (int i = 0; i < kKeySpace; i += 2) {
+            m->Insert(i, i);
+        }
+        return m;
+    }();
+    return *map;
+}
+
+wzq::ThreadSafeMap<int, int>& GetThreadSafeMap() {
+    static auto* map = []() {
+        auto* m = new wzq::ThreadSafeMap<int, int>();
+        for (int i = 0; i < kKeySpace; i += 2) {
+            m->Emplace(i, i);
+        }
+        return m;
+    }();
+    return *map;
+}
+
+// ThreadSafeMap没有范围查询，用同样的std::map加一把锁模拟：扫描期间一直持有锁
+struct LockedMap {
+    std::map<int, int> map;
+    std::mutex mutex;
+};
+
+LockedMap& GetLockedMap() {
+    static auto* locked = []() {
+        auto* m = new LockedMap();
+        for (int i = 0; i < kKeySpace; i += 2) {
+            m->map.emplace(i, i);
+        }
+        return m;
+    }();
+    return *locked;
+}
+
+// range(0)是读的百分比，其余一半插入一半删除
+void BM_SkipListPointMix(benchmark::State& state) {
+    wzq::SkipListMap<int, int>& map = GetSkipList();
+    const uint32_t read_percent = static_cast<uint32_t>(state.range(0));
+    uint32_t seed = 0x9e3779b9u + static_cast<uint32_t>(state.thread_index()) * 7919u;
+    int value = 0;
+    for (auto _ : state) {
+        uint32_t r = XorShift(seed);
+        int key = static_cast<int>(r % kKeySpace);
+        uint32_t op = (r >> 16) % 100;
+        if (op < read_percent) {
+            benchmark::DoNotOptimize(map.Find(key, value));
+        } else if (op & 1) {
+            map.Insert(key, key);
+        } else {
+            map.Erase(key);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SkipListPointMix)->ArgName("read%")->Arg(90)->Arg(99)->ThreadRange(1, 8)->UseRealTime();
+
+void BM_ThreadSafeMapPointMix(benchmark::State& state) {
+    wzq::ThreadSafeMap<int, int>& map = GetThreadSafeMap();
+    const uint32_t read_percent = static_cast<uint32_t>(state.range(0));
+    uint32_t seed = 0x9e3779b9u + static_cast<uint32_t>(state.thread_index()) * 7919u;
+    int value = 0;
+    for (auto _ : state) {
+        uint32_t r = XorShift(seed);
+        int key = static_cast<int>(r % kKeySpace);
+        uint32_t op = (r >> 16) % 100;
+        if (op < read_percent) {
+            benchmark::DoNotOptimize(map.GetValueFromKey(key, value));
+        } else if (op & 1) {
+            map.Emplace(key, key);
+        } else {
+            map.EraseKey(key);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ThreadSafeMapPointMix)->ArgName("read%")->Arg(90)->Arg(99)->ThreadRange(1, 8)->UseRealTime();
+
+// 0号线程做范围扫描，其它线程一直插入删除；items是0号线程扫过的元素个数
+void BM_SkipListRangeScan(benchmark::State& state) {
+    wzq::SkipListMap<int, int>& map = GetSkipList();
+    uint32_t seed = 0x2545f491u + static_cast<uint32_t>(state.thread_index()) * 7919u;
+    int64_t scanned = 0;
+    for (auto _ : state) {
+        uint32_t r = XorShift(seed);
+        int key = static_cast<int>(r % kKeySpace);
+        if (state.thread_index() == 0) {
+            int64_t sum = 0;
+            int n = 0;
+            for (auto iter = map.LowerBound(key); iter != map.End() && n < kScanLength; ++iter, ++n) {
+                sum += iter.Value();
+            }
+            benchmark::DoNotOptimize(sum);
+            scanned += n;
+        } else if (r & 0x10000) {
+            map.Insert(key, key);
+        } else {
+            map.Erase(key);
+        }
+    }
+    state.SetItemsProcessed(scanned);
+}
+BENCHMARK(BM_SkipListRangeScan)->ThreadRange(1, 4)->UseRealTime();
+
+void BM_LockedMapRangeScan(benchmark::State& state) {
+    LockedMap& locked = GetLockedMap();
+    uint32_t seed = 0x2545f491u + static_cast<uint32_t>(state.thread_index()) * 7919u;
+    int64_t scanned = 0;
+    for (auto _ : state) {
+        uint32_t r = XorShift(seed);
+        int key = static_cast<int>(r % kKeySpace);
+        std::unique_lock<std::mutex> lock(locked.mutex);
+        if (state.thread_index() == 0) {
+            int64_t sum = 0;
+            int n = 0;
+            for (auto iter = locked.map.lower_bound(key); iter != locked.map.end() && n < kScanLength; ++iter, ++n) {
+                sum += iter->second;
+            }
+            benchmark::DoNotOptimize(sum);
+            scanned += n;
+        } else if (r & 0x10000) {
+            locked.map.emplace(key, key);
+        } else {
+            locked.map.erase(key);
+        }
+    }
+    state.SetItemsProcessed(scanned);
+}
+BENCHMARK(BM_LockedMapRangeScan)->ThreadRange(1, 4)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "thread/count_down_latch.h"
+#include "thread/strand.h"
+#include "thread/thread_pool.h"
+
+namespace {
+
+constexpr int kTasksPerIteration = 10000;
+
+// 整个进程共用一个线程池，启动线程的开销不算进测试里
+wzq::ThreadPool& GetPool() {
+    static wzq::ThreadPool* pool = []() {
+        auto* p = new wzq::ThreadPool(wzq::ThreadPool::ThreadPoolConfig{4, 4, 0, std::chrono::seconds(60)});
+        p->Start();
+        return p;
+    }();
+    return *pool;
+}
+
+// 每个key一份状态，模拟按连接/账号划分的状态机
+struct KeyState {
+    std::mutex mutex;
+    uint64_t value = 0;
+};
+
+// 原来的做法：直接提交到线程池，每个key的状态用锁保护
+void BM_PoolWithKeyLock(benchmark::State& state) {
+    const int keys = static_cast<int>(state.range(0));
+    std::vector<KeyState> states(keys);
+    wzq::ThreadPool& pool = GetPool();
+    for (auto _ : state) {
+        wzq::CountDownLatch latch(kTasksPerIteration);
+        for (int i = 0; i < kTasksPerIteration; ++i) {
+            KeyState& s = states[i % keys];
+            pool.Post([&s, &latch]() {
+                {
+                    std::unique_lock<std::mutex> lock(s.mutex);
+                    benchmark::DoNotOptimize(++s.value);
+                }
+                latch.CountDown();
+            });
+        }
+        latch.Await();
+    }
+    state.SetItemsProcessed(state.iterations() * kTasksPerIteration);
+}
+BENCHMARK(BM_PoolWithKeyLock)->ArgName("keys")->Arg(4)->Arg(64)->Arg(1024)->UseRealTime();
+
+// 按key串行执行，状态不需要加锁
+void BM_KeyedStrands(benchmark::State& state) {
+    const int keys = static_cast<int>(state.range(0));
+    std::vector<KeyState> states(keys);
+    wzq::KeyedStrands<int> strands(GetPool());
+    for (auto _ : state) {
+        wzq::CountDownLatch latch(kTasksPerIteration);
+        for (int i = 0; i < kTasksPerIteration; ++i) {
+            KeyState& s = states[i % keys];
+            strands.Post(i % keys, [&s, &latch]() {
+                benchmark::DoNotOptimize(++s.value);
+                latch.CountDown();
+            });
+        }
+        latch.Await();
+    }
+    state.SetItemsProcessed(state.iterations() * kTasksPerIteration);
+}
+BENCHMARK(BM_KeyedStrands)->ArgName("keys")->Arg(4)->Arg(64)->Arg(1024)->UseRealTime();
+
+// 多个线程同时往同一个Strand投递
+void BM_StrandConcurrentPost(benchmark::State& state) {
+    static wzq::Strand* strand = new wzq::Strand(GetPool());
+    static std::atomic<uint64_t> executed{0};
+    uint64_t posted = 0;
+    for (auto _ : state) {
+        strand->Post([]() { executed.fetch_add(1, std::memory_order_relaxed); });
+        ++posted;
+    }
+    state.SetItemsProcessed(state.iterations());
+    static std::atomic<uint64_t> total_posted{0};
+    uint64_t target = total_posted.fetch_add(posted) + posted;
+    while (executed.load() < target) {
+        std::this_thread::yield();
+    }
+}
+BENCHMARK(BM_StrandConcurrentPost)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "thread/thread_pool.h"
+
+namespace {
+
+// 每种线程数的线程池创建一次后一直留着，启动线程的开销不算进别的测试里
+wzq::ThreadPool& GetPool(int threads) {
+    static std::mutex mutex;
+    static auto* pools = new std::map<int, wzq::ThreadPool*>();
+    std::unique_lock<std::mutex> lock(mutex);
+    wzq::ThreadPool*& pool = (*pools)[threads];
+    if (pool == nullptr) {
+        pool = new wzq::ThreadPool(wzq::ThreadPool::ThreadPoolConfig{threads, threads, 0, std::chrono::seconds(60)});
+        pool->Start();
+    }
+    return *pool;
+}
+
+// 模拟任务本身的计算量
+int Spin(int n) {
+    int x = 0;
+    for (int i = 0; i < n; ++i) {
+        benchmark::DoNotOptimize(x += i);
+    }
+    return x;
+}
+
+// 一次提交range(2)个任务再全部等完，range(0)是线程数，range(1)是每个任务的计算量
+void BM_PoolSubmitComplete(benchmark::State& state) {
+    wzq::ThreadPool& pool = GetPool(static_cast<int>(state.range(0)));
+    const int spin = static_cast<int>(state.range(1));
+    const int batch = static_cast<int>(state.range(2));
+    std::vector<std::shared_ptr<std::future<int>>> futures;
+    futures.reserve(batch);
+    for (auto _ : state) {
+        for (int i = 0; i < batch; ++i) {
+            futures.push_back(pool.Run(Spin, spin));
+        }
+        for (auto& f : futures) {
+            benchmark::DoNotOptimize(f->get());
+        }
+        futures.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_PoolSubmitComplete)
+    ->ArgNames({"threads", "spin", "batch"})
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 1000, 100000}, {1000}})
+    ->UseRealTime();
+
+// 提交一个空任务并等待它完成的往返延迟
+void BM_PoolRoundTrip(benchmark::State& state) {
+    wzq::ThreadPool& pool = GetPool(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        pool.Run([]() {})->get();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PoolRoundTrip)->ArgName("threads")->Arg(1)->Arg(4)->UseRealTime();
+
+// 多个线程同时往同一个线程池提交，只测提交本身的开销
+void BM_PoolConcurrentSubmit(benchmark::State& state) {
+    wzq::ThreadPool& pool = GetPool(4);
+    std::vector<std::shared_ptr<std::future<void>>> futures;
+    futures.reserve(1024);
+    for (auto _ : state) {
+        futures.push_back(pool.Run([]() {}));
+        if (futures.size() == 1024) {
+            state.PauseTiming();
+            for (auto& f : futures) {
+                f->get();
+            }
+            futures.clear();
+            state.ResumeTiming();
+        }
+    }
+    for (auto& f : futures) {
+        f->get();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PoolConcurrentSubmit)->ThreadRange(1, 8)->UseRealTime();
+
+// 一次完整的Start到ShutDown，ShutDown返回时工作线程都已经join，range(1)为是否预热
+void BM_PoolStartShutDown(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    const bool prewarm = state.range(1) != 0;
+    for (auto _ : state) {
+        wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{threads, threads, 0, std::chrono::seconds(60), prewarm});
+        pool.Start();
+        pool.ShutDown();
+    }
+    state.SetItemsProcessed(state.iterations() * threads);
+}
+BENCHMARK(BM_PoolStartShutDown)
+    ->ArgNames({"threads", "prewarm"})
+    ->ArgsProduct({{1, 4, 16, 64}, {0, 1}})
+    ->UseRealTime();
+
+// 刚启动的线程池执行第一批任务的时间，只计这部分时间，range(1)为是否预热
+void BM_PoolFirstTasks(benchmark::State& state) {
+    const int threads = static_cast<int>(state.range(0));
+    const bool prewarm = state.range(1) != 0;
+    std::vector<std::shared_ptr<std::future<int>>> futures;
+    futures.reserve(threads);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto pool = std::make_unique<wzq::ThreadPool>(
+            wzq::ThreadPool::ThreadPoolConfig{threads, threads, 0, std::chrono::seconds(60), prewarm});
+        pool->Start();
+        state.ResumeTiming();
+        for (int i = 0; i < threads; ++i) {
+            futures.push_back(pool->Run(Spin, 1000));
+        }
+        for (auto& f : futures) {
+            benchmark::DoNotOptimize(f->get());
+        }
+        state.PauseTiming();
+        futures.clear();
+        pool.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * threads);
+}
+BENCHMARK(BM_PoolFirstTasks)->ArgNames({"threads", "prewarm"})->ArgsProduct({{4, 16}, {0, 1}})->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,132 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "common/histogram.h"
+#include "thread/count_down_latch.h"
+#include "timer/timer.h"
+
+namespace {
+
+// TimerQueue启动和停止都有开销，每种分发方式整个进程共用一个，不析构
+wzq::TimerQueue& GetTimer(wzq::TimerQueue::DispatcherType type = wzq::TimerQueue::DispatcherType::kFutex) {
+    static wzq::TimerQueue* timers[2] = {nullptr, nullptr};
+    wzq::TimerQueue*& timer = timers[static_cast<int>(type)];
+    if (timer == nullptr) {
+        timer = new wzq::TimerQueue(type);
+        timer->Run();
+    }
+    return *timer;
+}
+
+std::atomic<int64_t> g_added{0};
+std::atomic<int64_t> g_fired{0};
+
+void OnFire() { g_fired.fetch_add(1, std::memory_order_relaxed); }
+
+// 插入很快到期的定时任务，结束时等它们全部执行完，避免影响后面的用例
+void BM_TimerInsert(benchmark::State& state) {
+    wzq::TimerQueue& timer = GetTimer();
+    for (auto _ : state) {
+        timer.AddFuncAfterDuration(std::chrono::milliseconds(1), OnFire);
+    }
+    state.SetItemsProcessed(state.iterations());
+    // 计时已经结束，等插入的任务都执行完
+    int64_t added = g_added.fetch_add(static_cast<int64_t>(state.iterations())) + state.iterations();
+    while (g_fired.load() < added) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+BENCHMARK(BM_TimerInsert)->ThreadRange(1, 8)->UseRealTime();
+
+// 添加一个周期任务然后马上取消；周期设得很长，测试期间不会触发
+void BM_TimerRepeatedAddCancel(benchmark::State& state) {
+    wzq::TimerQueue& timer = GetTimer();
+    for (auto _ : state) {
+        int id = timer.AddRepeatedFunc(2, std::chrono::hours(1), OnFire);
+        timer.CancelRepeatedFuncId(id);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// 取消的任务仍留在队列里直到到期，限制迭代次数控制内存
+BENCHMARK(BM_TimerRepeatedAddCancel)->Iterations(100000)->UseRealTime();
+
+// 外部执行器，给ExecutionPolicy::On用
+wzq::ThreadPool& GetExecutor() {
+    static wzq::ThreadPool* pool = []() {
+        auto* p = new wzq::ThreadPool(wzq::ThreadPool::ThreadPoolConfig{2, 2, 0, std::chrono::seconds(60)});
+        p->Start();
+        return p;
+    }();
+    return *pool;
+}
+
+wzq::TimerQueue::ExecutionPolicy PolicyFromArg(int64_t arg) {
+    switch (arg) {
+        case 1:
+            return wzq::TimerQueue::ExecutionPolicy::Inline();
+        case 2:
+            return wzq::TimerQueue::ExecutionPolicy::On(GetExecutor());
+        default:
+            return wzq::TimerQueue::ExecutionPolicy::Pool();
+    }
+}
+
+// 一次插入range(1)个立即到期的任务，测到全部执行完的时间；range(0): 0内部线程池 1分发线程上执行 2外部执行器
+void BM_TimerFire(benchmark::State& state) {
+    wzq::TimerQueue& timer = GetTimer();
+    const auto policy = PolicyFromArg(state.range(0));
+    const uint32_t num = static_cast<uint32_t>(state.range(1));
+    for (auto _ : state) {
+        wzq::CountDownLatch latch(num);
+        auto now = wzq::TimerQueue::Clock::now();
+        for (uint32_t i = 0; i < num; ++i) {
+            timer.AddFuncAtTimePoint(policy, now, [&latch]() { latch.CountDown(); });
+        }
+        latch.Await();
+    }
+    state.SetItemsProcessed(state.iterations() * num);
+}
+BENCHMARK(BM_TimerFire)
+    ->ArgNames({"policy", "timers"})
+    ->ArgsProduct({{0, 1, 2}, {1000, 10000}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// 到期精度：range(0)个定时任务的到期时间在10ms内均匀分布，统计实际执行时刻减去到期时刻
+void BM_TimerLateness(benchmark::State& state) {
+    auto type = static_cast<wzq::TimerQueue::DispatcherType>(state.range(0));
+    wzq::TimerQueue& timer = GetTimer(type);
+    const uint32_t num = static_cast<uint32_t>(state.range(1));
+    std::vector<int64_t> lateness(num);
+    wzq::Histogram histogram;
+    for (auto _ : state) {
+        wzq::CountDownLatch latch(num);
+        auto base = wzq::TimerQueue::Clock::now() + std::chrono::milliseconds(1);
+        for (uint32_t i = 0; i < num; ++i) {
+            auto deadline = base + std::chrono::microseconds(i * 10000 / num);
+            timer.AddFuncAtTimePoint(deadline, [&latch, &lateness, deadline, i]() {
+                lateness[i] = (wzq::TimerQueue::Clock::now() - deadline).count();
+                latch.CountDown();
+            });
+        }
+        latch.Await();
+        for (int64_t ns : lateness) {
+            histogram.Record(ns);
+        }
+    }
+    state.counters["p50_us"] = histogram.Percentile(50) / 1e3;
+    state.counters["p99_us"] = histogram.Percentile(99) / 1e3;
+    state.counters["p999_us"] = histogram.Percentile(99.9) / 1e3;
+    state.counters["max_us"] = histogram.Max() / 1e3;
+}
+BENCHMARK(BM_TimerLateness)
+    ->ArgNames({"timerfd", "timers"})
+    ->ArgsProduct({{0, 1}, {100, 1000}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,148 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "common/unit.h"
+
+namespace {
+
+using wzq::units::Metre;
+using wzq::units::MetrePerSecond;
+using wzq::units::Second;
+
+constexpr std::size_t kN = 1 << 16;
+
+template <typename Rep>
+std::vector<Rep> RawData(Rep base) {
+    std::vector<Rep> v(kN);
+    for (std::size_t i = 0; i < kN; ++i) {
+        v[i] = base + Rep(i % 97);
+    }
+    return v;
+}
+
+template <typename Rep, typename U>
+wzq::ValueArray<U, Rep> TypedData(Rep base) {
+    wzq::ValueArray<U, Rep> v(kN);
+    for (std::size_t i = 0; i < kN; ++i) {
+        v.Set(i, wzq::Value<U, Rep>(base + Rep(i % 97)));
+    }
+    return v;
+}
+
+// 裸指针循环作为基准
+template <typename Rep>
+void BM_RawAdd(benchmark::State& state) {
+    auto a = RawData<Rep>(1), b = RawData<Rep>(2);
+    std::vector<Rep> c(kN);
+    for (auto _ : state) {
+        const Rep* pa = a.data();
+        const Rep* pb = b.data();
+        Rep* pc = c.data();
+        for (std::size_t i = 0; i < kN; ++i) {
+            pc[i] = pa[i] + pb[i];
+        }
+        benchmark::DoNotOptimize(pc);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_RawAdd, float);
+BENCHMARK_TEMPLATE(BM_RawAdd, double);
+
+template <typename Rep>
+void BM_ValueArrayAdd(benchmark::State& state) {
+    auto a = TypedData<Rep, Metre>(1), b = TypedData<Rep, Metre>(2);
+    wzq::ValueArray<Metre, Rep> c(kN);
+    for (auto _ : state) {
+        wzq::unit_kernels::Add(c.data(), a.data(), b.data(), kN);
+        benchmark::DoNotOptimize(c.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_ValueArrayAdd, float);
+BENCHMARK_TEMPLATE(BM_ValueArrayAdd, double);
+
+template <typename Rep>
+void BM_RawScale(benchmark::State& state) {
+    auto a = RawData<Rep>(1);
+    for (auto _ : state) {
+        Rep* pa = a.data();
+        for (std::size_t i = 0; i < kN; ++i) {
+            pa[i] *= Rep(1.0000001);
+        }
+        benchmark::DoNotOptimize(pa);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_RawScale, double);
+
+template <typename Rep>
+void BM_ValueArrayScale(benchmark::State& state) {
+    auto a = TypedData<Rep, Metre>(1);
+    for (auto _ : state) {
+        a *= Rep(1.0000001);
+        benchmark::DoNotOptimize(a.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_ValueArrayScale, double);
+
+// 距离 / 时间 = 速度，结果是新量纲的数组
+template <typename Rep>
+void BM_RawDivide(benchmark::State& state) {
+    auto d = RawData<Rep>(100), t = RawData<Rep>(1);
+    for (auto _ : state) {
+        std::vector<Rep> v(kN);
+        for (std::size_t i = 0; i < kN; ++i) {
+            v[i] = d[i] / t[i];
+        }
+        benchmark::DoNotOptimize(v.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_RawDivide, double);
+
+template <typename Rep>
+void BM_ValueArrayDivide(benchmark::State& state) {
+    auto d = TypedData<Rep, Metre>(100);
+    auto t = TypedData<Rep, Second>(1);
+    for (auto _ : state) {
+        wzq::ValueArray<MetrePerSecond, Rep> v = d.Divide(t);
+        benchmark::DoNotOptimize(v.data());
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_ValueArrayDivide, double);
+
+// 朴素的逐个累加有循环依赖，不开-ffast-math时编译器不会向量化
+template <typename Rep>
+void BM_RawSum(benchmark::State& state) {
+    auto a = RawData<Rep>(1);
+    for (auto _ : state) {
+        Rep sum = 0;
+        for (std::size_t i = 0; i < kN; ++i) {
+            sum += a[i];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_RawSum, float);
+BENCHMARK_TEMPLATE(BM_RawSum, double);
+
+template <typename Rep>
+void BM_ValueArraySum(benchmark::State& state) {
+    auto a = TypedData<Rep, Metre>(1);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(a.Sum());
+    }
+    state.SetItemsProcessed(state.iterations() * kN);
+}
+BENCHMARK_TEMPLATE(BM_ValueArraySum, float);
+BENCHMARK_TEMPLATE(BM_ValueArraySum, double);
+
+}  // namespace
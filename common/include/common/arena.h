@@ -0,0 +1,154 @@
+#ifndef __ARENA__
+#define __ARENA__
+
+#include "common/noncopyable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace wzq {
+
+/**
+ * 指针碰撞(bump)式分配器，适合一次请求内的临时数据：
+ * 分配只是移动指针，单个释放什么都不做，Reset()时整体回收，保留最后一块内存给下次请求复用。
+ *
+ * 继承std::pmr::memory_resource，可以直接给std::pmr::vector/string等容器使用。
+ * 非线程安全，一个请求一个Arena。
+ */
+class Arena : public std::pmr::memory_resource, wzq::NonCopyAble {
+   public:
+    explicit Arena(std::size_t block_size = 4096,
+                   std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+        : block_size_(block_size < kMinBlockSize ? kMinBlockSize : block_size), upstream_(upstream) {}
+
+    ~Arena() override { Release(); }
+
+    void *Allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+        std::uintptr_t p = (reinterpret_cast<std::uintptr_t>(cur_) + align - 1) & ~(std::uintptr_t)(align - 1);
+        if (cur_ == nullptr || p + size > reinterpret_cast<std::uintptr_t>(end_)) {
+            return AllocateSlow(size, align);
+        }
+        cur_ = reinterpret_cast<char *>(p + size);
+        return reinterpret_cast<void *>(p);
+    }
+
+    // 在Arena上构造对象，非平凡析构的对象会在Reset()/析构时按构造的逆序析构
+    template <typename T, typename... Args>
+    T *Create(Args &&... args) {
+        if constexpr (std::is_trivially_destructible_v<T>) {
+            return ::new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        } else {
+            Cleanup *cleanup = static_cast<Cleanup *>(Allocate(sizeof(Cleanup), alignof(Cleanup)));
+            T *obj = ::new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+            cleanup->obj = obj;
+            cleanup->destroy = [](void *p) { static_cast<T *>(p)->~T(); };
+            cleanup->next = cleanups_;
+            cleanups_ = cleanup;
+            return obj;
+        }
+    }
+
+    // 回收所有分配，保留最近(也是最大)的一块内存
+    void Reset() {
+        RunCleanups();
+        if (blocks_ == nullptr) {
+            return;
+        }
+        FreeBlocks(blocks_->prev);
+        blocks_->prev = nullptr;
+        cur_ = reinterpret_cast<char *>(blocks_) + sizeof(Block);
+        end_ = reinterpret_cast<char *>(blocks_) + blocks_->size;
+        bytes_used_ = 0;
+    }
+
+    // 回收所有分配并把内存全部还给上游
+    void Release() {
+        RunCleanups();
+        FreeBlocks(blocks_);
+        blocks_ = nullptr;
+        cur_ = end_ = nullptr;
+        bytes_used_ = 0;
+    }
+
+    // 已经分配出去的字节数(不含当前块中还未使用的部分)
+    std::size_t BytesUsed() const {
+        return blocks_ == nullptr ? 0 : bytes_used_ + (cur_ - (reinterpret_cast<char *>(blocks_) + sizeof(Block)));
+    }
+
+   protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override { return Allocate(bytes, alignment); }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+   private:
+    struct alignas(std::max_align_t) Block {
+        Block *prev;
+        std::size_t size;
+    };
+
+    struct Cleanup {
+        void *obj;
+        void (*destroy)(void *);
+        Cleanup *next;
+    };
+
+    static constexpr std::size_t kMinBlockSize = 256;
+    static constexpr std::size_t kMaxBlockSize = 1 << 20;
+
+    void *AllocateSlow(std::size_t size, std::size_t align) {
+        std::size_t need = sizeof(Block) + size + align;
+        std::size_t block_size = blocks_ == nullptr ? block_size_ : blocks_->size * 2;
+        if (block_size > kMaxBlockSize) {
+            block_size = kMaxBlockSize;
+        }
+        if (block_size < need) {
+            block_size = need;
+        }
+        Block *block = static_cast<Block *>(upstream_->allocate(block_size, alignof(Block)));
+        if (blocks_ != nullptr) {
+            bytes_used_ += cur_ - (reinterpret_cast<char *>(blocks_) + sizeof(Block));
+        }
+        block->prev = blocks_;
+        block->size = block_size;
+        blocks_ = block;
+        cur_ = reinterpret_cast<char *>(block) + sizeof(Block);
+        end_ = reinterpret_cast<char *>(block) + block_size;
+        return Allocate(size, align);
+    }
+
+    void RunCleanups() {
+        while (cleanups_ != nullptr) {
+            Cleanup *cleanup = cleanups_;
+            cleanups_ = cleanup->next;
+            cleanup->destroy(cleanup->obj);
+        }
+    }
+
+    void FreeBlocks(Block *block) {
+        while (block != nullptr) {
+            Block *prev = block->prev;
+            upstream_->deallocate(block, block->size, alignof(Block));
+            block = prev;
+        }
+    }
+
+   private:
+    std::size_t block_size_;
+    std::pmr::memory_resource *upstream_;
+
+    Block *blocks_ = nullptr;
+    char *cur_ = nullptr;
+    char *end_ = nullptr;
+    std::size_t bytes_used_ = 0;
+    Cleanup *cleanups_ = nullptr;
+};
+
+}  // namespace wzq
+
+#endif
@@ -1,42 +1,766 @@
 #ifndef __CMD__
 #define __CMD__
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+#include "common/noncopyable.h"
+#include "common/own_strings.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+extern char **environ;
 
 namespace wzq {
+
+// 命令的执行结果
+struct CommandResult {
+    int exit_code = -1;   // 正常退出时的退出码，否则为-1
+    int term_signal = 0;  // 被信号杀死时的信号值
+    bool timed_out = false;
+    int error = 0;  // 创建进程或者等待输出失败时的errno
+
+    bool Ok() const { return error == 0 && !timed_out && term_signal == 0 && exit_code == 0; }
+};
+
+struct CommandOptions {
+    // 超时时间，0表示不超时，超时后整个进程组会被SIGKILL
+    std::chrono::milliseconds timeout{0};
+    // stderr合并到stdout的回调里
+    bool merge_stderr = false;
+    // 总是通过/bin/sh -c执行，否则不含shell语法的命令会直接exec，省掉一次shell的fork/exec
+    bool force_shell = false;
+};
+
+// 子进程的标准输入输出怎么接
+struct SpawnOptions {
+    enum class Stderr { kPipe = 0, kMerge = 1, kInherit = 2 };
+
+    bool search_path = false;  // 按PATH查找argv[0]
+    bool pipe_stdin = false;   // false时stdin接/dev/null
+    Stderr stderr_mode = Stderr::kPipe;
+};
+
+// 输出回调，data只在回调期间有效，每次最多Subprocess::kChunkSize字节
+using CommandSink = std::function<void(const char *data, std::size_t len)>;
+
+/**
+ * 通过posix_spawn创建的子进程，stdout接管道，stdin/stderr由SpawnOptions决定。
+ * 子进程单独一个进程组，超时时可以连同它的子进程一起杀掉。
+ */
+class Subprocess : wzq::NonCopyAble {
+   public:
+    static constexpr std::size_t kChunkSize = 64 * 1024;
+    // 没有pidfd时用WNOHANG轮询回收，间隔从1ms开始翻倍，最多这么长
+    static constexpr std::chrono::milliseconds kMaxReapInterval{50};
+
+    Subprocess() = default;
+
+    ~Subprocess() {
+        CloseFd(in_fd_);
+        CloseFd(out_fd_);
+        CloseFd(err_fd_);
+        CloseFd(pid_fd_);
+        if (pid_ > 0 && !reaped_) {
+            Kill();
+            CommandResult result;
+            Reap(result, true);
+        }
+    }
+
+    // 成功返回0，否则返回errno
+    int Spawn(const std::vector<std::string> &argv, const SpawnOptions &options = SpawnOptions()) {
+        OwnedStrings args(argv);
+        return Spawn(args.data(), options);
+    }
+
+    // argv以nullptr结尾
+    int Spawn(char *const *argv, const SpawnOptions &options = SpawnOptions()) {
+        if (argv == nullptr || argv[0] == nullptr) {
+            return EINVAL;
+        }
+        using Stderr = SpawnOptions::Stderr;
+        int in_pipe[2] = {-1, -1};
+        int out_pipe[2] = {-1, -1};
+        int err_pipe[2] = {-1, -1};
+        if ((options.pipe_stdin && pipe2(in_pipe, O_CLOEXEC) != 0) || pipe2(out_pipe, O_CLOEXEC) != 0 ||
+            (options.stderr_mode == Stderr::kPipe && pipe2(err_pipe, O_CLOEXEC) != 0)) {
+            int error = errno;
+            for (int *fd : {&in_pipe[0], &in_pipe[1], &out_pipe[0], &out_pipe[1]}) {
+                CloseFd(*fd);
+            }
+            return error;
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (options.pipe_stdin) {
+            posix_spawn_file_actions_adddup2(&actions, in_pipe[0], 0);
+        } else {
+            posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+        }
+        posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+        if (options.stderr_mode != Stderr::kInherit) {
+            posix_spawn_file_actions_adddup2(&actions, options.stderr_mode == Stderr::kMerge ? out_pipe[1] : err_pipe[1],
+                                             2);
+        }
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t mask;
+        sigemptyset(&mask);
+        posix_spawnattr_setsigmask(&attr, &mask);
+        sigset_t def;
+        sigemptyset(&def);
+        sigaddset(&def, SIGPIPE);
+        posix_spawnattr_setsigdefault(&attr, &def);
+        posix_spawnattr_setpgroup(&attr, 0);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+        pid_t pid = -1;
+        int error = options.search_path ? posix_spawnp(&pid, argv[0], &actions, &attr, argv, environ)
+                                        : posix_spawn(&pid, argv[0], &actions, &attr, argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        CloseFd(in_pipe[0]);
+        CloseFd(out_pipe[1]);
+        CloseFd(err_pipe[1]);
+        if (error != 0) {
+            CloseFd(in_pipe[1]);
+            CloseFd(out_pipe[0]);
+            CloseFd(err_pipe[0]);
+            return error;
+        }
+        pid_ = pid;
+        in_fd_ = in_pipe[1];
+        out_fd_ = out_pipe[0];
+        err_fd_ = err_pipe[0];
+#ifdef SYS_pidfd_open
+        pid_fd_ = static_cast<int>(syscall(SYS_pidfd_open, pid_, 0));
+#endif
+        return 0;
+    }
+
+    /**
+     * 执行一条shell命令行：不含shell语法的命令按空白切分后直接exec，
+     * 省掉/bin/sh的一次fork/exec；其余情况(或直接exec找不到程序时)走/bin/sh -c
+     */
+    int SpawnCommand(const std::string &cmd, bool force_shell, SpawnOptions options = SpawnOptions()) {
+        std::vector<std::string_view> words;
+        if (!force_shell && SplitCommand(cmd, words)) {
+            options.search_path = true;
+            OwnedStrings argv(words.begin(), words.end());
+            int error = Spawn(argv.data(), options);
+            if (error != ENOENT) {
+                return error;
+            }
+        }
+        options.search_path = false;
+        OwnedStrings argv{"/bin/sh", "-c", cmd};
+        return Spawn(argv.data(), options);
+    }
+
+    // 命令行不需要shell解释时切分成argv并返回true，argv指向cmd内部
+    static bool SplitCommand(const std::string &cmd, std::vector<std::string_view> &argv) {
+        static const char kShellChars[] = "|&;<>()$`\\\"'*?[]#~{}!\n";
+        static const char *kBuiltins[] = {".",        "alias",  "break", "cd",     "command", "continue", "eval",
+                                          "exec",     "exit",   "export", "read", "readonly", "return", "set",
+                                          "shift",    "source", "trap",  "ulimit", "umask",   "unset",    "wait"};
+        if (cmd.find_first_of(kShellChars) != std::string::npos) {
+            return false;
+        }
+        argv.clear();
+        std::size_t pos = 0;
+        while (pos < cmd.size()) {
+            std::size_t begin = cmd.find_first_not_of(" \t", pos);
+            if (begin == std::string::npos) {
+                break;
+            }
+            std::size_t end = cmd.find_first_of(" \t", begin);
+            if (end == std::string::npos) {
+                end = cmd.size();
+            }
+            argv.emplace_back(cmd.data() + begin, end - begin);
+            pos = end;
+        }
+        if (argv.empty() || argv[0].find('=') != std::string::npos) {
+            return false;
+        }
+        for (const char *builtin : kBuiltins) {
+            if (argv[0] == builtin) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    pid_t pid() const { return pid_; }
+
+    // 子进程的stdin，pipe_stdin为false时为-1
+    int in_fd() const { return in_fd_; }
+
+    // 读完或出错后为-1
+    int out_fd() const { return out_fd_; }
+    int err_fd() const { return err_fd_; }
+
+    // 子进程退出时可读，内核不支持pidfd时为-1
+    int pid_fd() const { return pid_fd_; }
+
+    // 从fd读一次交给sink，返回false表示已经读完，fd被关闭
+    static bool ReadOnce(int &fd, const CommandSink &sink, char *buf) {
+        ssize_t n = read(fd, buf, kChunkSize);
+        if (n > 0) {
+            if (sink) {
+                sink(buf, static_cast<std::size_t>(n));
+            }
+            return true;
+        }
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            return true;
+        }
+        CloseFd(fd);
+        return false;
+    }
+
+    bool ReadOut(const CommandSink &sink, char *buf) { return ReadOnce(out_fd_, sink, buf); }
+    bool ReadErr(const CommandSink &sink, char *buf) { return ReadOnce(err_fd_, sink, buf); }
+
+    /**
+     * 向stdin写完整的数据，子进程已经退出时返回false而不是收到SIGPIPE。
+     * timeout大于0时stdin被设成非阻塞，子进程一直不读、超时还没写完时返回false，这时已经写了一部分
+     */
+    bool WriteIn(const char *data, std::size_t len, std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) {
+        if (in_fd_ < 0) {
+            return false;
+        }
+        const bool has_deadline = timeout.count() > 0;
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        if (has_deadline) {
+            fcntl(in_fd_, F_SETFL, fcntl(in_fd_, F_GETFL) | O_NONBLOCK);
+        }
+        sigset_t pipe_set;
+        sigset_t old_set;
+        sigemptyset(&pipe_set);
+        sigaddset(&pipe_set, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+        bool ok = true;
+        while (len > 0) {
+            ssize_t n = write(in_fd_, data, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN && WaitWritable(has_deadline, deadline)) {
+                    continue;
+                }
+                if (errno == EPIPE) {
+                    // 吃掉这次写产生的SIGPIPE，再恢复信号掩码
+                    timespec zero = {0, 0};
+                    sigtimedwait(&pipe_set, nullptr, &zero);
+                }
+                ok = false;
+                break;
+            }
+            data += n;
+            len -= static_cast<std::size_t>(n);
+        }
+        pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+        return ok;
+    }
+
+    void CloseIn() { CloseFd(in_fd_); }
+
+    // 不再关心剩余的输出
+    void ClosePipes() {
+        CloseFd(out_fd_);
+        CloseFd(err_fd_);
+    }
+
+    void Kill() {
+        if (pid_ > 0 && !reaped_) {
+            ::kill(-pid_, SIGKILL);
+        }
+    }
+
+    // 回收子进程并填充退出状态，block为false且子进程还没退出时返回false
+    bool Reap(CommandResult &result, bool block) {
+        if (pid_ <= 0 || reaped_) {
+            return true;
+        }
+        int status = 0;
+        pid_t ret;
+        do {
+            ret = waitpid(pid_, &status, block ? 0 : WNOHANG);
+        } while (ret < 0 && errno == EINTR);
+        if (ret == 0) {
+            return false;
+        }
+        reaped_ = true;
+        if (ret < 0) {
+            result.error = errno;
+        } else if (WIFEXITED(status)) {
+            result.exit_code = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            result.term_signal = WTERMSIG(status);
+        }
+        return true;
+    }
+
+   private:
+    // 等stdin可写，超时返回false
+    bool WaitWritable(bool has_deadline, std::chrono::steady_clock::time_point deadline) {
+        for (;;) {
+            int wait_ms = -1;
+            if (has_deadline) {
+                auto remain = deadline - std::chrono::steady_clock::now();
+                if (remain <= std::chrono::steady_clock::duration::zero()) {
+                    return false;
+                }
+                wait_ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remain).count());
+            }
+            pollfd pfd = {in_fd_, POLLOUT, 0};
+            int ret = poll(&pfd, 1, wait_ms);
+            if (ret > 0) {
+                return true;
+            }
+            if (ret < 0 && errno != EINTR) {
+                return false;
+            }
+        }
+    }
+
+    static void CloseFd(int &fd) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+   private:
+    pid_t pid_ = -1;
+    int in_fd_ = -1;
+    int out_fd_ = -1;
+    int err_fd_ = -1;
+    int pid_fd_ = -1;
+    bool reaped_ = false;
+};
+
 class Command {
    public:
+    using Result = CommandResult;
+    using Options = CommandOptions;
+    using Sink = CommandSink;
+
+    /**
+     * 执行一条shell命令行，stdout/stderr按块流式交给回调，没有长度上限。
+     * 阻塞到命令结束或超时
+     */
+    static Result Run(const std::string &cmd, const Sink &out, const Sink &err = nullptr,
+                      const Options &options = Options()) {
+        Subprocess proc;
+        Result result;
+        result.error = proc.SpawnCommand(cmd, options.force_shell, ToSpawnOptions(options));
+        return RunProcess(proc, result, out, err, options);
+    }
+
+    // 不经过shell，直接按PATH查找argv[0]执行
+    static Result RunArgv(const std::vector<std::string> &argv, const Sink &out, const Sink &err = nullptr,
+                          const Options &options = Options()) {
+        Subprocess proc;
+        Result result;
+        SpawnOptions spawn_options = ToSpawnOptions(options);
+        spawn_options.search_path = true;
+        result.error = proc.Spawn(argv, spawn_options);
+        return RunProcess(proc, result, out, err, options);
+    }
+
+    /**
+     * 异步执行，不占用调用线程：输出和进程退出都由后台的epoll线程(CommandLoop)驱动，
+     * 回调也在那个线程里执行，不能阻塞
+     */
+    static std::future<Result> RunAsync(const std::string &cmd, Sink out, Sink err = nullptr,
+                                        const Options &options = Options());
+
+    // 执行命令并返回stdout，最多保留result_max_size字节，<=0表示不限制
     static std::string RunCmd(const std::string &cmd, int32_t result_max_size = 10240) {
-        char *data = new char[result_max_size];
-        if (data == nullptr) {
-            return std::string("");
-        }
-        bzero(data, sizeof(data));
-        const int max_buffer = 256;
-        char buffer[max_buffer];
-        FILE *fdp = popen(cmd.c_str(), "r");
-        int data_len = 0;
-        if (fdp) {
-            while (!feof(fdp)) {
-                if (fgets(buffer, max_buffer, fdp)) {
-                    int len = strlen(buffer);
-                    if ((data_len + len) > result_max_size) {
-                        break;
+        std::string ret;
+        std::size_t limit = result_max_size > 0 ? static_cast<std::size_t>(result_max_size) : std::string::npos;
+        Run(cmd, [&ret, limit](const char *data, std::size_t len) {
+            if (ret.size() < limit) {
+                ret.append(data, std::min(len, limit - ret.size()));
+            }
+        });
+        return ret;
+    }
+
+    static SpawnOptions ToSpawnOptions(const Options &options) {
+        SpawnOptions spawn_options;
+        spawn_options.stderr_mode = options.merge_stderr ? SpawnOptions::Stderr::kMerge : SpawnOptions::Stderr::kPipe;
+        return spawn_options;
+    }
+
+   private:
+    static Result RunProcess(Subprocess &proc, Result &result, const Sink &out, const Sink &err,
+                             const Options &options) {
+        if (result.error != 0) {
+            return result;
+        }
+        std::unique_ptr<char[]> buf(new char[Subprocess::kChunkSize]);
+        const bool has_deadline = options.timeout.count() > 0;
+        const auto deadline = std::chrono::steady_clock::now() + options.timeout;
+        bool finished = false;
+        while (!finished) {
+            pollfd fds[2];
+            int n = 0;
+            if (proc.out_fd() >= 0) {
+                fds[n++] = {proc.out_fd(), POLLIN, 0};
+            }
+            if (proc.err_fd() >= 0) {
+                fds[n++] = {proc.err_fd(), POLLIN, 0};
+            }
+            // 输出读完后，有超时的话还要等进程退出
+            if (n == 0) {
+                if (!has_deadline) {
+                    break;
+                }
+                if (proc.pid_fd() < 0) {
+                    if (!PollReap(proc, result, deadline)) {
+                        result.timed_out = true;
+                        proc.Kill();
                     }
-                    memcpy(data + data_len, buffer, len);
-                    data_len += len;
+                    break;
+                }
+                fds[n++] = {proc.pid_fd(), POLLIN, 0};
+            }
+            int wait_ms = -1;
+            if (has_deadline) {
+                auto remain = deadline - std::chrono::steady_clock::now();
+                if (remain <= std::chrono::steady_clock::duration::zero()) {
+                    result.timed_out = true;
+                    proc.Kill();
+                    break;
+                }
+                wait_ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remain).count());
+            }
+            int ret = poll(fds, n, wait_ms);
+            if (ret <= 0) {
+                if (ret < 0 && errno != EINTR) {
+                    // 没法再等输出和超时，和超时一样先杀掉进程组，下面阻塞回收时才不会一直等下去
+                    result.error = errno;
+                    proc.Kill();
+                    break;
+                }
+                continue;
+            }
+            for (int i = 0; i < n; ++i) {
+                if (fds[i].revents == 0) {
+                    continue;
+                }
+                if (fds[i].fd == proc.out_fd()) {
+                    proc.ReadOut(out, buf.get());
+                } else if (fds[i].fd == proc.err_fd()) {
+                    proc.ReadErr(options.merge_stderr ? out : err, buf.get());
+                } else {
+                    finished = true;
                 }
             }
-            pclose(fdp);
         }
-        std::string ret = std::string(data, data_len);
-        delete[] data;
-        return ret;
+        proc.ClosePipes();
+        proc.Reap(result, true);
+        return result;
+    }
+
+    // 内核不支持pidfd时按退避间隔轮询回收，到deadline还没退出返回false
+    static bool PollReap(Subprocess &proc, Result &result, std::chrono::steady_clock::time_point deadline) {
+        std::chrono::milliseconds interval(1);
+        while (!proc.Reap(result, false)) {
+            auto remain = deadline - std::chrono::steady_clock::now();
+            if (remain <= std::chrono::steady_clock::duration::zero()) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(interval, remain));
+            interval = std::min(interval * 2, Subprocess::kMaxReapInterval);
+        }
+        return true;
+    }
+};
+
+/**
+ * 异步执行命令的事件循环：一个线程用epoll等待所有子进程的管道和pidfd，
+ * 超时通过epoll_wait的超时时间检查，不需要为每个命令阻塞一个线程
+ */
+class CommandLoop : wzq::NonCopyAble {
+   public:
+    CommandLoop() {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = wake_fd_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+        running_.store(true);
+        thread_ = std::thread([this]() { Loop(); });
+    }
+
+    ~CommandLoop() {
+        running_.store(false);
+        Wake();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        for (auto &job : pending_) {
+            Cancel(*job);
+        }
+        for (auto &kv : jobs_) {
+            Cancel(*kv.second);
+        }
+        close(wake_fd_);
+        close(epoll_fd_);
+    }
+
+    // 进程内共享的事件循环
+    static CommandLoop &Default() {
+        static CommandLoop loop;
+        return loop;
+    }
+
+    // spawn: int(Subprocess&)，创建子进程并返回errno
+    template <typename SpawnFunc>
+    std::future<CommandResult> Submit(SpawnFunc &&spawn, CommandSink out, CommandSink err,
+                                      const CommandOptions &options) {
+        auto job = std::make_unique<Job>();
+        std::future<CommandResult> future = job->promise.get_future();
+        int error = spawn(job->proc);
+        if (error != 0) {
+            job->result.error = error;
+            job->promise.set_value(job->result);
+            return future;
+        }
+        job->out = std::move(out);
+        job->err = options.merge_stderr ? job->out : std::move(err);
+        job->has_deadline = options.timeout.count() > 0;
+        job->deadline = std::chrono::steady_clock::now() + options.timeout;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            pending_.push_back(std::move(job));
+        }
+        Wake();
+        return future;
+    }
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        Subprocess proc;
+        CommandSink out;
+        CommandSink err;
+        bool has_deadline = false;
+        Clock::time_point deadline;
+        bool exited = false;
+        // 没有pidfd时输出读完后由CheckTimeouts轮询回收
+        bool polling = false;
+        Clock::duration reap_interval{};
+        Clock::time_point next_reap;
+        CommandResult result;
+        std::promise<CommandResult> promise;
+    };
+
+    void Wake() {
+        uint64_t one = 1;
+        ssize_t ret = write(wake_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+
+    void Watch(int fd, Job *job) {
+        if (fd < 0) {
+            return;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+        fd_jobs_[fd] = job;
+    }
+
+    void Unwatch(int fd) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        fd_jobs_.erase(fd);
+    }
+
+    void AddPending() {
+        std::vector<std::unique_ptr<Job>> pending;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            pending.swap(pending_);
+        }
+        for (auto &job : pending) {
+            Job *ptr = job.get();
+            Watch(ptr->proc.out_fd(), ptr);
+            Watch(ptr->proc.err_fd(), ptr);
+            Watch(ptr->proc.pid_fd(), ptr);
+            jobs_.emplace(ptr, std::move(job));
+            TryFinish(ptr);
+        }
     }
+
+    void OnReadable(int fd, char *buf) {
+        auto iter = fd_jobs_.find(fd);
+        if (iter == fd_jobs_.end()) {
+            return;
+        }
+        Job *job = iter->second;
+        if (fd == job->proc.out_fd()) {
+            if (!job->proc.ReadOut(job->out, buf)) {
+                Unwatch(fd);
+            }
+        } else if (fd == job->proc.err_fd()) {
+            if (!job->proc.ReadErr(job->err, buf)) {
+                Unwatch(fd);
+            }
+        } else {
+            job->exited = true;
+            Unwatch(fd);
+        }
+        TryFinish(job);
+    }
+
+    // 输出读完且进程已退出才算结束。不能在事件循环里阻塞回收，没有pidfd时回收不了就按退避间隔再试
+    void TryFinish(Job *job) {
+        if (job->proc.out_fd() >= 0 || job->proc.err_fd() >= 0) {
+            return;
+        }
+        if (!job->exited && job->proc.pid_fd() >= 0) {
+            return;
+        }
+        if (!job->proc.Reap(job->result, false)) {
+            job->reap_interval = job->polling ? std::min<Clock::duration>(job->reap_interval * 2,
+                                                                          Subprocess::kMaxReapInterval)
+                                              : std::chrono::milliseconds(1);
+            job->polling = true;
+            job->next_reap = Clock::now() + job->reap_interval;
+            return;
+        }
+        job->promise.set_value(job->result);
+        jobs_.erase(job);
+    }
+
+    static bool Expired(const Job *job, Clock::time_point now) {
+        return job->has_deadline && !job->result.timed_out && job->deadline <= now;
+    }
+
+    // 超时的任务直接杀掉进程组，剩余的输出不再读；轮询回收的任务到点再试一次。返回epoll_wait的超时时间
+    int CheckTimeouts() {
+        auto now = Clock::now();
+        std::vector<Job *> due;
+        for (auto &kv : jobs_) {
+            Job *job = kv.first;
+            if (Expired(job, now) || (job->polling && job->next_reap <= now)) {
+                due.push_back(job);
+            }
+        }
+        for (Job *job : due) {
+            if (Expired(job, now)) {
+                job->result.timed_out = true;
+                job->proc.Kill();
+                if (job->proc.out_fd() >= 0) {
+                    Unwatch(job->proc.out_fd());
+                }
+                if (job->proc.err_fd() >= 0) {
+                    Unwatch(job->proc.err_fd());
+                }
+                job->proc.ClosePipes();
+            }
+            TryFinish(job);
+        }
+        int wait_ms = -1;
+        auto earlier = [&wait_ms, now](Clock::time_point when) {
+            int ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(when - now).count());
+            if (wait_ms < 0 || ms < wait_ms) {
+                wait_ms = std::max(ms, 0);
+            }
+        };
+        for (auto &kv : jobs_) {
+            Job *job = kv.first;
+            if (job->has_deadline && !job->result.timed_out) {
+                earlier(job->deadline);
+            }
+            if (job->polling) {
+                earlier(job->next_reap);
+            }
+        }
+        return wait_ms;
+    }
+
+    void Cancel(Job &job) {
+        job.proc.Kill();
+        job.proc.ClosePipes();
+        job.proc.Reap(job.result, true);
+        job.result.error = ECANCELED;
+        job.promise.set_value(job.result);
+    }
+
+    void Loop() {
+        std::unique_ptr<char[]> buf(new char[Subprocess::kChunkSize]);
+        epoll_event events[64];
+        while (running_.load()) {
+            int wait_ms = CheckTimeouts();
+            int n = epoll_wait(epoll_fd_, events, 64, wait_ms);
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.fd == wake_fd_) {
+                    uint64_t value;
+                    ssize_t ret = read(wake_fd_, &value, sizeof(value));
+                    (void)ret;
+                    AddPending();
+                } else {
+                    OnReadable(events[i].data.fd, buf.get());
+                }
+            }
+        }
+    }
+
+   private:
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> running_;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Job>> pending_;
+
+    // 以下只在事件循环线程中访问
+    std::unordered_map<Job *, std::unique_ptr<Job>> jobs_;
+    std::unordered_map<int, Job *> fd_jobs_;
 };
+
+inline std::future<CommandResult> Command::RunAsync(const std::string &cmd, Sink out, Sink err,
+                                                    const Options &options) {
+    return CommandLoop::Default().Submit(
+        [&cmd, &options](Subprocess &proc) {
+            return proc.SpawnCommand(cmd, options.force_shell, ToSpawnOptions(options));
+        },
+        std::move(out), std::move(err), options);
+}
+
 }  // namespace wzq
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,517 @@
+#ifndef __CONCURRENT_CACHE__
+#define __CONCURRENT_CACHE__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/metrics.h"
+#include "common/noncopyable.h"
+#include "common/object_pool.h"
+
+namespace wzq {
+
+/**
+ * 有容量上限的并发缓存。
+ * key按hash分到多个段，每段一把读写锁；命中只拿读锁，访问记录先写进段内的无锁读缓冲，
+ * 攒够一批或下次拿写锁时再统一调整LRU顺序，读多的场景不会在写锁上排队。
+ *
+ * 淘汰策略：
+ * kSlru: 分段LRU，新数据进试用区，再次命中升到保护区(占80%)，淘汰试用区最久没用的
+ * kTinyLfu: W-TinyLFU，新数据先进1%的窗口LRU，挤出窗口时和试用区的淘汰对象比较访问频率(count-min sketch)，
+ *           频率高的留下，偶尔访问一次的数据扫过时不会把热点挤掉
+ *
+ * 过期：每个key可以带TTL，读时发现过期按未命中处理；过期项在写操作时顺带清理几个，
+ * 也可以调用CleanUp一次清理干净，比如用一个TimerQueue重复定时器周期性调用，代替每个key一个定时器
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ConcurrentCache : NonCopyAble {
+   public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Policy { kSlru = 0, kTinyLfu = 1 };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;    // 因为容量被淘汰的个数
+        uint64_t expirations = 0;  // 因为过期被清理的个数
+        uint64_t rejections = 0;   // TinyLFU拒绝接纳的新数据个数，也算在evictions里
+
+        double HitRate() const {
+            uint64_t total = hits + misses;
+            return total == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(total);
+        }
+    };
+
+    // segment_num会向下取到2的幂，并保证每段至少有kMinSegmentCapacity个位置(容量太小时段数会减少)
+    explicit ConcurrentCache(std::size_t capacity, Policy policy = Policy::kTinyLfu, std::size_t segment_num = 16) {
+        capacity = std::max<std::size_t>(capacity, 1);
+        std::size_t num = 1;
+        while (num * 2 <= segment_num && capacity / (num * 2) >= kMinSegmentCapacity) {
+            num *= 2;
+        }
+        segment_mask_ = num - 1;
+        segments_.reset(new Segment[num]);
+        for (std::size_t i = 0; i < num; ++i) {
+            segments_[i].Init((capacity + num - 1) / num, policy);
+        }
+    }
+
+    ~ConcurrentCache() { Clear(); }
+
+    // 命中时把值拷贝到value
+    bool Get(const K &key, V &value) {
+        const std::size_t hash = Mix(Hash()(key));
+        Segment &seg = SegmentFor(hash);
+        bool hit = false;
+        bool need_drain = false;
+        {
+            std::shared_lock<std::shared_mutex> lock(seg.mutex);
+            auto iter = seg.map.find(key);
+            if (iter != seg.map.end() && !IsExpired(iter->second)) {
+                value = iter->second->value;
+                hit = true;
+                need_drain = seg.RecordRead(iter->second);
+            }
+        }
+        if (hit) {
+            seg.hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            seg.misses.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (need_drain) {
+            // 读缓冲快满了，拿得到写锁就顺便整理，拿不到就交给下一个写操作
+            std::unique_lock<std::shared_mutex> lock(seg.mutex, std::try_to_lock);
+            if (lock.owns_lock()) {
+                seg.DrainReads();
+            }
+        }
+        return hit;
+    }
+
+    void Put(const K &key, V value) { PutImpl(key, std::move(value), 0); }
+
+    // ttl之后过期，ttl<=0的数据放进去就已经过期
+    template <typename Rep, typename Period>
+    void Put(const K &key, V value, std::chrono::duration<Rep, Period> ttl) {
+        int64_t ttl_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(ttl).count();
+        PutImpl(key, std::move(value), NowNs() + std::max<int64_t>(ttl_ns, 0));
+    }
+
+    bool Erase(const K &key) {
+        Segment &seg = SegmentFor(Mix(Hash()(key)));
+        std::unique_lock<std::shared_mutex> lock(seg.mutex);
+        seg.DrainReads();
+        auto iter = seg.map.find(key);
+        if (iter == seg.map.end()) {
+            return false;
+        }
+        seg.Remove(iter->second);
+        return true;
+    }
+
+    // 清理所有已经过期的数据，返回清理的个数
+    std::size_t CleanUp() {
+        const int64_t now = NowNs();
+        std::size_t removed = 0;
+        for (std::size_t i = 0; i <= segment_mask_; ++i) {
+            Segment &seg = segments_[i];
+            std::unique_lock<std::shared_mutex> lock(seg.mutex);
+            seg.DrainReads();
+            removed += seg.Sweep(now, SIZE_MAX);
+        }
+        return removed;
+    }
+
+    void Clear() {
+        for (std::size_t i = 0; i <= segment_mask_; ++i) {
+            Segment &seg = segments_[i];
+            std::unique_lock<std::shared_mutex> lock(seg.mutex);
+            seg.DrainReads();
+            seg.Clear();
+        }
+    }
+
+    // 包含还没清理的过期数据
+    std::size_t Size() const {
+        std::size_t size = 0;
+        for (std::size_t i = 0; i <= segment_mask_; ++i) {
+            size += segments_[i].size.load(std::memory_order_relaxed);
+        }
+        return size;
+    }
+
+    std::size_t Capacity() const { return segments_[0].capacity * (segment_mask_ + 1); }
+
+    Stats GetStats() const {
+        Stats stats;
+        for (std::size_t i = 0; i <= segment_mask_; ++i) {
+            const Segment &seg = segments_[i];
+            stats.hits += seg.hits.load(std::memory_order_relaxed);
+            stats.misses += seg.misses.load(std::memory_order_relaxed);
+            stats.evictions += seg.evictions.load(std::memory_order_relaxed);
+            stats.expirations += seg.expirations.load(std::memory_order_relaxed);
+            stats.rejections += seg.rejections.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+    // 发布prefix.hits/misses/evictions/expirations/rejections/size
+    void PublishMetrics(const std::string &prefix, MetricsRegistry &registry = MetricsRegistry::Global()) {
+        MetricsRegistry::Registration metrics;
+        metrics.Add(registry, prefix + ".hits", [this]() { return static_cast<int64_t>(GetStats().hits); });
+        metrics.Add(registry, prefix + ".misses", [this]() { return static_cast<int64_t>(GetStats().misses); });
+        metrics.Add(registry, prefix + ".evictions", [this]() { return static_cast<int64_t>(GetStats().evictions); });
+        metrics.Add(registry, prefix + ".expirations",
+                    [this]() { return static_cast<int64_t>(GetStats().expirations); });
+        metrics.Add(registry, prefix + ".rejections",
+                    [this]() { return static_cast<int64_t>(GetStats().rejections); });
+        metrics.Add(registry, prefix + ".size", [this]() { return static_cast<int64_t>(Size()); });
+        metrics_ = std::move(metrics);
+    }
+
+   private:
+    static constexpr std::size_t kMinSegmentCapacity = 64;
+    static constexpr std::size_t kReadBufferSize = 64;  // 2的幂
+    static constexpr std::size_t kSweepPerWrite = 4;    // 每次写操作顺带清理的过期项个数上限
+
+    enum class Queue : uint8_t { kWindow = 0, kProbation = 1, kProtected = 2 };
+
+    struct Node {
+        K key;
+        V value;
+        std::size_t hash;
+        int64_t expire_ns;  // 0表示不过期
+        Queue queue;
+        Node *prev = nullptr;
+        Node *next = nullptr;
+        typename std::multimap<int64_t, Node *>::iterator expiry_pos;
+
+        Node(const K &k, V &&v, std::size_t h, int64_t expire) : key(k), value(std::move(v)), hash(h), expire_ns(expire) {}
+    };
+
+    // 侵入式双向链表，头部是最近使用的
+    struct List {
+        Node *head = nullptr;
+        Node *tail = nullptr;
+        std::size_t size = 0;
+
+        void PushFront(Node *node) {
+            node->prev = nullptr;
+            node->next = head;
+            if (head != nullptr) {
+                head->prev = node;
+            } else {
+                tail = node;
+            }
+            head = node;
+            ++size;
+        }
+
+        void Unlink(Node *node) {
+            (node->prev != nullptr ? node->prev->next : head) = node->next;
+            (node->next != nullptr ? node->next->prev : tail) = node->prev;
+            node->prev = node->next = nullptr;
+            --size;
+        }
+
+        void MoveToFront(Node *node) {
+            if (head != node) {
+                Unlink(node);
+                PushFront(node);
+            }
+        }
+    };
+
+    // 4行的count-min sketch，4位饱和计数，总增加次数到采样上限后全部减半，让旧的热点慢慢降温
+    struct FrequencySketch {
+        std::vector<uint8_t> table;
+        std::size_t mask = 0;
+        std::size_t additions = 0;
+        std::size_t sample_size = 0;
+
+        void Init(std::size_t capacity) {
+            std::size_t width = 16;
+            while (width < capacity) {
+                width *= 2;
+            }
+            table.assign(width * 4, 0);
+            mask = width - 1;
+            additions = 0;
+            sample_size = width * 10;
+        }
+
+        std::size_t Index(std::size_t hash, int row) const {
+            static constexpr uint64_t kSeeds[4] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL,
+                                                   0xcbf29ce484222325ULL};
+            uint64_t h = static_cast<uint64_t>(hash) * kSeeds[row];
+            return (static_cast<std::size_t>(h >> 32) & mask) + (mask + 1) * row;
+        }
+
+        void Increment(std::size_t hash) {
+            bool added = false;
+            for (int row = 0; row < 4; ++row) {
+                uint8_t &counter = table[Index(hash, row)];
+                if (counter < 15) {
+                    ++counter;
+                    added = true;
+                }
+            }
+            if (added && ++additions >= sample_size) {
+                for (uint8_t &counter : table) {
+                    counter >>= 1;
+                }
+                additions /= 2;
+            }
+        }
+
+        int Frequency(std::size_t hash) const {
+            int freq = 15;
+            for (int row = 0; row < 4; ++row) {
+                freq = std::min<int>(freq, table[Index(hash, row)]);
+            }
+            return freq;
+        }
+    };
+
+    /**
+     * 一个段：map和链表只在写锁下修改。
+     * 读缓冲在读锁下写入，节点只会在写锁下释放，而每次拿到写锁都先DrainReads，
+     * 所以读缓冲里的指针在被处理之前一定还有效
+     */
+    struct Segment {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<K, Node *, Hash> map;
+        std::multimap<int64_t, Node *> expiry;
+        List window;
+        List probation;
+        List protect;
+        FrequencySketch sketch;
+        Policy policy = Policy::kTinyLfu;
+        std::size_t capacity = 0;
+        std::size_t window_capacity = 0;
+        std::size_t protect_capacity = 0;
+        std::atomic<std::size_t> size{0};
+
+        std::atomic<Node *> reads[kReadBufferSize] = {};
+        std::atomic<uint64_t> read_write{0};
+        uint64_t read_drained = 0;
+
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+        std::atomic<uint64_t> expirations{0};
+        std::atomic<uint64_t> rejections{0};
+
+        void Init(std::size_t cap, Policy p) {
+            policy = p;
+            capacity = cap;
+            window_capacity = (policy == Policy::kTinyLfu && capacity > 1) ? std::max<std::size_t>(capacity / 100, 1) : 0;
+            protect_capacity = (capacity - window_capacity) * 8 / 10;
+            if (policy == Policy::kTinyLfu) {
+                sketch.Init(capacity);
+            }
+            map.reserve(capacity);
+        }
+
+        // 读锁下调用，缓冲满了直接丢弃这次记录；返回true表示该整理了
+        bool RecordRead(Node *node) {
+            uint64_t index = read_write.fetch_add(1, std::memory_order_relaxed);
+            uint64_t pending = index - read_drained;
+            if (pending < kReadBufferSize) {
+                reads[index & (kReadBufferSize - 1)].store(node, std::memory_order_relaxed);
+            }
+            return pending >= kReadBufferSize / 2;
+        }
+
+        // 写锁下调用，此时没有读者，缓冲里记录的位置都已经写好
+        void DrainReads() {
+            uint64_t end = read_write.load(std::memory_order_relaxed);
+            uint64_t num = std::min<uint64_t>(end - read_drained, kReadBufferSize);
+            for (uint64_t i = 0; i < num; ++i) {
+                OnAccess(reads[(read_drained + i) & (kReadBufferSize - 1)].load(std::memory_order_relaxed));
+            }
+            read_drained = end;
+        }
+
+        void OnAccess(Node *node) {
+            if (policy == Policy::kTinyLfu) {
+                sketch.Increment(node->hash);
+            }
+            switch (node->queue) {
+                case Queue::kWindow:
+                    window.MoveToFront(node);
+                    break;
+                case Queue::kProbation:
+                    probation.Unlink(node);
+                    node->queue = Queue::kProtected;
+                    protect.PushFront(node);
+                    if (protect.size > protect_capacity && protect.tail != nullptr) {
+                        Node *demoted = protect.tail;
+                        protect.Unlink(demoted);
+                        demoted->queue = Queue::kProbation;
+                        probation.PushFront(demoted);
+                    }
+                    break;
+                case Queue::kProtected:
+                    protect.MoveToFront(node);
+                    break;
+            }
+        }
+
+        void Put(const K &key, V &&value, std::size_t hash, int64_t expire_ns) {
+            DrainReads();
+            if (!expiry.empty()) {
+                Sweep(NowNs(), kSweepPerWrite);
+            }
+            auto iter = map.find(key);
+            if (iter != map.end()) {
+                Node *node = iter->second;
+                node->value = std::move(value);
+                SetExpire(node, expire_ns);
+                OnAccess(node);
+                return;
+            }
+            Node *node = ObjectPool<Node>::New(key, std::move(value), hash, 0);
+            SetExpire(node, expire_ns);
+            map.emplace(key, node);
+            size.fetch_add(1, std::memory_order_relaxed);
+
+            Node *candidate = nullptr;
+            if (window_capacity > 0) {
+                sketch.Increment(hash);
+                node->queue = Queue::kWindow;
+                window.PushFront(node);
+                if (window.size > window_capacity) {
+                    // 挤出窗口的数据进试用区，下面和试用区最久没用的比频率
+                    candidate = window.tail;
+                    window.Unlink(candidate);
+                    candidate->queue = Queue::kProbation;
+                    probation.PushFront(candidate);
+                }
+            } else {
+                node->queue = Queue::kProbation;
+                probation.PushFront(node);
+            }
+            while (map.size() > capacity) {
+                Node *victim = probation.tail != nullptr ? probation.tail
+                                                          : (protect.tail != nullptr ? protect.tail : window.tail);
+                // SLRU下试用区只剩刚放进来的数据时，淘汰保护区最久没用的
+                if (victim == node && protect.tail != nullptr) {
+                    victim = protect.tail;
+                }
+                if (candidate != nullptr && victim != candidate &&
+                    sketch.Frequency(candidate->hash) <= sketch.Frequency(victim->hash)) {
+                    victim = candidate;
+                    rejections.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (victim == candidate) {
+                    candidate = nullptr;
+                }
+                Remove(victim);
+                evictions.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        void SetExpire(Node *node, int64_t expire_ns) {
+            if (node->expire_ns != 0) {
+                expiry.erase(node->expiry_pos);
+            }
+            node->expire_ns = expire_ns;
+            if (expire_ns != 0) {
+                node->expiry_pos = expiry.emplace(expire_ns, node);
+            }
+        }
+
+        std::size_t Sweep(int64_t now, std::size_t budget) {
+            std::size_t removed = 0;
+            while (removed < budget && !expiry.empty() && expiry.begin()->first <= now) {
+                Remove(expiry.begin()->second);
+                ++removed;
+            }
+            expirations.fetch_add(removed, std::memory_order_relaxed);
+            return removed;
+        }
+
+        void Remove(Node *node) {
+            switch (node->queue) {
+                case Queue::kWindow:
+                    window.Unlink(node);
+                    break;
+                case Queue::kProbation:
+                    probation.Unlink(node);
+                    break;
+                case Queue::kProtected:
+                    protect.Unlink(node);
+                    break;
+            }
+            if (node->expire_ns != 0) {
+                expiry.erase(node->expiry_pos);
+            }
+            map.erase(node->key);
+            size.fetch_sub(1, std::memory_order_relaxed);
+            ObjectPool<Node>::Delete(node);
+        }
+
+        void Clear() {
+            for (auto &kv : map) {
+                ObjectPool<Node>::Delete(kv.second);
+            }
+            map.clear();
+            expiry.clear();
+            window = List();
+            probation = List();
+            protect = List();
+            size.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    static int64_t NowNs() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    static bool IsExpired(const Node *node) { return node->expire_ns != 0 && node->expire_ns <= NowNs(); }
+
+    // std::hash对整数是恒等映射，打散后高位选段、低位给sketch
+    static std::size_t Mix(std::size_t h) {
+        uint64_t x = static_cast<uint64_t>(h);
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return static_cast<std::size_t>(x);
+    }
+
+    Segment &SegmentFor(std::size_t hash) { return segments_[(hash >> 40) & segment_mask_]; }
+
+    // expire_ns为0表示不过期，steady_clock从开机开始计时，正常的过期时间不会是0
+    void PutImpl(const K &key, V &&value, int64_t expire_ns) {
+        const std::size_t hash = Mix(Hash()(key));
+        Segment &seg = SegmentFor(hash);
+        std::unique_lock<std::shared_mutex> lock(seg.mutex);
+        seg.Put(key, std::move(value), hash, expire_ns);
+    }
+
+   private:
+    std::unique_ptr<Segment[]> segments_;
+    std::size_t segment_mask_ = 0;
+
+    MetricsRegistry::Registration metrics_;
+};
+
+}  // namespace wzq
+
+#endif
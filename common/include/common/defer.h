@@ -3,13 +3,17 @@
 
 #include "common/noncopyable.h"
 
+#include <exception>
 #include <functional>
 #include <iostream>
+#include <type_traits>
+#include <utility>
 
 // reference https://github.com/loveyacper/ananas
 
 namespace wzq {
 
+// 类型擦除的版本，需要把不同的清理动作放进同一个容器里时使用
 class ExecuteOnScopeExit : wzq::NonCopyAble {
    public:
     ExecuteOnScopeExit() = default;
@@ -32,12 +36,78 @@ class ExecuteOnScopeExit : wzq::NonCopyAble {
     std::function<void()> func_;
 };
 
+// 什么情况下执行
+enum class ScopeExitPolicy { kAlways = 0, kOnFail = 1, kOnSuccess = 2 };
+
+/**
+ * 按值保存lambda的作用域守卫：没有类型擦除也没有堆分配，析构时的调用可以被内联。
+ * kOnFail只在因为异常离开作用域时执行，kOnSuccess只在正常离开作用域时执行
+ */
+template <typename F, ScopeExitPolicy kPolicy = ScopeExitPolicy::kAlways>
+class ScopeGuard : wzq::NonCopyAble {
+   public:
+    explicit ScopeGuard(F&& f) : func_(std::move(f)) {}
+    explicit ScopeGuard(const F& f) : func_(f) {}
+
+    ScopeGuard(ScopeGuard&& other) noexcept(std::is_nothrow_move_constructible_v<F>)
+        : func_(std::move(other.func_)), dismissed_(other.dismissed_), exceptions_(other.exceptions_) {
+        other.dismissed_ = true;
+    }
+
+    ~ScopeGuard() noexcept(kPolicy != ScopeExitPolicy::kOnSuccess) {
+        if (dismissed_) {
+            return;
+        }
+        if constexpr (kPolicy == ScopeExitPolicy::kAlways) {
+            func_();
+        } else if constexpr (kPolicy == ScopeExitPolicy::kOnFail) {
+            if (std::uncaught_exceptions() > exceptions_) {
+                func_();
+            }
+        } else {
+            if (std::uncaught_exceptions() <= exceptions_) {
+                func_();
+            }
+        }
+    }
+
+    // 取消执行
+    void Dismiss() noexcept { dismissed_ = true; }
+
+   private:
+    F func_;
+    bool dismissed_ = false;
+    int exceptions_ = kPolicy == ScopeExitPolicy::kAlways ? 0 : std::uncaught_exceptions();
+};
+
+template <ScopeExitPolicy kPolicy = ScopeExitPolicy::kAlways, typename F>
+ScopeGuard<std::decay_t<F>, kPolicy> MakeScopeGuard(F&& f) {
+    return ScopeGuard<std::decay_t<F>, kPolicy>(std::forward<F>(f));
+}
+
+// 配合宏使用：ScopeGuardMaker<kPolicy>() + [&]() { ... };
+template <ScopeExitPolicy kPolicy>
+struct ScopeGuardMaker {
+    template <typename F>
+    ScopeGuard<std::decay_t<F>, kPolicy> operator+(F&& f) const {
+        return ScopeGuard<std::decay_t<F>, kPolicy>(std::forward<F>(f));
+    }
+};
+
 }  // namespace wzq
 
 #define _CONCAT(a, b) a##b
-#define _MAKE_DEFER_(line) wzq::ExecuteOnScopeExit _CONCAT(defer, line) = [&]()
+#define _MAKE_DEFER_(line, policy) auto _CONCAT(defer, line) = wzq::ScopeGuardMaker<policy>() + [&]()
 
 #undef WZQ_DEFER
-#define WZQ_DEFER _MAKE_DEFER_(__LINE__)
+#define WZQ_DEFER _MAKE_DEFER_(__LINE__, wzq::ScopeExitPolicy::kAlways)
+
+// 只在抛出异常离开作用域时执行，常用于回滚
+#undef WZQ_DEFER_FAIL
+#define WZQ_DEFER_FAIL _MAKE_DEFER_(__LINE__, wzq::ScopeExitPolicy::kOnFail)
+
+// 只在正常离开作用域时执行
+#undef WZQ_DEFER_SUCCESS
+#define WZQ_DEFER_SUCCESS _MAKE_DEFER_(__LINE__, wzq::ScopeExitPolicy::kOnSuccess)
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,133 @@
+#ifndef __HISTOGRAM__
+#define __HISTOGRAM__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace wzq {
+
+/**
+ * HDR风格的直方图：按最高位分段，每段再线性分成2^kSubBucketBits个桶，
+ * 任意量级的值相对误差都不超过1/2^kSubBucketBits(约0.8%)。
+ * 记录只是一次计算下标和一次加法，不是线程安全的，多线程时每个线程一个再Merge
+ */
+class Histogram {
+   public:
+    static constexpr int kSubBucketBits = 7;
+    static constexpr uint64_t kSubBucketCount = 1ull << kSubBucketBits;
+    static constexpr std::size_t kBucketCount = (64 - kSubBucketBits + 1) * kSubBucketCount;
+
+    Histogram() : counts_(kBucketCount, 0) {}
+
+    void Record(int64_t value, uint64_t count = 1) {
+        uint64_t v = value < 0 ? 0 : static_cast<uint64_t>(value);
+        counts_[IndexOf(v)] += count;
+        total_count_ += count;
+        sum_ += static_cast<double>(v) * count;
+        min_ = std::min(min_, v);
+        max_ = std::max(max_, v);
+    }
+
+    /**
+     * 修正协调遗漏(coordinated omission)：如果一次记录的值比预期间隔大，
+     * 说明期间本该有的那些采样被阻塞了，按间隔依次补上
+     */
+    void RecordCorrected(int64_t value, int64_t expected_interval) {
+        Record(value);
+        if (expected_interval <= 0) {
+            return;
+        }
+        for (int64_t missing = value - expected_interval; missing >= expected_interval;
+             missing -= expected_interval) {
+            Record(missing);
+        }
+    }
+
+    void Merge(const Histogram& other) {
+        for (std::size_t i = 0; i < kBucketCount; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_count_ += other.total_count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    void Reset() {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_count_ = 0;
+        sum_ = 0;
+        min_ = std::numeric_limits<uint64_t>::max();
+        max_ = 0;
+    }
+
+    uint64_t Count() const { return total_count_; }
+    int64_t Min() const { return total_count_ == 0 ? 0 : static_cast<int64_t>(min_); }
+    int64_t Max() const { return static_cast<int64_t>(max_); }
+    double Mean() const { return total_count_ == 0 ? 0 : sum_ / total_count_; }
+
+    // percentile取值[0, 100]，返回所在桶的上界(不超过Max)
+    int64_t Percentile(double percentile) const {
+        if (total_count_ == 0) {
+            return 0;
+        }
+        percentile = std::min(std::max(percentile, 0.0), 100.0);
+        uint64_t target = static_cast<uint64_t>(percentile / 100.0 * total_count_ + 0.5);
+        target = std::max<uint64_t>(target, 1);
+        uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBucketCount; ++i) {
+            seen += counts_[i];
+            if (seen >= target) {
+                return static_cast<int64_t>(std::min(HighestEquivalent(i), max_));
+            }
+        }
+        return Max();
+    }
+
+    // 一行摘要，value_scale用于换算单位，如纳秒记录、微秒输出时传1000
+    std::string Summary(double value_scale = 1.0, const char* unit = "") const {
+        char buf[256];
+        std::snprintf(buf, sizeof(buf),
+                      "count=%llu mean=%.1f%s p50=%.1f%s p99=%.1f%s p999=%.1f%s max=%.1f%s",
+                      static_cast<unsigned long long>(total_count_), Mean() / value_scale, unit,
+                      Percentile(50) / value_scale, unit, Percentile(99) / value_scale, unit,
+                      Percentile(99.9) / value_scale, unit, Max() / value_scale, unit);
+        return buf;
+    }
+
+   private:
+    // [0, 2^k)直接对应；之后第b段覆盖[2^(k+b-1), 2^(k+b))，桶宽2^(b-1)
+    static std::size_t IndexOf(uint64_t v) {
+        if (v < kSubBucketCount) {
+            return static_cast<std::size_t>(v);
+        }
+        int shift = 63 - __builtin_clzll(v) - kSubBucketBits;
+        return static_cast<std::size_t>((shift + 1) * kSubBucketCount + (v >> shift) - kSubBucketCount);
+    }
+
+    static uint64_t HighestEquivalent(std::size_t index) {
+        uint64_t band = index >> kSubBucketBits;
+        uint64_t sub = index & (kSubBucketCount - 1);
+        if (band == 0) {
+            return sub;
+        }
+        uint64_t shift = band - 1;
+        uint64_t lowest = (sub + kSubBucketCount) << shift;
+        return lowest + ((1ull << shift) - 1);
+    }
+
+   private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_count_ = 0;
+    double sum_ = 0;
+    uint64_t min_ = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ = 0;
+};
+
+}  // namespace wzq
+
+#endif
@@ -1,35 +1,48 @@
 #ifndef __THREAD_SAFE_MAP__
 #define __THREAD_SAFE_MAP__
 
+#include <algorithm>
+#include <cstdint>
 #include <map>
+#include <string>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "common/metrics.h"
 
 namespace wzq {
 // thread safe map
 template <typename K, typename V>
 class ThreadSafeMap {
    public:
+    using Map = std::map<K, V>;
+    using SnapshotPtr = std::shared_ptr<const Map>;
+
     void Emplace(const K& key, const V& v) {
         std::unique_lock<std::mutex> lock(mutex_);
-        map_[key] = v;
+        Mutable()[key] = v;
     }
 
     void Emplace(const K& key, V&& v) {
         std::unique_lock<std::mutex> lock(mutex_);
-        map_[key] = std::move(v);
+        Mutable()[key] = std::move(v);
     }
 
     void EraseKey(const K& key) {
         std::unique_lock<std::mutex> lock(mutex_);
-        if (map_.find(key) != map_.end()) {
-            map_.erase(key);
+        if (map_->find(key) != map_->end()) {
+            Mutable().erase(key);
         }
     }
 
     bool GetValueFromKey(const K& key, V& value) {
         std::unique_lock<std::mutex> l(mutex_);
-        if (map_.find(key) != map_.end()) {
-            value = map_[key];
+        auto iter = map_->find(key);
+        if (iter != map_->end()) {
+            value = iter->second;
             return true;
         }
         return false;
@@ -37,19 +50,167 @@ class ThreadSafeMap {
 
     bool IsKeyExist(const K& key) {
         std::unique_lock<std::mutex> l(mutex_);
-        return map_.find(key) != map_.end();
+        return map_->find(key) != map_->end();
     }
 
     std::size_t Size() {
         std::unique_lock<std::mutex> l(mutex_);
-        return map_.size();
+        return map_->size();
+    }
+
+    // 一次加锁查多个key，结果和keys一一对应，不存在的是std::nullopt
+    std::vector<std::optional<V>> MultiGet(const std::vector<K>& keys) {
+        std::vector<std::optional<V>> values;
+        values.reserve(keys.size());
+        std::unique_lock<std::mutex> l(mutex_);
+        for (const K& key : keys) {
+            auto iter = map_->find(key);
+            if (iter != map_->end()) {
+                values.emplace_back(iter->second);
+            } else {
+                values.emplace_back(std::nullopt);
+            }
+        }
+        return values;
+    }
+
+    // 一次加锁写入多个key，已经存在的覆盖；按key升序排好的输入逐个用上一次的位置作提示插入，接近线性
+    void MultiPut(const std::vector<std::pair<K, V>>& kvs) {
+        MultiPutImpl(kvs, [](const V& v) -> const V& { return v; });
+    }
+
+    void MultiPut(std::vector<std::pair<K, V>>&& kvs) {
+        MultiPutImpl(kvs, [](V& v) -> V&& { return std::move(v); });
+    }
+
+    /**
+     * 用kvs整体替换map的内容，适合定期刷新整张表：新map在锁外建好，锁内只交换，
+     * 旧map也在锁外析构，读写线程只会被挡一次交换的时间。kvs里重复的key保留最后一个
+     */
+    void BulkLoad(std::vector<std::pair<K, V>>&& kvs) {
+        auto map = std::make_shared<Map>();
+        auto by_key = [](const std::pair<K, V>& a, const std::pair<K, V>& b) { return a.first < b.first; };
+        if (!std::is_sorted(kvs.begin(), kvs.end(), by_key)) {
+            std::stable_sort(kvs.begin(), kvs.end(), by_key);
+        }
+        for (auto& kv : kvs) {
+            map->insert_or_assign(map->end(), kv.first, std::move(kv.second));
+        }
+        {
+            std::unique_lock<std::mutex> l(mutex_);
+            map_.swap(map);
+            std::atomic_store(&published_, SnapshotPtr());
+        }
+    }
+
+    // 一次加锁删除所有满足pred(key, value)的项，返回删除的个数
+    template <typename Pred>
+    std::size_t EraseIf(Pred&& pred) {
+        std::unique_lock<std::mutex> l(mutex_);
+        auto iter = map_->begin();
+        while (iter != map_->end() && !pred(iter->first, iter->second)) {
+            ++iter;
+        }
+        if (iter == map_->end()) {
+            return 0;
+        }
+        // 有要删的才拷贝，拷贝之后旧的迭代器失效，从同一个key接着删
+        const K first = iter->first;
+        Map& map = Mutable();
+        iter = map.erase(map.find(first));
+        std::size_t erased = 1;
+        while (iter != map.end()) {
+            if (pred(iter->first, iter->second)) {
+                iter = map.erase(iter);
+                ++erased;
+            } else {
+                ++iter;
+            }
+        }
+        return erased;
+    }
+
+    // 持有锁按key顺序遍历，func(key, value)里不能再调用这个map的接口；耗时的遍历用Snapshot
+    template <typename F>
+    void ForEach(F&& func) {
+        std::unique_lock<std::mutex> l(mutex_);
+        for (const auto& kv : *map_) {
+            func(kv.first, kv.second);
+        }
+    }
+
+    /**
+     * 某一时刻的只读副本，拿到后可以在锁外随便遍历。快照和map共享同一份数据，不拷贝：
+     * 上次写之后已经取过快照时只是原子地读一次指针，否则加锁发布当前的map；
+     * 之后第一次写发现数据被快照共享，才拷贝一份再改(copy-on-write)
+     */
+    SnapshotPtr Snapshot() {
+        SnapshotPtr snapshot = std::atomic_load(&published_);
+        if (snapshot == nullptr) {
+            std::unique_lock<std::mutex> l(mutex_);
+            if (published_ == nullptr) {
+                std::atomic_store(&published_, SnapshotPtr(map_));
+            }
+            snapshot = published_;
+        }
+        return snapshot;
+    }
+
+    // 发布prefix.size
+    void PublishMetrics(const std::string& prefix, MetricsRegistry& registry = MetricsRegistry::Global()) {
+        MetricsRegistry::Registration metrics;
+        metrics.Add(registry, prefix + ".size", [this]() { return static_cast<int64_t>(Size()); });
+        metrics_ = std::move(metrics);
     }
 
    private:
-    std::map<K, V> map_;
+    /**
+     * 写之前在锁里调用：撤下已发布的快照，数据还被快照持有时拷贝一份再改，否则原地改。
+     * 撤下之后新的Snapshot拿不到旧数据，use_count只会变小，等于1说明没有别人在读
+     */
+    Map& Mutable() {
+        if (published_ != nullptr) {
+            std::atomic_store(&published_, SnapshotPtr());
+        }
+        if (map_.use_count() > 1) {
+            map_ = std::make_shared<Map>(*map_);
+        }
+        return *map_;
+    }
+
+    template <typename Kvs, typename Forward>
+    void MultiPutImpl(Kvs& kvs, Forward forward) {
+        if (kvs.empty()) {
+            return;
+        }
+        auto by_key = [](const std::pair<K, V>& a, const std::pair<K, V>& b) { return a.first < b.first; };
+        const bool sorted = std::is_sorted(kvs.begin(), kvs.end(), by_key);
+        std::unique_lock<std::mutex> l(mutex_);
+        Map& map = Mutable();
+        if (sorted) {
+            auto hint = map.lower_bound(kvs.front().first);
+            for (auto& kv : kvs) {
+                hint = map.insert_or_assign(hint, kv.first, forward(kv.second));
+                ++hint;
+            }
+        } else {
+            for (auto& kv : kvs) {
+                map.insert_or_assign(kv.first, forward(kv.second));
+            }
+        }
+    }
+
+   private:
+    // 由mutex_保护；上次写之后取过快照时和published_指向同一份数据
+    std::shared_ptr<Map> map_ = std::make_shared<Map>();
     std::mutex mutex_;
+
+    // 上次写之后发布的快照，没有时为空。读用std::atomic_load，只在持有mutex_时修改
+    SnapshotPtr published_;
+
+    MetricsRegistry::Registration metrics_;
 };
 
 }  // namespace wzq
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,246 @@
+#ifndef __METRICS__
+#define __METRICS__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/histogram.h"
+#include "common/noncopyable.h"
+
+namespace wzq {
+
+namespace internal {
+
+// 每个线程第一次用时分到一个固定的槽号，之后只是读一个thread_local(常量初始化，没有初始化检查)
+inline std::size_t ThreadStripe() {
+    static std::atomic<std::size_t> next{0};
+    static thread_local std::size_t stripe = SIZE_MAX;
+    if (stripe == SIZE_MAX) {
+        stripe = next.fetch_add(1, std::memory_order_relaxed);
+    }
+    return stripe;
+}
+
+}  // namespace internal
+
+/**
+ * 分片计数器：每个线程固定写其中一个按缓存行对齐的槽，不同线程的加法不会争同一条缓存行，
+ * 读的时候把所有槽加起来。适合写多读少的统计，比如每个任务加一次的计数
+ */
+class StripedCounter : NonCopyAble {
+   public:
+    static constexpr std::size_t kStripes = 16;
+
+    StripedCounter() = default;
+
+    void Add(int64_t n = 1) {
+        slots_[internal::ThreadStripe() % kStripes].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // 并发加的时候读到的是某个中间值，但不会漏加也不会重复
+    int64_t Value() const {
+        int64_t sum = 0;
+        for (const Slot &slot : slots_) {
+            sum += slot.value.load(std::memory_order_relaxed);
+        }
+        return sum;
+    }
+
+    void Reset() {
+        for (Slot &slot : slots_) {
+            slot.value.store(0, std::memory_order_relaxed);
+        }
+    }
+
+   private:
+    struct alignas(64) Slot {
+        std::atomic<int64_t> value{0};
+    };
+
+    Slot slots_[kStripes];
+};
+
+// 瞬时值，比如队列长度、线程数；Set之间互相覆盖，不需要分片
+class Gauge : NonCopyAble {
+   public:
+    Gauge() = default;
+
+    void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+    void Add(int64_t n) { value_.fetch_add(n, std::memory_order_relaxed); }
+    int64_t Value() const { return value_.load(std::memory_order_relaxed); }
+
+   private:
+    std::atomic<int64_t> value_{0};
+};
+
+/**
+ * 分片直方图：每个分片一个Histogram加一把锁，线程按固定分片记录，锁基本没有竞争；
+ * Snapshot把所有分片合并成一个Histogram
+ */
+class StripedHistogram : NonCopyAble {
+   public:
+    static constexpr std::size_t kStripes = 4;
+
+    StripedHistogram() = default;
+
+    void Record(int64_t value) {
+        Stripe &stripe = stripes_[internal::ThreadStripe() % kStripes];
+        std::unique_lock<std::mutex> lock(stripe.mutex);
+        stripe.histogram.Record(value);
+    }
+
+    Histogram Snapshot() const {
+        Histogram merged;
+        for (const Stripe &stripe : stripes_) {
+            std::unique_lock<std::mutex> lock(stripe.mutex);
+            merged.Merge(stripe.histogram);
+        }
+        return merged;
+    }
+
+    void Reset() {
+        for (Stripe &stripe : stripes_) {
+            std::unique_lock<std::mutex> lock(stripe.mutex);
+            stripe.histogram.Reset();
+        }
+    }
+
+   private:
+    struct alignas(64) Stripe {
+        mutable std::mutex mutex;
+        Histogram histogram;
+    };
+
+    Stripe stripes_[kStripes];
+};
+
+/**
+ * 全局指标注册表，库里的线程池、定时器、map等都把指标发布到这里，DumpText一次看全部。
+ * 两种指标：
+ * 1. GetCounter/GetGauge/GetHistogram按名字取(不存在就创建)，返回的引用一直有效，热路径上缓存引用直接用；
+ * 2. 用Registration::Add注册一个读取函数，只在Dump时(持有注册表的锁)调用，对象已有的计数不用再多写一份，
+ *    回调里不能再调用注册表的接口。Registration析构时注销，放在对象的最后一个成员里，对象析构时先注销
+ */
+class MetricsRegistry : NonCopyAble {
+   public:
+    class Registration : NonCopyAble {
+       public:
+        Registration() = default;
+        Registration(Registration &&other) noexcept : registry_(other.registry_), ids_(std::move(other.ids_)) {
+            other.registry_ = nullptr;
+        }
+        Registration &operator=(Registration &&other) noexcept {
+            if (this != &other) {
+                Reset();
+                registry_ = other.registry_;
+                ids_ = std::move(other.ids_);
+                other.registry_ = nullptr;
+            }
+            return *this;
+        }
+        ~Registration() { Reset(); }
+
+        // 注销之后Dump就不会再调用这些回调，正在执行的Dump会先结束
+        void Reset() {
+            if (registry_ != nullptr) {
+                registry_->Remove(ids_);
+                registry_ = nullptr;
+                ids_.clear();
+            }
+        }
+
+        void Add(MetricsRegistry &registry, const std::string &name, std::function<int64_t()> read) {
+            registry_ = &registry;
+            ids_.push_back(registry.AddCallback(name, std::move(read)));
+        }
+
+       private:
+        MetricsRegistry *registry_ = nullptr;
+        std::vector<uint64_t> ids_;
+    };
+
+    // 进程内共用的注册表，不析构，静态对象析构阶段也可以用
+    static MetricsRegistry &Global() {
+        static MetricsRegistry *registry = new MetricsRegistry();
+        return *registry;
+    }
+
+    StripedCounter &GetCounter(const std::string &name) { return GetOrCreate(counters_, name); }
+    Gauge &GetGauge(const std::string &name) { return GetOrCreate(gauges_, name); }
+    StripedHistogram &GetHistogram(const std::string &name) { return GetOrCreate(histograms_, name); }
+
+    // 每行一个指标，按名字排序：name value；直方图是name count=... p50=...
+    std::string DumpText() const {
+        std::map<std::string, std::string> lines;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (const auto &kv : counters_) {
+                lines[kv.first] = std::to_string(kv.second->Value());
+            }
+            for (const auto &kv : gauges_) {
+                lines[kv.first] = std::to_string(kv.second->Value());
+            }
+            for (const auto &kv : histograms_) {
+                lines[kv.first] = kv.second->Snapshot().Summary();
+            }
+            for (const auto &kv : callbacks_) {
+                lines[kv.second.first] = std::to_string(kv.second.second());
+            }
+        }
+        std::string text;
+        for (const auto &kv : lines) {
+            text += kv.first;
+            text += ' ';
+            text += kv.second;
+            text += '\n';
+        }
+        return text;
+    }
+
+   private:
+    MetricsRegistry() = default;
+
+    template <typename T>
+    T &GetOrCreate(std::map<std::string, std::unique_ptr<T>> &metrics, const std::string &name) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::unique_ptr<T> &metric = metrics[name];
+        if (metric == nullptr) {
+            metric.reset(new T());
+        }
+        return *metric;
+    }
+
+    uint64_t AddCallback(const std::string &name, std::function<int64_t()> read) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t id = next_id_++;
+        callbacks_.emplace(id, std::make_pair(name, std::move(read)));
+        return id;
+    }
+
+    void Remove(const std::vector<uint64_t> &ids) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (uint64_t id : ids) {
+            callbacks_.erase(id);
+        }
+    }
+
+   private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<StripedCounter>> counters_;
+    std::map<std::string, std::unique_ptr<Gauge>> gauges_;
+    std::map<std::string, std::unique_ptr<StripedHistogram>> histograms_;
+    std::map<uint64_t, std::pair<std::string, std::function<int64_t()>>> callbacks_;
+    uint64_t next_id_ = 0;
+};
+
+}  // namespace wzq
+
+#endif
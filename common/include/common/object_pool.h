@@ -0,0 +1,226 @@
+#ifndef __OBJECT_POOL__
+#define __OBJECT_POOL__
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace wzq {
+
+/**
+ * 固定大小的内存块池，同一种(kSize, kAlign)在进程内共享一个池
+ *
+ * 每个线程有自己的空闲链表，Allocate/Deallocate在本线程内无锁完成；
+ * 本线程的空闲块攒多了会成批归还到全局仓库，其它线程空闲链表为空时再成批取走，
+ * 所以A线程申请、B线程释放的块(跨线程归还)也能被重新利用。
+ * 申请出去的大块内存不会还给系统。
+ */
+template <std::size_t kSize, std::size_t kAlign = alignof(std::max_align_t)>
+class FixedSizePool {
+   public:
+    static constexpr std::size_t kBlockAlign = kAlign > alignof(void *) ? kAlign : alignof(void *);
+    static constexpr std::size_t kBlockSize =
+        ((kSize > sizeof(void *) ? kSize : sizeof(void *)) + kBlockAlign - 1) / kBlockAlign * kBlockAlign;
+    // 线程与仓库之间每次搬运的块数，大约16KB一批
+    static constexpr std::size_t kBatchSize =
+        kBlockSize >= 2048 ? 8 : (16384 / kBlockSize > 256 ? 256 : 16384 / kBlockSize);
+
+    static void *Allocate() {
+        LocalCache &cache = GetLocalCache();
+        if (cache.head == nullptr) {
+            Refill(cache);
+        }
+        FreeBlock *block = cache.head;
+        cache.head = block->next;
+        --cache.count;
+        return block;
+    }
+
+    static void Deallocate(void *ptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+        LocalCache &cache = GetLocalCache();
+        FreeBlock *block = static_cast<FreeBlock *>(ptr);
+        block->next = cache.head;
+        cache.head = block;
+        ++cache.count;
+        if (cache.count >= 2 * kBatchSize || cache.exited) {
+            Spill(cache, cache.exited ? cache.count : kBatchSize);
+        }
+    }
+
+   private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct Batch {
+        FreeBlock *head;
+        std::size_t count;
+    };
+
+    // 必须是平凡析构的，线程退出后(其它thread_local析构时)仍可能被访问
+    struct LocalCache {
+        FreeBlock *head;
+        std::size_t count;
+        bool registered;
+        bool exited;
+    };
+
+    struct Depot {
+        std::mutex mutex;
+        std::vector<Batch> batches;
+        std::vector<void *> chunks;
+    };
+
+    // 线程退出时把本线程的空闲块全部还给仓库
+    struct CacheFlusher {
+        ~CacheFlusher() {
+            LocalCache &cache = local_cache_;
+            Spill(cache, cache.count);
+            cache.exited = true;
+        }
+    };
+
+    static LocalCache &GetLocalCache() {
+        LocalCache &cache = local_cache_;
+        if (!cache.registered) {
+            cache.registered = true;
+            static thread_local CacheFlusher flusher;
+            (void)flusher;
+        }
+        return cache;
+    }
+
+    // 仓库故意不析构，避免静态对象析构后还有线程在归还内存
+    static Depot &GetDepot() {
+        static Depot *depot = new Depot();
+        return *depot;
+    }
+
+    static void Refill(LocalCache &cache) {
+        Depot &depot = GetDepot();
+        {
+            std::unique_lock<std::mutex> lock(depot.mutex);
+            if (!depot.batches.empty()) {
+                Batch batch = depot.batches.back();
+                depot.batches.pop_back();
+                cache.head = batch.head;
+                cache.count = batch.count;
+                return;
+            }
+        }
+        char *chunk = static_cast<char *>(::operator new(kBlockSize * kBatchSize, std::align_val_t(kBlockAlign)));
+        for (std::size_t i = 0; i < kBatchSize; ++i) {
+            FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + i * kBlockSize);
+            block->next = i + 1 < kBatchSize ? reinterpret_cast<FreeBlock *>(chunk + (i + 1) * kBlockSize) : nullptr;
+        }
+        cache.head = reinterpret_cast<FreeBlock *>(chunk);
+        cache.count = kBatchSize;
+        std::unique_lock<std::mutex> lock(depot.mutex);
+        depot.chunks.push_back(chunk);
+    }
+
+    static void Spill(LocalCache &cache, std::size_t num) {
+        if (num == 0) {
+            return;
+        }
+        Batch batch{cache.head, num};
+        FreeBlock *tail = cache.head;
+        for (std::size_t i = 1; i < num; ++i) {
+            tail = tail->next;
+        }
+        cache.head = tail->next;
+        cache.count -= num;
+        tail->next = nullptr;
+        Depot &depot = GetDepot();
+        std::unique_lock<std::mutex> lock(depot.mutex);
+        depot.batches.push_back(batch);
+    }
+
+    static thread_local LocalCache local_cache_;
+};
+
+template <std::size_t kSize, std::size_t kAlign>
+thread_local typename FixedSizePool<kSize, kAlign>::LocalCache FixedSizePool<kSize, kAlign>::local_cache_ = {
+    nullptr, 0, false, false};
+
+// 对象池，T的内存从FixedSizePool中分配
+template <typename T>
+class ObjectPool {
+   public:
+    using Pool = FixedSizePool<sizeof(T), alignof(T)>;
+
+    struct Deleter {
+        void operator()(T *ptr) const { ObjectPool::Delete(ptr); }
+    };
+    using UniquePtr = std::unique_ptr<T, Deleter>;
+
+    template <typename... Args>
+    static T *New(Args &&... args) {
+        void *ptr = Pool::Allocate();
+        try {
+            return ::new (ptr) T(std::forward<Args>(args)...);
+        } catch (...) {
+            Pool::Deallocate(ptr);
+            throw;
+        }
+    }
+
+    static void Delete(T *ptr) {
+        if (ptr == nullptr) {
+            return;
+        }
+        ptr->~T();
+        Pool::Deallocate(ptr);
+    }
+
+    template <typename... Args>
+    static UniquePtr MakeUnique(Args &&... args) {
+        return UniquePtr(New(std::forward<Args>(args)...));
+    }
+};
+
+// 标准分配器接口，单个对象走FixedSizePool，数组走默认的operator new
+// 可用于std::allocate_shared，控制块和对象一起从池里分配
+template <typename T>
+class PoolAllocator {
+   public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n) {
+        if (n == 1) {
+            return static_cast<T *>(FixedSizePool<sizeof(T), alignof(T)>::Allocate());
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        if (n == 1) {
+            FixedSizePool<sizeof(T), alignof(T)>::Deallocate(ptr);
+        } else {
+            ::operator delete(ptr, std::align_val_t(alignof(T)));
+        }
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U> &) const noexcept {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U> &) const noexcept {
+        return false;
+    }
+};
+
+}  // namespace wzq
+
+#endif
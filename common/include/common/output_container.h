@@ -0,0 +1,315 @@
+#ifndef __OUTPUT_CONTAINER__
+#define __OUTPUT_CONTAINER__
+
+#include <charconv>     // std::to_chars
+#include <cstring>      // std::memcpy
+#include <memory>       // std::unique_ptr
+#include <ostream>      // std::ostream
+#include <sstream>      // std::ostringstream
+#include <string>       // std::string
+#include <string_view>  // std::string_view
+#include <tuple>        // std::tuple/apply
+#include <type_traits>  // std::false_type/true_type/decay_t/is_same_v
+#include <utility>      // std::declval/pair
+
+namespace wzq {
+
+// Type trait to detect std::pair
+template <typename T>
+struct is_pair : std::false_type {};
+template <typename T, typename U>
+struct is_pair<std::pair<T, U>> : std::true_type {};
+template <typename T>
+inline constexpr bool is_pair_v = is_pair<T>::value;
+
+// Type trait to detect std::tuple
+template <typename T>
+struct is_tuple : std::false_type {};
+template <typename... Ts>
+struct is_tuple<std::tuple<Ts...>> : std::true_type {};
+template <typename T>
+inline constexpr bool is_tuple_v = is_tuple<T>::value;
+
+// Type trait to detect whether an output function already exists
+template <typename T>
+struct has_output_function {
+    template <class U>
+    static auto output(U* ptr) -> decltype(std::declval<std::ostream&>() << *ptr, std::true_type());
+    template <class U>
+    static std::false_type output(...);
+    static constexpr bool value = decltype(output<T>(nullptr))::value;
+};
+template <typename T>
+inline constexpr bool has_output_function_v = has_output_function<T>::value;
+/* NB: Visual Studio 2017 (or below) may have problems with
+ *     has_output_function_v<T>: you should then use
+ *     has_output_function<T>::value instead, or upgrade to
+ *     Visual Studio 2019. */
+
+// Type trait to detect containers (anything with begin()/end())
+template <typename T, typename = void>
+struct is_container : std::false_type {};
+template <typename T>
+struct is_container<T, std::void_t<decltype(std::declval<const T&>().begin(), std::declval<const T&>().end())>>
+    : std::true_type {};
+template <typename T>
+inline constexpr bool is_container_v = is_container<T>::value;
+
+// Type trait to detect containers that define a key_type (map-like)
+template <typename T, typename = void>
+struct has_key_type : std::false_type {};
+template <typename T>
+struct has_key_type<T, std::void_t<typename T::key_type>> : std::true_type {};
+
+/**
+ * 格式化输出用的缓冲区：直接往一块预先分配好的char数组里写，写满max_bytes后截断，
+ * 之后的写入都被丢弃，truncated()返回true
+ */
+class FormatBuffer {
+   public:
+    static constexpr std::size_t kNoLimit = static_cast<std::size_t>(-1);
+
+    // 自己管理内存，按需扩容，最多max_bytes字节
+    explicit FormatBuffer(std::size_t max_bytes = kNoLimit, std::size_t initial_size = 4096)
+        : max_bytes_(max_bytes) {
+        std::size_t size = initial_size < max_bytes ? initial_size : max_bytes;
+        owned_.reset(new char[size == 0 ? 1 : size]);
+        begin_ = cur_ = owned_.get();
+        end_ = begin_ + size;
+    }
+
+    // 写到调用方提供的buffer里，最多size字节
+    FormatBuffer(char* buf, std::size_t size) : begin_(buf), cur_(buf), end_(buf + size), max_bytes_(size) {}
+
+    FormatBuffer(const FormatBuffer&) = delete;
+    FormatBuffer& operator=(const FormatBuffer&) = delete;
+
+    void Append(const char* data, std::size_t len) {
+        if (static_cast<std::size_t>(end_ - cur_) < len && !Reserve(len)) {
+            len = static_cast<std::size_t>(end_ - cur_);
+            truncated_ = true;
+        }
+        std::memcpy(cur_, data, len);
+        cur_ += len;
+    }
+
+    void Append(std::string_view str) { Append(str.data(), str.size()); }
+
+    void Append(char c) {
+        if (cur_ == end_ && !Reserve(1)) {
+            truncated_ = true;
+            return;
+        }
+        *cur_++ = c;
+    }
+
+    template <typename T>
+    void AppendNumber(T value) {
+        constexpr std::size_t kMaxNumberLen = 64;
+        if (static_cast<std::size_t>(end_ - cur_) >= kMaxNumberLen || Reserve(kMaxNumberLen)) {
+            cur_ = std::to_chars(cur_, end_, value).ptr;
+            return;
+        }
+        char tmp[kMaxNumberLen];
+        char* end = std::to_chars(tmp, tmp + kMaxNumberLen, value).ptr;
+        Append(tmp, static_cast<std::size_t>(end - tmp));
+    }
+
+    // 已经写满，后面的输出都会被丢弃
+    bool Full() const { return truncated_; }
+    bool truncated() const { return truncated_; }
+
+    std::size_t size() const { return static_cast<std::size_t>(cur_ - begin_); }
+    const char* data() const { return begin_; }
+    std::string_view view() const { return std::string_view(begin_, size()); }
+    std::string str() const { return std::string(begin_, size()); }
+
+    void Clear() {
+        cur_ = begin_;
+        truncated_ = false;
+    }
+
+   private:
+    // 保证还能再写len字节，受max_bytes限制时返回false
+    bool Reserve(std::size_t len) {
+        if (owned_ == nullptr) {
+            return false;
+        }
+        std::size_t used = size();
+        std::size_t capacity = static_cast<std::size_t>(end_ - begin_);
+        if (capacity >= max_bytes_) {
+            return false;
+        }
+        std::size_t new_capacity = capacity * 2 > used + len ? capacity * 2 : used + len;
+        if (new_capacity > max_bytes_) {
+            new_capacity = max_bytes_;
+        }
+        std::unique_ptr<char[]> buf(new char[new_capacity]);
+        std::memcpy(buf.get(), begin_, used);
+        owned_ = std::move(buf);
+        begin_ = owned_.get();
+        cur_ = begin_ + used;
+        end_ = begin_ + new_capacity;
+        return used + len <= new_capacity;
+    }
+
+   private:
+    std::unique_ptr<char[]> owned_;
+    char* begin_ = nullptr;
+    char* cur_ = nullptr;
+    char* end_ = nullptr;
+    std::size_t max_bytes_;
+    bool truncated_ = false;
+};
+
+/**
+ * 和下面的operator<<输出格式相同，但不经过std::ostream：
+ * 数字用std::to_chars，字符串直接拷贝，嵌套的容器/pair/tuple递归展开，
+ * 其它有operator<<的类型才退化为ostringstream
+ */
+template <typename T>
+void FormatTo(FormatBuffer& buf, const T& value);
+
+template <typename Cont, typename T>
+void FormatElement(FormatBuffer& buf, const T& element) {
+    if constexpr (has_key_type<Cont>::value && is_pair_v<T>) {
+        FormatTo(buf, element.first);
+        buf.Append(" => ", 4);
+        FormatTo(buf, element.second);
+    } else {
+        FormatTo(buf, element);
+    }
+}
+
+template <typename Tuple, std::size_t... Is>
+void FormatTuple(FormatBuffer& buf, const Tuple& value, std::index_sequence<Is...>) {
+    buf.Append('(');
+    ((buf.Append(Is == 0 ? "" : ", ", Is == 0 ? 0 : 2), FormatTo(buf, std::get<Is>(value))), ...);
+    buf.Append(')');
+}
+
+template <typename T>
+void FormatTo(FormatBuffer& buf, const T& value) {
+    using std::decay_t;
+    using std::is_same_v;
+
+    if constexpr (is_same_v<T, bool>) {
+        buf.Append(value ? '1' : '0');
+    } else if constexpr (is_same_v<T, char> || is_same_v<T, signed char> || is_same_v<T, unsigned char>) {
+        buf.Append(static_cast<char>(value));
+    } else if constexpr (std::is_arithmetic_v<T>) {
+        buf.AppendNumber(value);
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        buf.Append(std::string_view(value));
+    } else if constexpr (is_pair_v<T>) {
+        buf.Append('(');
+        FormatTo(buf, value.first);
+        buf.Append(", ", 2);
+        FormatTo(buf, value.second);
+        buf.Append(')');
+    } else if constexpr (is_tuple_v<T>) {
+        FormatTuple(buf, value, std::make_index_sequence<std::tuple_size_v<T>>());
+    } else if constexpr (is_container_v<T>) {
+        using element_type = decay_t<decltype(*value.begin())>;
+        if constexpr (is_same_v<element_type, char>) {
+            for (auto it = value.begin(); it != value.end() && *it != '\0'; ++it) {
+                buf.Append(*it);
+            }
+        } else {
+            buf.Append('{');
+            bool on_first_element = true;
+            for (auto it = value.begin(); it != value.end() && !buf.Full(); ++it) {
+                buf.Append(on_first_element ? " " : ", ", on_first_element ? 1 : 2);
+                on_first_element = false;
+                FormatElement<T>(buf, *it);
+            }
+            buf.Append(on_first_element ? "}" : " }", on_first_element ? 1 : 2);
+        }
+    } else {
+        static_assert(has_output_function_v<T>, "FormatTo: type is not printable");
+        std::ostringstream os;
+        os << value;
+        buf.Append(os.str());
+    }
+}
+
+// 格式化成字符串，最多max_bytes字节
+template <typename T>
+std::string FormatToString(const T& value, std::size_t max_bytes = FormatBuffer::kNoLimit) {
+    FormatBuffer buf(max_bytes);
+    FormatTo(buf, value);
+    return buf.str();
+}
+
+}  // namespace wzq
+
+// Output function for std::pair
+template <typename T, typename U>
+std::ostream& operator<<(std::ostream& os, const std::pair<T, U>& pr);
+
+// Element output function for containers that define a key_type and
+// have its value type as std::pair
+template <typename T, typename Cont>
+auto output_element(std::ostream& os, const T& element, const Cont&, const std::true_type)
+    -> decltype(std::declval<typename Cont::key_type>(), os);
+// Element output function for other containers
+template <typename T, typename Cont>
+auto output_element(std::ostream& os, const T& element, const Cont&, ...) -> decltype(os);
+
+// Main output function, enabled only if no output function already exists
+template <typename T, typename = std::enable_if_t<!wzq::has_output_function_v<T>>>
+auto operator<<(std::ostream& os, const T& container) -> decltype(container.begin(), container.end(), os) {
+    using std::decay_t;
+    using std::is_same_v;
+
+    using element_type = decay_t<decltype(*container.begin())>;
+    constexpr bool is_char_v = is_same_v<element_type, char>;
+    if constexpr (!is_char_v) {
+        os << '{';
+    }
+    auto end = container.end();
+    bool on_first_element = true;
+    for (auto it = container.begin(); it != end; ++it) {
+        if constexpr (is_char_v) {
+            if (*it == '\0') {
+                break;
+            }
+        } else {
+            if (!on_first_element) {
+                os << ", ";
+            } else {
+                os << ' ';
+                on_first_element = false;
+            }
+        }
+        output_element(os, *it, container, wzq::is_pair<element_type>());
+    }
+    if constexpr (!is_char_v) {
+        if (!on_first_element) {  // Not empty
+            os << ' ';
+        }
+        os << '}';
+    }
+    return os;
+}
+
+template <typename T, typename Cont>
+auto output_element(std::ostream& os, const T& element, const Cont&, const std::true_type)
+    -> decltype(std::declval<typename Cont::key_type>(), os) {
+    os << element.first << " => " << element.second;
+    return os;
+}
+
+template <typename T, typename Cont>
+auto output_element(std::ostream& os, const T& element, const Cont&, ...) -> decltype(os) {
+    os << element;
+    return os;
+}
+
+template <typename T, typename U>
+std::ostream& operator<<(std::ostream& os, const std::pair<T, U>& pr) {
+    os << '(' << pr.first << ", " << pr.second << ')';
+    return os;
+}
+
+#endif
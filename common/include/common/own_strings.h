@@ -3,40 +3,95 @@
 
 #include "common/noncopyable.h"
 
-#include <algorithm>
+#include <cstring>
+#include <initializer_list>
 #include <iostream>
+#include <new>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace wzq {
 
+/**
+ * argv/envp风格的char**，以nullptr结尾。
+ * 指针数组和所有字符串放在同一块内存里：[char* x (n+1)][str0\0][str1\0]...，
+ * 一次分配，Assign时容量够用就复用原来的内存
+ */
 class OwnedStrings : wzq::NonCopyAble {
    public:
-    OwnedStrings(const std::vector<std::string> &src) {
-        char_ptr_vec.reserve(src.size() + 1);
-        std::transform(src.begin(), src.end(), char_ptr_vec.begin(), [](const std::string &str) {
-            char *buffer = new char[str.size() + 1];
-            std::copy(str.begin(), str.end(), buffer);
-            buffer[str.size()] = 0;
-            return buffer;
-        });
-        char_ptr_vec.push_back(nullptr);
+    OwnedStrings() = default;
+
+    OwnedStrings(const std::vector<std::string> &src) { Assign(src.begin(), src.end()); }
+
+    OwnedStrings(std::initializer_list<std::string_view> src) { Assign(src.begin(), src.end()); }
+
+    // 元素可以是std::string、std::string_view、const char*等能转成std::string_view的类型
+    template <typename Iter>
+    OwnedStrings(Iter begin, Iter end) {
+        Assign(begin, end);
     }
 
-    char **data() { return char_ptr_vec.data(); }
+    OwnedStrings(OwnedStrings &&other) noexcept { Swap(other); }
 
-    ~OwnedStrings() {
-        for (char *elem : char_ptr_vec) {
-            if (elem != nullptr) {
-                delete[] elem;
-            }
+    OwnedStrings &operator=(OwnedStrings &&other) noexcept {
+        Swap(other);
+        return *this;
+    }
+
+    ~OwnedStrings() { ::operator delete(buffer_); }
+
+    template <typename Iter>
+    void Assign(Iter begin, Iter end) {
+        std::size_t num = 0;
+        std::size_t bytes = 0;
+        for (Iter it = begin; it != end; ++it) {
+            bytes += std::string_view(*it).size() + 1;
+            ++num;
+        }
+        std::size_t need = (num + 1) * sizeof(char *) + bytes;
+        if (need > capacity_) {
+            ::operator delete(buffer_);
+            buffer_ = nullptr;
+            capacity_ = 0;
+            buffer_ = ::operator new(need);
+            capacity_ = need;
         }
+        char **ptrs = static_cast<char **>(buffer_);
+        char *chars = reinterpret_cast<char *>(ptrs + num + 1);
+        std::size_t i = 0;
+        for (Iter it = begin; it != end; ++it) {
+            std::string_view str(*it);
+            std::memcpy(chars, str.data(), str.size());
+            chars[str.size()] = '\0';
+            ptrs[i++] = chars;
+            chars += str.size() + 1;
+        }
+        ptrs[num] = nullptr;
+        size_ = num;
+    }
+
+    void Assign(const std::vector<std::string> &src) { Assign(src.begin(), src.end()); }
+
+    char **data() { return buffer_ == nullptr ? &empty_ : static_cast<char **>(buffer_); }
+
+    // 字符串个数，不含结尾的nullptr
+    std::size_t size() const { return size_; }
+
+    void Swap(OwnedStrings &other) noexcept {
+        std::swap(buffer_, other.buffer_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
     }
 
    private:
-    std::vector<char *> char_ptr_vec;
+    void *buffer_ = nullptr;
+    std::size_t capacity_ = 0;
+    std::size_t size_ = 0;
+    char *empty_ = nullptr;
 };
 
 }  // namespace wzq
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,225 @@
+#ifndef __PROCESS_POOL__
+#define __PROCESS_POOL__
+
+#include "common/cmd.h"
+#include "common/noncopyable.h"
+
+#include <poll.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace wzq {
+
+/**
+ * 常驻子进程池：预先启动worker_num个helper进程，之后每次调用只是通过管道收发一条消息，
+ * 没有fork/exec的开销。
+ *
+ * 协议：请求写到helper的stdin，以delimiter结尾；helper对每个请求在stdout输出一条以delimiter结尾的响应。
+ * helper的stderr直接继承当前进程的stderr。
+ */
+class ProcessPool : wzq::NonCopyAble {
+   public:
+    ProcessPool(std::vector<std::string> argv, int worker_num, char delimiter = '\n')
+        : argv_(std::move(argv)), worker_num_(worker_num), delimiter_(delimiter) {}
+
+    ~ProcessPool() { Stop(); }
+
+    // 启动所有helper进程，有一个启动失败就返回false
+    bool Start() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (running_) {
+            return true;
+        }
+        for (int i = 0; i < worker_num_; ++i) {
+            std::unique_ptr<Worker> worker = NewWorker();
+            if (worker == nullptr) {
+                idle_.clear();
+                return false;
+            }
+            idle_.push_back(std::move(worker));
+        }
+        alive_num_ = worker_num_;
+        running_ = true;
+        return true;
+    }
+
+    /**
+     * 关闭所有空闲helper的stdin，等它们自己退出并回收，超过grace还没退出的杀掉整个进程组。
+     * 正在执行的Call结束后用同样的方式回收它的helper
+     */
+    void Stop(std::chrono::milliseconds grace = std::chrono::milliseconds(1000)) {
+        std::vector<std::unique_ptr<Worker>> workers;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            running_ = false;
+            grace_ = grace;
+            workers.swap(idle_);
+            cv_.notify_all();
+        }
+        Shutdown(workers, grace);
+    }
+
+    /**
+     * 发送一个请求并等待一条响应(不含delimiter)，所有helper都忙时阻塞等待。
+     * 超时或helper异常退出时返回false，这个helper会被杀掉并重新启动一个
+     */
+    bool Call(const std::string &request, std::string &response,
+              std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) {
+        std::unique_ptr<Worker> worker = Acquire();
+        if (worker == nullptr) {
+            return false;
+        }
+        bool ok = Exchange(*worker, request, response, timeout);
+        if (!ok) {
+            worker = NewWorker();
+        }
+        Release(std::move(worker));
+        return ok;
+    }
+
+    // 当前活着的helper进程个数
+    int Size() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return alive_num_;
+    }
+
+   private:
+    struct Worker {
+        Subprocess proc;
+        std::string request;
+        std::string buffer;  // 已经读到但还没返回的数据
+    };
+
+    std::unique_ptr<Worker> NewWorker() {
+        auto worker = std::make_unique<Worker>();
+        SpawnOptions options;
+        options.search_path = true;
+        options.pipe_stdin = true;
+        options.stderr_mode = SpawnOptions::Stderr::kInherit;
+        if (worker->proc.Spawn(argv_, options) != 0) {
+            return nullptr;
+        }
+        return worker;
+    }
+
+    std::unique_ptr<Worker> Acquire() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return !running_ || !idle_.empty() || alive_num_ == 0; });
+        if (!running_ || idle_.empty()) {
+            return nullptr;
+        }
+        std::unique_ptr<Worker> worker = std::move(idle_.back());
+        idle_.pop_back();
+        return worker;
+    }
+
+    void Release(std::unique_ptr<Worker> worker) {
+        std::vector<std::unique_ptr<Worker>> stopped;
+        std::chrono::milliseconds grace;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (worker == nullptr) {
+                --alive_num_;
+            } else if (running_) {
+                idle_.push_back(std::move(worker));
+            } else {
+                stopped.push_back(std::move(worker));
+            }
+            grace = grace_;
+            cv_.notify_one();
+        }
+        Shutdown(stopped, grace);
+    }
+
+    // 先关闭所有stdin让helper同时退出，再逐个回收；到期还没退出的由Subprocess析构杀掉
+    static void Shutdown(std::vector<std::unique_ptr<Worker>> &workers, std::chrono::milliseconds grace) {
+        for (auto &worker : workers) {
+            worker->proc.CloseIn();
+        }
+        const auto deadline = std::chrono::steady_clock::now() + grace;
+        for (auto &worker : workers) {
+            CommandResult result;
+            while (!worker->proc.Reap(result, false)) {
+                auto remain = deadline - std::chrono::steady_clock::now();
+                if (remain <= std::chrono::steady_clock::duration::zero()) {
+                    break;
+                }
+                if (worker->proc.pid_fd() >= 0) {
+                    pollfd pfd = {worker->proc.pid_fd(), POLLIN, 0};
+                    poll(&pfd, 1, static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remain).count()));
+                } else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        }
+        workers.clear();
+    }
+
+    bool Exchange(Worker &worker, const std::string &request, std::string &response,
+                  std::chrono::milliseconds timeout) {
+        const bool has_deadline = timeout.count() > 0;
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        worker.request.assign(request);
+        worker.request.push_back(delimiter_);
+        // helper不读stdin时写也受超时限制
+        if (!worker.proc.WriteIn(worker.request.data(), worker.request.size(), timeout)) {
+            return false;
+        }
+        std::size_t searched = 0;
+        char buf[16 * 1024];
+        for (;;) {
+            std::size_t pos = worker.buffer.find(delimiter_, searched);
+            if (pos != std::string::npos) {
+                response.assign(worker.buffer, 0, pos);
+                worker.buffer.erase(0, pos + 1);
+                return true;
+            }
+            searched = worker.buffer.size();
+            int wait_ms = -1;
+            if (has_deadline) {
+                auto remain = deadline - std::chrono::steady_clock::now();
+                if (remain <= std::chrono::steady_clock::duration::zero()) {
+                    return false;
+                }
+                wait_ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remain).count());
+            }
+            pollfd pfd = {worker.proc.out_fd(), POLLIN, 0};
+            int ret = poll(&pfd, 1, wait_ms);
+            if (ret < 0 && errno != EINTR) {
+                return false;
+            }
+            if (ret <= 0) {
+                continue;
+            }
+            ssize_t n = read(worker.proc.out_fd(), buf, sizeof(buf));
+            if (n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN)) {
+                return false;
+            }
+            if (n > 0) {
+                worker.buffer.append(buf, static_cast<std::size_t>(n));
+            }
+        }
+    }
+
+   private:
+    std::vector<std::string> argv_;
+    int worker_num_;
+    char delimiter_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<std::unique_ptr<Worker>> idle_;
+    int alive_num_ = 0;
+    bool running_ = false;
+    std::chrono::milliseconds grace_{1000};
+};
+
+}  // namespace wzq
+
+#endif
@@ -0,0 +1,497 @@
+#ifndef __SKIP_LIST_MAP__
+#define __SKIP_LIST_MAP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "common/metrics.h"
+#include "common/noncopyable.h"
+
+namespace wzq {
+
+/**
+ * 并发有序map，无锁跳表：查找、插入、删除都只用CAS，不加锁。
+ * 遍历是弱一致的：不阻塞写线程，遍历期间插入或删除的key可能看得到也可能看不到，
+ * 但每个key最多出现一次，且按顺序出现。
+ *
+ * 插入后value不可修改(多个线程同时读，修改需要额外同步)，要修改就删掉再插入。
+ *
+ * 删除的节点按epoch回收：每个操作开始时在当前epoch登记，结束时注销；摘下的节点挂在当时epoch的链表上，
+ * 等epoch前进两次、之前登记的操作都已经结束时释放，读线程不会访问到已经释放的节点。
+ * 迭代器也持有登记，长期不释放的迭代器会让删除的节点一直回收不了
+ */
+template <typename K, typename V, typename Compare = std::less<K>>
+class SkipListMap : NonCopyAble {
+    struct Node;
+
+    /**
+     * 在某个epoch上的登记，析构时注销。拷贝时登记在同一个epoch上：
+     * 拷贝出来的迭代器指向的节点可能在更晚的epoch之前就被摘掉了
+     */
+    class Guard {
+       public:
+        Guard() = default;
+        explicit Guard(const SkipListMap *map) : slot_(map->Enter()) {}
+        Guard(const Guard &other) : slot_(other.slot_) {
+            if (slot_ != nullptr) {
+                slot_->fetch_add(1);
+            }
+        }
+        Guard(Guard &&other) noexcept : slot_(other.slot_) { other.slot_ = nullptr; }
+        Guard &operator=(Guard other) noexcept {
+            std::swap(slot_, other.slot_);
+            return *this;
+        }
+        ~Guard() {
+            if (slot_ != nullptr) {
+                slot_->fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+       private:
+        std::atomic<int64_t> *slot_ = nullptr;
+    };
+
+   public:
+    static constexpr int kMaxLevel = 16;
+
+    // 只读的前向迭代器，跳过已经删除的节点
+    class Iterator {
+       public:
+        Iterator() = default;
+
+        const K &Key() const { return node_->key; }
+        const V &Value() const { return node_->value; }
+
+        Iterator &operator++() {
+            node_ = SkipListMap::NextAlive(node_);
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const { return node_ == other.node_; }
+        bool operator!=(const Iterator &other) const { return node_ != other.node_; }
+
+       private:
+        friend class SkipListMap;
+        Iterator(Node *node, Guard guard) : node_(node), guard_(std::move(guard)) {}
+
+        Node *node_ = nullptr;
+        Guard guard_;
+    };
+
+    SkipListMap() {
+        for (auto &next : head_) {
+            next.store(0, std::memory_order_relaxed);
+        }
+        for (auto &retired : retired_) {
+            retired.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SkipListMap() {
+        Node *node = Ptr(head_[0].load(std::memory_order_relaxed));
+        while (node != nullptr) {
+            uintptr_t next = node->Next(0).load(std::memory_order_relaxed);
+            // 已经删除的节点在retired_里，由下面统一释放
+            if (!IsMarked(next)) {
+                Destroy(node);
+            }
+            node = Ptr(next);
+        }
+        for (auto &retired : retired_) {
+            DestroyList(retired.load(std::memory_order_relaxed));
+        }
+    }
+
+    // key已经存在时返回false，不修改原来的值
+    bool Insert(const K &key, V value) {
+        bool retired = false;
+        bool inserted = InsertImpl(key, std::move(value), retired);
+        if (retired) {
+            Reclaim();
+        }
+        return inserted;
+    }
+
+    bool Erase(const K &key) {
+        bool retired = false;
+        bool erased = EraseImpl(key, retired);
+        if (retired) {
+            Reclaim();
+        }
+        return erased;
+    }
+
+    bool Find(const K &key, V &value) const {
+        Guard guard(this);
+        Node *node = LowerNode(key);
+        if (node == nullptr || compare_(key, node->key)) {
+            return false;
+        }
+        value = node->value;
+        return true;
+    }
+
+    bool Contains(const K &key) const {
+        Guard guard(this);
+        Node *node = LowerNode(key);
+        return node != nullptr && !compare_(key, node->key);
+    }
+
+    Iterator Begin() const {
+        Guard guard(this);
+        Node *node = NextAlive(head_);
+        return Iterator(node, std::move(guard));
+    }
+
+    Iterator End() const { return Iterator(); }
+
+    // 第一个不小于key的位置
+    Iterator LowerBound(const K &key) const {
+        Guard guard(this);
+        Node *node = LowerNode(key);
+        return Iterator(node, std::move(guard));
+    }
+
+    // 第一个大于key的位置
+    Iterator UpperBound(const K &key) const {
+        Guard guard(this);
+        Node *node = LowerNode(key);
+        if (node != nullptr && !compare_(key, node->key)) {
+            node = NextAlive(node);
+        }
+        return Iterator(node, std::move(guard));
+    }
+
+    // 按顺序遍历[from, to)，func返回false时提前结束，返回遍历的个数
+    template <typename F>
+    std::size_t ForEachInRange(const K &from, const K &to, F &&func) const {
+        std::size_t count = 0;
+        for (Iterator iter = LowerBound(from); iter != End() && compare_(iter.Key(), to); ++iter) {
+            ++count;
+            if (!func(iter.Key(), iter.Value())) {
+                break;
+            }
+        }
+        return count;
+    }
+
+    // 并发修改时只是近似值
+    std::size_t Size() const { return size_.load(std::memory_order_relaxed); }
+
+    bool Empty() const { return Begin() == End(); }
+
+    // 发布prefix.size
+    void PublishMetrics(const std::string &prefix, MetricsRegistry &registry = MetricsRegistry::Global()) {
+        MetricsRegistry::Registration metrics;
+        metrics.Add(registry, prefix + ".size", [this]() { return static_cast<int64_t>(Size()); });
+        metrics_ = std::move(metrics);
+    }
+
+   private:
+    static constexpr uintptr_t kMark = 1;
+    static constexpr std::size_t kPinStripes = 16;
+
+    // next指针数组跟在节点后面，按节点的层数分配
+    struct Node {
+        const K key;
+        const V value;
+        const int top;
+        // 插入线程和删除线程各持有一个引用，都放手后才回收：插入线程可能还在往上层链接
+        std::atomic<int> refs{2};
+        Node *retired_next = nullptr;
+
+        Node(const K &k, V &&v, int t) : key(k), value(std::move(v)), top(t) {}
+
+        std::atomic<uintptr_t> &Next(int level) { return reinterpret_cast<std::atomic<uintptr_t> *>(this + 1)[level]; }
+    };
+
+    struct alignas(64) PinSlot {
+        std::atomic<int64_t> count{0};
+    };
+
+    bool InsertImpl(const K &key, V &&value, bool &retired) {
+        Guard guard(this);
+        std::atomic<uintptr_t> *preds[kMaxLevel];
+        Node *succs[kMaxLevel];
+        const int top = RandomLevel();
+        Node *node = nullptr;
+        for (;;) {
+            if (Find(key, preds, succs)) {
+                if (node != nullptr) {
+                    Destroy(node);
+                }
+                return false;
+            }
+            if (node == nullptr) {
+                node = Create(key, std::move(value), top);
+            }
+            for (int level = 0; level < top; ++level) {
+                node->Next(level).store(reinterpret_cast<uintptr_t>(succs[level]), std::memory_order_relaxed);
+            }
+            // 最底层链接成功就算插入成功，此时节点还没被别人看到时失败可以直接重试
+            uintptr_t expected = reinterpret_cast<uintptr_t>(succs[0]);
+            if (preds[0]->compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node))) {
+                break;
+            }
+        }
+        size_.fetch_add(1, std::memory_order_relaxed);
+        RaiseHeight(top);
+        LinkUpper(node, key, top, preds, succs);
+        /**
+         * 上层链接可能和Erase同时进行，Erase摘完之后这里又把节点链了上去。
+         * 已经被删除时再摘一次；还没删除时，之后的Erase一定能看到这里的链接，由它来摘
+         */
+        if (IsMarked(node->Next(0).load())) {
+            Find(key, preds, succs);
+        }
+        retired = Release(node);
+        return true;
+    }
+
+    void LinkUpper(Node *node, const K &key, int top, std::atomic<uintptr_t> **preds, Node **succs) {
+        for (int level = 1; level < top; ++level) {
+            for (;;) {
+                uintptr_t next = node->Next(level).load(std::memory_order_acquire);
+                if (IsMarked(next)) {
+                    // 已经被删除，上层不用再链接
+                    return;
+                }
+                if (Ptr(next) != succs[level] &&
+                    !node->Next(level).compare_exchange_strong(next, reinterpret_cast<uintptr_t>(succs[level]))) {
+                    return;
+                }
+                uintptr_t expected = reinterpret_cast<uintptr_t>(succs[level]);
+                if (preds[level]->compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node))) {
+                    break;
+                }
+                Find(key, preds, succs);
+                if (succs[0] != node) {
+                    return;
+                }
+            }
+        }
+    }
+
+    bool EraseImpl(const K &key, bool &retired) {
+        Guard guard(this);
+        std::atomic<uintptr_t> *preds[kMaxLevel];
+        Node *succs[kMaxLevel];
+        if (!Find(key, preds, succs)) {
+            return false;
+        }
+        Node *victim = succs[0];
+        // 先从上往下标记，最底层标记成功的线程才算删除了这个key
+        for (int level = victim->top - 1; level >= 1; --level) {
+            uintptr_t next = victim->Next(level).load(std::memory_order_acquire);
+            while (!IsMarked(next)) {
+                victim->Next(level).compare_exchange_weak(next, next | kMark);
+            }
+        }
+        uintptr_t next = victim->Next(0).load(std::memory_order_acquire);
+        for (;;) {
+            if (IsMarked(next)) {
+                return false;
+            }
+            if (victim->Next(0).compare_exchange_weak(next, next | kMark)) {
+                break;
+            }
+        }
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        // 和InsertImpl最后检查删除标记配对：那边没看到标记时，这里的Find一定能看到它的上层链接
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // 顺路摘掉各层上的节点
+        Find(key, preds, succs);
+        retired = Release(victim);
+        return true;
+    }
+
+    // 放掉一个引用，最后一个放手的把节点挂到当前epoch的待回收链表上，返回是否挂上了；调用方要持有Guard
+    bool Release(Node *node) {
+        if (node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return false;
+        }
+        std::atomic<Node *> &retired = retired_[epoch_.load() % 3];
+        Node *head = retired.load(std::memory_order_relaxed);
+        do {
+            node->retired_next = head;
+        } while (!retired.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+        return true;
+    }
+
+    // 在当前epoch登记，登记之后epoch没变才算数，否则回收线程可能已经检查过这个epoch的登记数
+    std::atomic<int64_t> *Enter() const {
+        PinSlot *slots = nullptr;
+        const std::size_t stripe = internal::ThreadStripe() % kPinStripes;
+        for (;;) {
+            uint64_t epoch = epoch_.load();
+            slots = pins_[epoch % 3];
+            slots[stripe].count.fetch_add(1);
+            if (epoch_.load() == epoch) {
+                return &slots[stripe].count;
+            }
+            slots[stripe].count.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    /**
+     * 上一个epoch没有登记的操作时把epoch加1，并释放上上个epoch摘下的节点：
+     * 能访问到它们的操作都登记在那个epoch或更早，已经全部结束。不能在持有Guard时调用
+     */
+    void Reclaim() {
+        uint64_t epoch = epoch_.load();
+        for (const PinSlot &slot : pins_[(epoch - 1) % 3]) {
+            if (slot.count.load() != 0) {
+                return;
+            }
+        }
+        if (!epoch_.compare_exchange_strong(epoch, epoch + 1)) {
+            return;
+        }
+        DestroyList(retired_[(epoch - 1) % 3].exchange(nullptr, std::memory_order_acquire));
+    }
+
+    static void DestroyList(Node *node) {
+        while (node != nullptr) {
+            Node *next = node->retired_next;
+            Destroy(node);
+            node = next;
+        }
+    }
+
+    static Node *Create(const K &key, V &&value, int top) {
+        void *mem = ::operator new(sizeof(Node) + sizeof(std::atomic<uintptr_t>) * top);
+        Node *node = nullptr;
+        try {
+            node = ::new (mem) Node(key, std::move(value), top);
+        } catch (...) {
+            ::operator delete(mem);
+            throw;
+        }
+        for (int level = 0; level < top; ++level) {
+            ::new (&node->Next(level)) std::atomic<uintptr_t>(0);
+        }
+        return node;
+    }
+
+    static void Destroy(Node *node) {
+        node->~Node();
+        ::operator delete(node);
+    }
+
+    static Node *Ptr(uintptr_t next) { return reinterpret_cast<Node *>(next & ~kMark); }
+    static bool IsMarked(uintptr_t next) { return (next & kMark) != 0; }
+
+    // node之后第一个没有删除的节点
+    static Node *NextAlive(Node *node) { return node == nullptr ? nullptr : NextAlive(&node->Next(0)); }
+
+    static Node *NextAlive(const std::atomic<uintptr_t> *next_slot) {
+        Node *node = Ptr(next_slot[0].load(std::memory_order_acquire));
+        while (node != nullptr) {
+            uintptr_t next = node->Next(0).load(std::memory_order_acquire);
+            if (!IsMarked(next)) {
+                return node;
+            }
+            node = Ptr(next);
+        }
+        return nullptr;
+    }
+
+    static int RandomLevel() {
+        static thread_local uint32_t seed = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&seed) >> 4) | 1;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        // 每层的概率是1/4
+        int level = 1;
+        uint32_t bits = seed;
+        while (level < kMaxLevel && (bits & 3) == 0) {
+            ++level;
+            bits >>= 2;
+        }
+        return level;
+    }
+
+    void RaiseHeight(int top) {
+        int height = height_.load(std::memory_order_relaxed);
+        while (height < top && !height_.compare_exchange_weak(height, top, std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * 找到每层上key的前驱(的next槽)和后继，路过已经标记删除的节点时顺手摘掉。
+     * 返回最底层的后继是否就是key
+     */
+    bool Find(const K &key, std::atomic<uintptr_t> **preds, Node **succs) {
+    retry:
+        std::atomic<uintptr_t> *pred = head_;
+        for (int level = kMaxLevel - 1; level >= 0; --level) {
+            Node *curr = Ptr(pred[level].load(std::memory_order_acquire));
+            while (curr != nullptr) {
+                uintptr_t next = curr->Next(level).load(std::memory_order_acquire);
+                while (IsMarked(next)) {
+                    uintptr_t expected = reinterpret_cast<uintptr_t>(curr);
+                    if (!pred[level].compare_exchange_strong(expected, next & ~kMark)) {
+                        goto retry;
+                    }
+                    curr = Ptr(next);
+                    if (curr == nullptr) {
+                        break;
+                    }
+                    next = curr->Next(level).load(std::memory_order_acquire);
+                }
+                if (curr == nullptr || !compare_(curr->key, key)) {
+                    break;
+                }
+                pred = &curr->Next(0);
+                curr = Ptr(next);
+            }
+            preds[level] = &pred[level];
+            succs[level] = curr;
+        }
+        return succs[0] != nullptr && !compare_(key, succs[0]->key);
+    }
+
+    // 只读查找第一个不小于key且没有删除的节点，不修改链表
+    Node *LowerNode(const K &key) const {
+        const std::atomic<uintptr_t> *pred = head_;
+        Node *curr = nullptr;
+        for (int level = height_.load(std::memory_order_relaxed) - 1; level >= 0; --level) {
+            curr = Ptr(pred[level].load(std::memory_order_acquire));
+            while (curr != nullptr && compare_(curr->key, key)) {
+                pred = &curr->Next(0);
+                curr = Ptr(pred[level].load(std::memory_order_acquire));
+            }
+        }
+        while (curr != nullptr) {
+            uintptr_t next = curr->Next(0).load(std::memory_order_acquire);
+            if (!IsMarked(next)) {
+                return curr;
+            }
+            curr = Ptr(next);
+        }
+        return nullptr;
+    }
+
+   private:
+    std::atomic<uintptr_t> head_[kMaxLevel];
+    std::atomic<int> height_{1};
+    std::atomic<std::size_t> size_{0};
+    Compare compare_;
+
+    // 从1开始，epoch - 1不会下溢；登记数和待回收链表按epoch % 3轮换
+    std::atomic<uint64_t> epoch_{1};
+    mutable PinSlot pins_[3][kPinStripes];
+    std::atomic<Node *> retired_[3];
+
+    MetricsRegistry::Registration metrics_;
+};
+
+}  // namespace wzq
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef __UNIT__
+#define __UNIT__
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace wzq {
+
+/**
+ * 量纲：米、千克、秒的幂次，例如速度是Unit<1, 0, -1>。
+ * 不同量纲的值不能相加，相乘/相除时量纲在编译期自动相加/相减
+ */
+template <int M, int K, int S>
+struct Unit {
+    enum { metre = M, kilogram = K, second = S };
+};
+
+template <typename U1, typename U2>
+using UnitMultiply = Unit<U1::metre + U2::metre, U1::kilogram + U2::kilogram, U1::second + U2::second>;
+
+template <typename U1, typename U2>
+using UnitDivide = Unit<U1::metre - U2::metre, U1::kilogram - U2::kilogram, U1::second - U2::second>;
+
+namespace units {
+using Scalar = Unit<0, 0, 0>;
+using Metre = Unit<1, 0, 0>;
+using Kilogram = Unit<0, 1, 0>;
+using Second = Unit<0, 0, 1>;
+using SquareMetre = Unit<2, 0, 0>;
+using MetrePerSecond = Unit<1, 0, -1>;
+using MetrePerSecond2 = Unit<1, 0, -2>;
+using Newton = Unit<1, 1, -2>;
+}  // namespace units
+
+/**
+ * 带量纲的值，Rep是底层的表示类型(float/double)，内存布局和Rep完全相同，
+ * 所有运算都是constexpr且可以内联，运行时没有额外开销
+ */
+template <typename U, typename Rep = double>
+class Value {
+    static_assert(std::is_arithmetic_v<Rep>, "Value: Rep must be an arithmetic type");
+
+   private:
+    Rep magnitude_{0};
+
+   public:
+    using unit = U;
+    using rep = Rep;
+
+    constexpr Value() = default;
+    constexpr explicit Value(const Rep magnitude) : magnitude_(magnitude) {}
+
+    constexpr Rep GetMagnitude() const noexcept { return magnitude_; }
+
+    constexpr Value& operator+=(const Value& r) noexcept {
+        magnitude_ += r.magnitude_;
+        return *this;
+    }
+    constexpr Value& operator-=(const Value& r) noexcept {
+        magnitude_ -= r.magnitude_;
+        return *this;
+    }
+    constexpr Value& operator*=(const Rep r) noexcept {
+        magnitude_ *= r;
+        return *this;
+    }
+    constexpr Value& operator/=(const Rep r) noexcept {
+        magnitude_ /= r;
+        return *this;
+    }
+    constexpr Value operator-() const noexcept { return Value(-magnitude_); }
+};
+
+using Length = Value<units::Metre>;
+using Mass = Value<units::Kilogram>;
+using Time = Value<units::Second>;
+using Area = Value<units::SquareMetre>;
+using Speed = Value<units::MetrePerSecond>;
+using Acceleration = Value<units::MetrePerSecond2>;
+using Force = Value<units::Newton>;
+
+template <typename U, typename Rep>
+constexpr Value<U, Rep> operator+(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return Value<U, Rep>(l.GetMagnitude() + r.GetMagnitude());
+}
+
+template <typename U, typename Rep>
+constexpr Value<U, Rep> operator-(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return Value<U, Rep>(l.GetMagnitude() - r.GetMagnitude());
+}
+
+// distance = speed * time，量纲在编译期相加
+template <typename U1, typename U2, typename Rep>
+constexpr Value<UnitMultiply<U1, U2>, Rep> operator*(const Value<U1, Rep>& l, const Value<U2, Rep>& r) noexcept {
+    return Value<UnitMultiply<U1, U2>, Rep>(l.GetMagnitude() * r.GetMagnitude());
+}
+
+template <typename U1, typename U2, typename Rep>
+constexpr Value<UnitDivide<U1, U2>, Rep> operator/(const Value<U1, Rep>& l, const Value<U2, Rep>& r) noexcept {
+    return Value<UnitDivide<U1, U2>, Rep>(l.GetMagnitude() / r.GetMagnitude());
+}
+
+template <typename U, typename Rep>
+constexpr Value<U, Rep> operator*(const Value<U, Rep>& l, const typename Value<U, Rep>::rep r) noexcept {
+    return Value<U, Rep>(l.GetMagnitude() * r);
+}
+
+template <typename U, typename Rep>
+constexpr Value<U, Rep> operator*(const typename Value<U, Rep>::rep l, const Value<U, Rep>& r) noexcept {
+    return Value<U, Rep>(l * r.GetMagnitude());
+}
+
+template <typename U, typename Rep>
+constexpr Value<U, Rep> operator/(const Value<U, Rep>& l, const typename Value<U, Rep>::rep r) noexcept {
+    return Value<U, Rep>(l.GetMagnitude() / r);
+}
+
+template <typename U, typename Rep>
+constexpr bool operator==(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return l.GetMagnitude() == r.GetMagnitude();
+}
+template <typename U, typename Rep>
+constexpr bool operator!=(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return l.GetMagnitude() != r.GetMagnitude();
+}
+template <typename U, typename Rep>
+constexpr bool operator<(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return l.GetMagnitude() < r.GetMagnitude();
+}
+template <typename U, typename Rep>
+constexpr bool operator<=(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return l.GetMagnitude() <= r.GetMagnitude();
+}
+template <typename U, typename Rep>
+constexpr bool operator>(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return l.GetMagnitude() > r.GetMagnitude();
+}
+template <typename U, typename Rep>
+constexpr bool operator>=(const Value<U, Rep>& l, const Value<U, Rep>& r) noexcept {
+    return l.GetMagnitude() >= r.GetMagnitude();
+}
+
+static_assert(sizeof(Value<units::Metre, double>) == sizeof(double), "Value must have the layout of its Rep");
+static_assert(std::is_trivially_copyable_v<Value<units::Metre, float>>, "Value must be trivially copyable");
+
+// 为了更加直观的看也可以为文字添加自定义后缀，所谓的文字操作符
+namespace literals {
+constexpr Length operator"" _m(long double magnitude) { return Length(static_cast<double>(magnitude)); }
+constexpr Mass operator"" _kg(long double magnitude) { return Mass(static_cast<double>(magnitude)); }
+constexpr Time operator"" _s(long double magnitude) { return Time(static_cast<double>(magnitude)); }
+constexpr Speed operator"" _mps(long double magnitude) { return Speed(static_cast<double>(magnitude)); }
+}  // namespace literals
+
+/**
+ * 批量运算的内核，全部是对裸指针的简单循环，编译器可以向量化成SSE/AVX2指令
+ * (需要-O3或-O2 -ftree-vectorize，AVX2需要-mavx2或-march=native)
+ */
+namespace unit_kernels {
+
+template <typename Rep>
+void Add(Rep* __restrict dst, const Rep* __restrict a, const Rep* __restrict b, std::size_t n) {
+#pragma GCC ivdep
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = a[i] + b[i];
+    }
+}
+
+template <typename Rep>
+void AddInPlace(Rep* __restrict dst, const Rep* __restrict a, std::size_t n) {
+#pragma GCC ivdep
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] += a[i];
+    }
+}
+
+template <typename Rep>
+void Sub(Rep* __restrict dst, const Rep* __restrict a, const Rep* __restrict b, std::size_t n) {
+#pragma GCC ivdep
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = a[i] - b[i];
+    }
+}
+
+template <typename Rep>
+void Mul(Rep* __restrict dst, const Rep* __restrict a, const Rep* __restrict b, std::size_t n) {
+#pragma GCC ivdep
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = a[i] * b[i];
+    }
+}
+
+template <typename Rep>
+void Div(Rep* __restrict dst, const Rep* __restrict a, const Rep* __restrict b, std::size_t n) {
+#pragma GCC ivdep
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] = a[i] / b[i];
+    }
+}
+
+template <typename Rep>
+void Scale(Rep* __restrict dst, Rep factor, std::size_t n) {
+#pragma GCC ivdep
+    for (std::size_t i = 0; i < n; ++i) {
+        dst[i] *= factor;
+    }
+}
+
+// 用8个独立的累加器，不需要-ffast-math也能向量化，结果和逐个相加可能有舍入误差
+constexpr std::size_t kLanes = 8;
+
+template <typename Rep>
+Rep Sum(const Rep* __restrict a, std::size_t n) {
+    Rep acc[kLanes] = {};
+    std::size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        for (std::size_t j = 0; j < kLanes; ++j) {
+            acc[j] += a[i + j];
+        }
+    }
+    Rep sum = 0;
+    for (; i < n; ++i) {
+        sum += a[i];
+    }
+    for (std::size_t j = 0; j < kLanes; ++j) {
+        sum += acc[j];
+    }
+    return sum;
+}
+
+template <typename Rep>
+Rep Dot(const Rep* __restrict a, const Rep* __restrict b, std::size_t n) {
+    Rep acc[kLanes] = {};
+    std::size_t i = 0;
+    for (; i + kLanes <= n; i += kLanes) {
+        for (std::size_t j = 0; j < kLanes; ++j) {
+            acc[j] += a[i + j] * b[i + j];
+        }
+    }
+    Rep sum = 0;
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    for (std::size_t j = 0; j < kLanes; ++j) {
+        sum += acc[j];
+    }
+    return sum;
+}
+
+template <typename Rep>
+Rep Max(const Rep* __restrict a, std::size_t n) {
+    Rep ret = n > 0 ? a[0] : Rep(0);
+    for (std::size_t i = 1; i < n; ++i) {
+        ret = a[i] > ret ? a[i] : ret;
+    }
+    return ret;
+}
+
+template <typename Rep>
+Rep Min(const Rep* __restrict a, std::size_t n) {
+    Rep ret = n > 0 ? a[0] : Rep(0);
+    for (std::size_t i = 1; i < n; ++i) {
+        ret = a[i] < ret ? a[i] : ret;
+    }
+    return ret;
+}
+
+}  // namespace unit_kernels
+
+// 按64字节对齐分配，向量化的循环不需要处理未对齐的开头
+template <typename T>
+struct CacheAlignedAllocator {
+    using value_type = T;
+    static constexpr std::size_t kAlign = 64;
+
+    CacheAlignedAllocator() noexcept = default;
+    template <typename U>
+    CacheAlignedAllocator(const CacheAlignedAllocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(kAlign))); }
+    void deallocate(T* p, std::size_t) noexcept { ::operator delete(p, std::align_val_t(kAlign)); }
+
+    template <typename U>
+    bool operator==(const CacheAlignedAllocator<U>&) const noexcept {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const CacheAlignedAllocator<U>&) const noexcept {
+        return false;
+    }
+};
+
+/**
+ * 同一量纲的一组测量值，底层是连续的Rep数组(而不是Value对象的数组)，
+ * 所有批量运算都落到unit_kernels里的裸指针循环上，量纲检查全在编译期完成。
+ * 两个数组做逐元素运算时长度必须相同，debug构建下用assert检查
+ */
+template <typename U, typename Rep = double>
+class ValueArray {
+   public:
+    using value_type = Value<U, Rep>;
+    using unit = U;
+    using rep = Rep;
+
+    ValueArray() = default;
+    explicit ValueArray(std::size_t n, value_type init = value_type()) : data_(n, init.GetMagnitude()) {}
+
+    std::size_t size() const { return data_.size(); }
+    bool empty() const { return data_.empty(); }
+    void reserve(std::size_t n) { data_.reserve(n); }
+    void resize(std::size_t n) { data_.resize(n); }
+    void push_back(value_type v) { data_.push_back(v.GetMagnitude()); }
+
+    value_type operator[](std::size_t i) const { return value_type(data_[i]); }
+    void Set(std::size_t i, value_type v) { data_[i] = v.GetMagnitude(); }
+
+    // 裸数据，和外部的Rep数组交换数据时使用
+    Rep* data() { return data_.data(); }
+    const Rep* data() const { return data_.data(); }
+
+    ValueArray& operator+=(const ValueArray& r) {
+        assert(r.size() == size());
+        // a += a时两个参数是同一块内存，不能交给__restrict的内核
+        if (&r == this) {
+            unit_kernels::Scale(data(), Rep(2), size());
+            return *this;
+        }
+        unit_kernels::AddInPlace(data(), r.data(), size());
+        return *this;
+    }
+
+    ValueArray& operator*=(Rep factor) {
+        unit_kernels::Scale(data(), factor, size());
+        return *this;
+    }
+
+    friend ValueArray operator+(const ValueArray& l, const ValueArray& r) {
+        assert(r.size() == l.size());
+        ValueArray ret(l.size());
+        unit_kernels::Add(ret.data(), l.data(), r.data(), l.size());
+        return ret;
+    }
+
+    friend ValueArray operator-(const ValueArray& l, const ValueArray& r) {
+        assert(r.size() == l.size());
+        ValueArray ret(l.size());
+        unit_kernels::Sub(ret.data(), l.data(), r.data(), l.size());
+        return ret;
+    }
+
+    // 逐元素相乘，得到新量纲的数组
+    template <typename U2>
+    ValueArray<UnitMultiply<U, U2>, Rep> Multiply(const ValueArray<U2, Rep>& r) const {
+        assert(r.size() == size());
+        ValueArray<UnitMultiply<U, U2>, Rep> ret(size());
+        unit_kernels::Mul(ret.data(), data(), r.data(), size());
+        return ret;
+    }
+
+    template <typename U2>
+    ValueArray<UnitDivide<U, U2>, Rep> Divide(const ValueArray<U2, Rep>& r) const {
+        assert(r.size() == size());
+        ValueArray<UnitDivide<U, U2>, Rep> ret(size());
+        unit_kernels::Div(ret.data(), data(), r.data(), size());
+        return ret;
+    }
+
+    value_type Sum() const { return value_type(unit_kernels::Sum(data(), size())); }
+
+    value_type Mean() const { return empty() ? value_type() : value_type(Sum().GetMagnitude() / Rep(size())); }
+
+    value_type Max() const { return value_type(unit_kernels::Max(data(), size())); }
+
+    value_type Min() const { return value_type(unit_kernels::Min(data(), size())); }
+
+    template <typename U2>
+    Value<UnitMultiply<U, U2>, Rep> Dot(const ValueArray<U2, Rep>& r) const {
+        assert(r.size() == size());
+        return Value<UnitMultiply<U, U2>, Rep>(unit_kernels::Dot(data(), r.data(), size()));
+    }
+
+   private:
+    std::vector<Rep, CacheAlignedAllocator<Rep>> data_;
+};
+
+}  // namespace wzq
+
+#endif
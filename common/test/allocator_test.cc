@@ -0,0 +1,247 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/arena.h"
+#include "common/object_pool.h"
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::abort();                                                                 \
+        }                                                                                 \
+    } while (0)
+
+// 每个测试用自己的块大小，不同测试之间不共享池
+using AlignedPool = wzq::FixedSizePool<40, 64>;
+using SmallPool = wzq::FixedSizePool<24>;
+using CrossPool = wzq::FixedSizePool<72>;
+
+void TestFixedSizePool() {
+    CHECK(AlignedPool::kBlockSize % 64 == 0 && AlignedPool::kBlockSize >= 40);
+    std::vector<void *> blocks;
+    std::set<void *> unique;
+    for (int i = 0; i < 1000; ++i) {
+        void *ptr = AlignedPool::Allocate();
+        CHECK(reinterpret_cast<std::uintptr_t>(ptr) % 64 == 0);
+        std::memset(ptr, i & 0xff, 40);
+        blocks.push_back(ptr);
+        unique.insert(ptr);
+    }
+    CHECK(unique.size() == blocks.size());
+    for (int i = 0; i < 1000; ++i) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(blocks[i]);
+        CHECK(bytes[0] == (i & 0xff) && bytes[39] == (i & 0xff));
+    }
+    for (void *ptr : blocks) {
+        AlignedPool::Deallocate(ptr);
+    }
+    AlignedPool::Deallocate(nullptr);
+
+    // 本线程刚释放的块马上被重新用到
+    void *ptr = SmallPool::Allocate();
+    SmallPool::Deallocate(ptr);
+    CHECK(SmallPool::Allocate() == ptr);
+    SmallPool::Deallocate(ptr);
+}
+
+// A线程申请、B线程释放，B退出后块回到仓库，C线程能拿到
+void TestCrossThreadReuse() {
+    constexpr int kNum = static_cast<int>(CrossPool::kBatchSize) * 4;
+    std::vector<void *> blocks;
+    std::thread a([&blocks]() {
+        for (int i = 0; i < kNum; ++i) {
+            blocks.push_back(CrossPool::Allocate());
+        }
+    });
+    a.join();
+    std::thread b([&blocks]() {
+        for (void *ptr : blocks) {
+            CrossPool::Deallocate(ptr);
+        }
+    });
+    b.join();
+    std::set<void *> freed(blocks.begin(), blocks.end());
+    int reused = 0;
+    std::thread c([&freed, &reused]() {
+        std::vector<void *> again;
+        for (int i = 0; i < kNum; ++i) {
+            again.push_back(CrossPool::Allocate());
+            reused += freed.count(again.back()) != 0 ? 1 : 0;
+        }
+        for (void *ptr : again) {
+            CrossPool::Deallocate(ptr);
+        }
+    });
+    c.join();
+    std::printf("cross thread: %d of %d blocks reused\n", reused, kNum);
+    CHECK(reused == kNum);
+}
+
+struct Counted {
+    static int live;
+
+    std::string name;
+
+    explicit Counted(std::string n, bool fail = false) : name(std::move(n)) {
+        if (fail) {
+            throw std::runtime_error("construct failed");
+        }
+        ++live;
+    }
+    ~Counted() { --live; }
+};
+
+int Counted::live = 0;
+
+void TestObjectPool() {
+    using Pool = wzq::ObjectPool<Counted>;
+    Counted *obj = Pool::New("first");
+    CHECK(obj->name == "first" && Counted::live == 1);
+    Pool::Delete(obj);
+    CHECK(Counted::live == 0);
+    Pool::Delete(nullptr);
+
+    // 构造函数抛异常时块要还回池里
+    Counted *keep = Pool::New("keep");
+    void *next = Pool::Pool::Allocate();
+    Pool::Pool::Deallocate(next);
+    bool thrown = false;
+    try {
+        Pool::New("bad", true);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown && Counted::live == 1);
+    CHECK(Pool::Pool::Allocate() == next);
+    Pool::Pool::Deallocate(next);
+    Pool::Delete(keep);
+
+    {
+        Pool::UniquePtr ptr = Pool::MakeUnique("unique");
+        CHECK(ptr->name == "unique" && Counted::live == 1);
+    }
+    CHECK(Counted::live == 0);
+}
+
+void TestPoolAllocator() {
+    {
+        auto shared = std::allocate_shared<Counted>(wzq::PoolAllocator<Counted>(), "shared");
+        std::weak_ptr<Counted> weak = shared;
+        CHECK(shared->name == "shared" && Counted::live == 1);
+        shared.reset();
+        CHECK(weak.expired() && Counted::live == 0);
+    }
+    // n > 1走operator new
+    std::vector<int, wzq::PoolAllocator<int>> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back(i);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        CHECK(values[i] == i);
+    }
+    CHECK(wzq::PoolAllocator<int>() == wzq::PoolAllocator<long>());
+}
+
+// 统计向上游申请了多少次、还有多少字节没还
+class CountingResource : public std::pmr::memory_resource {
+   public:
+    int allocations = 0;
+    std::size_t outstanding = 0;
+
+   protected:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        ++allocations;
+        outstanding += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override {
+        outstanding -= bytes;
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+};
+
+struct Order {
+    static std::vector<int> destroyed;
+
+    int id;
+
+    explicit Order(int i) : id(i) {}
+    ~Order() { destroyed.push_back(id); }
+};
+
+std::vector<int> Order::destroyed;
+
+void TestArena() {
+    CountingResource upstream;
+    {
+        wzq::Arena arena(1024, &upstream);
+        CHECK(arena.BytesUsed() == 0);
+        void *a = arena.Allocate(10, 1);
+        void *b = arena.Allocate(8, 64);
+        CHECK(reinterpret_cast<std::uintptr_t>(b) % 64 == 0);
+        CHECK(static_cast<char *>(b) >= static_cast<char *>(a) + 10);
+        CHECK(arena.BytesUsed() >= 18);
+
+        // 超过块大小的分配单独申请一块
+        void *big = arena.Allocate(8192);
+        std::memset(big, 0, 8192);
+        CHECK(upstream.allocations == 2);
+
+        for (int i = 0; i < 3; ++i) {
+            arena.Create<Order>(i);
+        }
+        int *plain = arena.Create<int>(7);
+        CHECK(*plain == 7);
+
+        // Reset逆序析构，只保留最后一块，再分配不用向上游申请
+        arena.Reset();
+        CHECK((Order::destroyed == std::vector<int>{2, 1, 0}));
+        CHECK(arena.BytesUsed() == 0);
+        const std::size_t kept = upstream.outstanding;
+        CHECK(kept >= 8192);
+        const int before = upstream.allocations;
+        for (int i = 0; i < 100; ++i) {
+            arena.Allocate(64);
+        }
+        CHECK(upstream.allocations == before);
+
+        {
+            std::pmr::vector<std::pmr::string> strings(&arena);
+            for (int i = 0; i < 100; ++i) {
+                strings.emplace_back(std::size_t(40), static_cast<char>('a' + i % 26));
+            }
+            CHECK(strings[27] == std::pmr::string(40, 'b'));
+            CHECK(strings[27].get_allocator().resource() == &arena);
+        }
+
+        arena.Release();
+        CHECK(upstream.outstanding == 0 && arena.BytesUsed() == 0);
+        arena.Create<Order>(9);
+    }
+    // 析构时也要析构Create出来的对象并还掉内存
+    CHECK(Order::destroyed.back() == 9);
+    CHECK(upstream.outstanding == 0);
+}
+
+int main() {
+    TestFixedSizePool();
+    TestCrossThreadReuse();
+    TestObjectPool();
+    TestPoolAllocator();
+    TestArena();
+    std::printf("allocator_test passed\n");
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "common/concurrent_cache.h"
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::abort();                                                                 \
+        }                                                                                 \
+    } while (0)
+
+using Cache = wzq::ConcurrentCache<int, int>;
+
+// 容量64只有一个段，淘汰顺序是确定的
+void TestSlruEviction() {
+    Cache cache(64, Cache::Policy::kSlru);
+    CHECK(cache.Capacity() == 64);
+    for (int i = 0; i < 64; ++i) {
+        cache.Put(i, i * 10);
+    }
+    CHECK(cache.Size() == 64);
+    CHECK(cache.GetStats().evictions == 0);
+
+    // 0~9再命中一次升到保护区，之后放进来的新数据只淘汰试用区里最久没用的
+    int value = 0;
+    for (int i = 0; i < 10; ++i) {
+        CHECK(cache.Get(i, value) && value == i * 10);
+    }
+    for (int i = 100; i < 200; ++i) {
+        cache.Put(i, i);
+    }
+    Cache::Stats stats = cache.GetStats();
+    CHECK(cache.Size() == 64);
+    CHECK(stats.evictions == 100);
+    CHECK(stats.rejections == 0);
+    for (int i = 0; i < 10; ++i) {
+        CHECK(cache.Get(i, value) && value == i * 10);
+    }
+    for (int i = 10; i < 64; ++i) {
+        CHECK(!cache.Get(i, value));
+    }
+    // 试用区剩下的是最近放进来的54个
+    for (int i = 146; i < 200; ++i) {
+        CHECK(cache.Get(i, value) && value == i);
+    }
+    CHECK(!cache.Get(145, value));
+
+    stats = cache.GetStats();
+    CHECK(stats.hits == 10 + 10 + 54);
+    CHECK(stats.misses == 54 + 1);
+}
+
+// 扫描期间热点一直有人访问：只访问一遍的扫描数据大多被拒绝接纳，热点一次都不会未命中
+void TestTinyLfuAdmission() {
+    constexpr int kCapacity = 128;
+    constexpr int kHot = 50;
+    constexpr int kScan = 1000;
+    Cache cache(kCapacity, Cache::Policy::kTinyLfu, 1);
+    int value = 0;
+    for (int i = 0; i < kHot; ++i) {
+        cache.Put(i, i);
+    }
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < kHot; ++i) {
+            CHECK(cache.Get(i, value) && value == i);
+        }
+    }
+    for (int i = 0; i < kScan; ++i) {
+        cache.Put(10000 + i, i);
+        if (i % 50 == 49) {
+            for (int k = 0; k < kHot; ++k) {
+                CHECK(cache.Get(k, value) && value == k);
+            }
+        }
+    }
+    Cache::Stats stats = cache.GetStats();
+    std::printf("tinylfu: %llu evictions, %llu rejections\n", static_cast<unsigned long long>(stats.evictions),
+                static_cast<unsigned long long>(stats.rejections));
+    CHECK(cache.Size() == static_cast<std::size_t>(kCapacity));
+    // 没有TTL时每多放一个就淘汰一个，拒绝接纳也算在淘汰里
+    CHECK(stats.evictions == static_cast<uint64_t>(kHot + kScan - kCapacity));
+    CHECK(stats.rejections > stats.evictions / 2);
+    CHECK(stats.rejections <= stats.evictions);
+    for (int i = 0; i < kHot; ++i) {
+        CHECK(cache.Get(i, value) && value == i);
+    }
+}
+
+void TestTtl() {
+    Cache cache(64, Cache::Policy::kSlru);
+    int value = 0;
+    cache.Put(1, 1, std::chrono::milliseconds(0));
+    CHECK(!cache.Get(1, value));
+
+    for (int i = 0; i < 10; ++i) {
+        cache.Put(100 + i, i, std::chrono::milliseconds(20));
+    }
+    // 重新Put不带TTL就不再过期
+    cache.Put(100, 7);
+    cache.Put(200, 8, std::chrono::hours(1));
+    CHECK(cache.Get(101, value) && value == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    CHECK(!cache.Get(101, value));
+
+    // 1已经在上面的Put里顺带清理掉了
+    std::size_t removed = cache.CleanUp();
+    Cache::Stats stats = cache.GetStats();
+    CHECK(removed == 9);
+    CHECK(stats.expirations == 1 + 9);
+    CHECK(stats.evictions == 0);
+    CHECK(cache.Size() == 2);
+    CHECK(cache.Get(100, value) && value == 7);
+    CHECK(cache.Get(200, value) && value == 8);
+    CHECK(cache.CleanUp() == 0);
+
+    CHECK(cache.Erase(200));
+    CHECK(!cache.Erase(200));
+    CHECK(cache.Size() == 1);
+    cache.Clear();
+    CHECK(cache.Size() == 0 && !cache.Get(100, value));
+}
+
+// 多线程读写：每次Get都计入命中或未命中，大小不超过容量，读到的值一定是写进去的
+void TestConcurrent() {
+    constexpr int kThreads = 4;
+    constexpr int kOps = 50000;
+    constexpr int kKeys = 4096;
+    Cache cache(1024);
+    std::vector<std::thread> threads;
+    std::vector<int> wrong(kThreads, 0);
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&cache, &wrong, t]() {
+            uint32_t seed = 12345u + t;
+            int value = 0;
+            for (int i = 0; i < kOps; ++i) {
+                seed = seed * 1103515245u + 12345u;
+                int key = static_cast<int>((seed >> 8) % kKeys);
+                if (i % 4 == 0) {
+                    cache.Put(key, key * 3);
+                } else if (cache.Get(key, value) && value != key * 3) {
+                    ++wrong[t];
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    Cache::Stats stats = cache.GetStats();
+    std::printf("concurrent: hit rate %.3f, size %zu of %zu\n", stats.HitRate(), cache.Size(), cache.Capacity());
+    for (int t = 0; t < kThreads; ++t) {
+        CHECK(wrong[t] == 0);
+    }
+    CHECK(stats.hits + stats.misses == static_cast<uint64_t>(kThreads * kOps * 3 / 4));
+    CHECK(cache.Size() <= cache.Capacity());
+    // key的个数是容量的4倍，一定发生过淘汰
+    CHECK(stats.evictions > 0);
+}
+
+int main() {
+    TestSlruEviction();
+    TestTinyLfuAdmission();
+    TestTtl();
+    TestConcurrent();
+    std::printf("concurrent_cache_test passed\n");
+    return 0;
+}
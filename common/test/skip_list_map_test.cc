@@ -0,0 +1,186 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "common/skip_list_map.h"
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::abort();                                                        \
+        }                                                                        \
+    } while (0)
+
+// 统计还活着的value个数，节点释放时value跟着析构，用来看删除的节点有没有被回收
+struct Tracked {
+    static std::atomic<int64_t> live;
+
+    int value = 0;
+
+    explicit Tracked(int v) : value(v) { live.fetch_add(1); }
+    Tracked(const Tracked &other) : value(other.value) { live.fetch_add(1); }
+    Tracked(Tracked &&other) noexcept : value(other.value) { live.fetch_add(1); }
+    ~Tracked() { live.fetch_sub(1); }
+};
+
+std::atomic<int64_t> Tracked::live{0};
+
+void TestBasic() {
+    wzq::SkipListMap<int, int> map;
+    CHECK(map.Empty());
+    for (int i = 99; i >= 0; --i) {
+        CHECK(map.Insert(i, i * 10));
+    }
+    CHECK(!map.Insert(5, 0));
+    CHECK(map.Size() == 100);
+    int value = 0;
+    CHECK(map.Find(5, value) && value == 50);
+    CHECK(map.Erase(5));
+    CHECK(!map.Erase(5));
+    CHECK(!map.Contains(5));
+    CHECK(map.LowerBound(5).Key() == 6);
+    CHECK(map.UpperBound(6).Key() == 7);
+    int expected = 10;
+    std::size_t count = map.ForEachInRange(10, 20, [&](int key, int v) {
+        CHECK(key == expected && v == key * 10);
+        ++expected;
+        return true;
+    });
+    CHECK(count == 10);
+}
+
+// 同一个key反复插入删除，删掉的节点要边跑边回收，不能攒到析构
+void TestEraseLoopMemoryFlat() {
+    constexpr int kRounds = 200000;
+    {
+        wzq::SkipListMap<int, Tracked> map;
+        for (int i = 0; i < 1000; ++i) {
+            map.Insert(i * 2, Tracked(i));
+        }
+        int64_t base = Tracked::live.load();
+        int64_t peak = 0;
+        for (int i = 0; i < kRounds; ++i) {
+            int key = (i % 1000) * 2 + 1;
+            CHECK(map.Insert(key, Tracked(i)));
+            CHECK(map.Erase(key));
+            peak = std::max(peak, Tracked::live.load() - base);
+        }
+        std::printf("erase loop: %d rounds, peak retired %lld\n", kRounds, static_cast<long long>(peak));
+        CHECK(peak < 16);
+        CHECK(map.Size() == 1000);
+    }
+    CHECK(Tracked::live.load() == 0);
+}
+
+// 有读线程一直在查找和短范围遍历时，删除的节点也要边跑边回收，读线程停下后马上回收干净
+void TestEraseLoopWithReaders() {
+    constexpr int kRounds = 100000;
+    {
+        wzq::SkipListMap<int, Tracked> map;
+        for (int i = 0; i < 1000; ++i) {
+            map.Insert(i * 2, Tracked(i));
+        }
+        std::atomic<bool> stop{false};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 2; ++t) {
+            readers.emplace_back([&map, &stop, t]() {
+                int from = t;
+                while (!stop.load()) {
+                    from = (from + 7) % 2000;
+                    int prev = -1;
+                    map.ForEachInRange(from, from + 20, [&prev](int key, const Tracked &value) {
+                        CHECK(key > prev && value.value >= 0);
+                        prev = key;
+                        return true;
+                    });
+                    CHECK(map.Contains(from & ~1));
+                    // 单核机器上读线程几乎一直持有登记，被抢占时写线程整个时间片都回收不了，让出CPU时不持有登记
+                    std::this_thread::yield();
+                }
+            });
+        }
+        int64_t peak = 0;
+        for (int i = 0; i < kRounds; ++i) {
+            int key = (i % 1000) * 2 + 1;
+            CHECK(map.Insert(key, Tracked(i)));
+            CHECK(map.Erase(key));
+            peak = std::max(peak, Tracked::live.load() - 1000);
+        }
+        stop.store(true);
+        for (auto &reader : readers) {
+            reader.join();
+        }
+        std::printf("erase loop with readers: %d rounds, peak retired %lld\n", kRounds,
+                    static_cast<long long>(peak));
+        CHECK(peak < kRounds / 4);
+        for (int i = 0; i < 4; ++i) {
+            CHECK(map.Insert(1, Tracked(1)));
+            CHECK(map.Erase(1));
+        }
+        CHECK(Tracked::live.load() - 1000 < 16);
+    }
+    CHECK(Tracked::live.load() == 0);
+}
+
+// 多个线程抢着插入删除同一批key：成功插入的次数减去成功删除的次数等于最后的大小，遍历有序且不重复
+void TestConcurrentInsertErase() {
+    constexpr int kThreads = 4;
+    constexpr int kKeys = 512;
+    constexpr int kOps = 100000;
+    {
+        wzq::SkipListMap<int, Tracked> map;
+        std::atomic<int64_t> inserted{0};
+        std::atomic<int64_t> erased{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t]() {
+                uint32_t seed = 0x9e3779b9u * static_cast<uint32_t>(t + 1);
+                for (int i = 0; i < kOps; ++i) {
+                    seed ^= seed << 13;
+                    seed ^= seed >> 17;
+                    seed ^= seed << 5;
+                    int key = static_cast<int>(seed % kKeys);
+                    if ((seed >> 16) & 1) {
+                        inserted += map.Insert(key, Tracked(key)) ? 1 : 0;
+                    } else {
+                        erased += map.Erase(key) ? 1 : 0;
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        int64_t count = 0;
+        int prev = -1;
+        for (auto iter = map.Begin(); iter != map.End(); ++iter) {
+            CHECK(iter.Key() > prev);
+            CHECK(iter.Value().value == iter.Key());
+            CHECK(map.Contains(iter.Key()));
+            prev = iter.Key();
+            ++count;
+        }
+        std::printf("concurrent: inserted %lld erased %lld left %lld\n", static_cast<long long>(inserted.load()),
+                    static_cast<long long>(erased.load()), static_cast<long long>(count));
+        CHECK(count == inserted.load() - erased.load());
+        CHECK(static_cast<int64_t>(map.Size()) == count);
+        for (int key = 0; key < kKeys; ++key) {
+            bool present = map.Contains(key);
+            CHECK(map.Erase(key) == present);
+        }
+        CHECK(map.Empty());
+    }
+    CHECK(Tracked::live.load() == 0);
+}
+
+int main() {
+    TestBasic();
+    TestEraseLoopMemoryFlat();
+    TestEraseLoopWithReaders();
+    TestConcurrentInsertErase();
+    std::printf("skip_list_map_test passed\n");
+    return 0;
+}
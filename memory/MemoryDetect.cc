@@ -8,8 +8,12 @@
 #include <stdlib.h>  // abort
 #include <string.h>  // strcpy/strncpy/sprintf
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <vector>
 
 int checkLeaks();
 int checkMemCorruption();
@@ -44,13 +48,23 @@ struct new_ptr_list_t {
     unsigned line : 31;     ///< Line number of the caller; or \c 0
     unsigned is_array : 1;  ///< Non-zero iff <em>new[]</em> is used
     unsigned magic;         ///< Magic number for error detection
+    unsigned generation;    ///< Snapshot generation when allocated
 };
 
 static const unsigned DEBUG_NEW_MAGIC = 0x4442474E;
 
+// 遍历时插在链表里的游标节点，不对应任何内存块
+static const unsigned DEBUG_NEW_CURSOR_MAGIC = 0x43555253;
+
+// 遍历时每次加锁最多看这么多个节点，分配和释放的线程最多被挡这么久
+static const int WALK_CHUNK_NODES = 256;
+
+// 每次加锁最多拷贝出来的内存块信息
+static const int WALK_CHUNK_RECORDS = 64;
+
 static const int ALIGNED_LIST_ITEM_SIZE = ALIGN(sizeof(new_ptr_list_t));
 
-static new_ptr_list_t new_ptr_list = {&new_ptr_list, &new_ptr_list, 0, {""}, 0, 0, DEBUG_NEW_MAGIC};
+static new_ptr_list_t new_ptr_list = {&new_ptr_list, &new_ptr_list, 0, {""}, 0, 0, DEBUG_NEW_MAGIC, 0};
 
 static std::mutex new_ptr_lock;
 
@@ -58,6 +72,9 @@ static std::mutex new_output_lock;
 
 static std::size_t total_mem_alloc = 0;
 
+// 当前的分配代数，由new_ptr_lock保护
+static unsigned new_generation = 0;
+
 bool new_autocheck_flag = true;
 
 bool new_verbose_flag = false;
@@ -96,10 +113,12 @@ static void* alloc_mem(std::size_t size, const char* file, int line, bool is_arr
     ptr->magic = DEBUG_NEW_MAGIC;
     {
         std::unique_lock<std::mutex> lock(new_ptr_lock);
+        ptr->generation = new_generation;
         ptr->prev = new_ptr_list.prev;
         ptr->next = &new_ptr_list;
         new_ptr_list.prev->next = ptr;
         new_ptr_list.prev = ptr;
+        total_mem_alloc += size;
     }
     if (new_verbose_flag) {
         std::unique_lock<std::mutex> lock(new_output_lock);
@@ -111,7 +130,6 @@ static void* alloc_mem(std::size_t size, const char* file, int line, bool is_arr
         }
         printf(")\n");
     }
-    total_mem_alloc += size;
     return usr_ptr;
 }
 
@@ -166,30 +184,130 @@ static void free_pointer(void* usr_ptr, void* addr, bool is_array) {
     free(ptr);
 }
 
-int checkLeaks() {
-    int leak_cnt = 0;
-    int whitelisted_leak_cnt = 0;
-    new_ptr_list_t* ptr = new_ptr_list.next;
+// 汇总时用的容器直接用malloc，不经过这里重载的new，也就不会出现在报告里
+template <typename T>
+struct malloc_allocator {
+    using value_type = T;
 
-    while (ptr != &new_ptr_list) {
-        const char* const usr_ptr = (char*)ptr + ALIGNED_LIST_ITEM_SIZE;
-        if (ptr->magic != DEBUG_NEW_MAGIC) {
-            printf("warning: heap data corrupt near %p\n", usr_ptr);
+    malloc_allocator() = default;
+    template <typename U>
+    malloc_allocator(const malloc_allocator<U>&) {}
+
+    T* allocate(std::size_t n) {
+        T* p = (T*)malloc(n * sizeof(T));
+        if (p == nullptr) {
+            throw std::bad_alloc();
         }
+        return p;
+    }
+    void deallocate(T* p, std::size_t) { free(p); }
 
-        printf("Leaked object at %p (size %lu, ", usr_ptr, (unsigned long)ptr->size);
+    template <typename U>
+    bool operator==(const malloc_allocator<U>&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const malloc_allocator<U>&) const {
+        return false;
+    }
+};
 
-        if (ptr->line != 0) {
-            print_position(ptr->file, ptr->line);
-        } else {
-            print_position(ptr->addr, ptr->line);
+// 从链表里拷贝出来的内存块信息，锁外使用时原来的块可能已经释放了
+struct block_record_t {
+    const void* usr_ptr;
+    std::size_t size;
+    char file[_DEBUG_NEW_FILENAME_LEN];
+    void* addr;
+    unsigned line;
+    bool corrupt;
+};
+
+static void print_record_position(const block_record_t& record) {
+    if (record.line != 0) {
+        print_position(record.file, record.line);
+    } else {
+        print_position(record.addr, record.line);
+    }
+}
+
+/**
+ * 遍历generation及以后分配的内存块，对每块在锁外调用func(const block_record_t&)。
+ * 链表里插入一个游标节点，每次加锁只往后走一小段，把游标挪到停下的位置再解锁，
+ * 遍历期间其它线程照常分配释放；遍历开始后新分配的块在尾部游标之后，不会被看到
+ */
+template <typename F>
+static void walk_blocks(unsigned generation, F&& func) {
+    new_ptr_list_t cursor = {nullptr, nullptr, 0, {""}, 0, 0, DEBUG_NEW_CURSOR_MAGIC, 0};
+    new_ptr_list_t end = cursor;
+    block_record_t records[WALK_CHUNK_RECORDS];
+    {
+        std::unique_lock<std::mutex> lock(new_ptr_lock);
+        cursor.prev = &new_ptr_list;
+        cursor.next = new_ptr_list.next;
+        new_ptr_list.next->prev = &cursor;
+        new_ptr_list.next = &cursor;
+        end.prev = new_ptr_list.prev;
+        end.next = &new_ptr_list;
+        new_ptr_list.prev->next = &end;
+        new_ptr_list.prev = &end;
+    }
+    bool done = false;
+    while (!done) {
+        int num = 0;
+        {
+            std::unique_lock<std::mutex> lock(new_ptr_lock);
+            new_ptr_list_t* ptr = cursor.next;
+            for (int visited = 0; visited < WALK_CHUNK_NODES && num < WALK_CHUNK_RECORDS; ++visited) {
+                if (ptr == &end) {
+                    done = true;
+                    break;
+                }
+                // 别的线程同时遍历时插入的游标，以及比generation早的块都跳过
+                if (ptr->magic != DEBUG_NEW_CURSOR_MAGIC && ptr->generation >= generation) {
+                    block_record_t& record = records[num++];
+                    record.usr_ptr = (char*)ptr + ALIGNED_LIST_ITEM_SIZE;
+                    record.size = ptr->size;
+                    record.line = ptr->line;
+                    if (ptr->line != 0) {
+                        memcpy(record.file, ptr->file, _DEBUG_NEW_FILENAME_LEN);
+                    } else {
+                        record.addr = ptr->addr;
+                    }
+                    record.corrupt = ptr->magic != DEBUG_NEW_MAGIC;
+                }
+                ptr = ptr->next;
+            }
+            // 把游标挪到ptr之前
+            cursor.prev->next = cursor.next;
+            cursor.next->prev = cursor.prev;
+            cursor.next = ptr;
+            cursor.prev = ptr->prev;
+            ptr->prev->next = &cursor;
+            ptr->prev = &cursor;
+            if (done) {
+                cursor.prev->next = cursor.next;
+                cursor.next->prev = cursor.prev;
+                end.prev->next = end.next;
+                end.next->prev = end.prev;
+            }
+        }
+        for (int i = 0; i < num; ++i) {
+            func(records[i]);
         }
+    }
+}
 
+int checkLeaks() {
+    int leak_cnt = 0;
+    walk_blocks(0, [&leak_cnt](const block_record_t& record) {
+        if (record.corrupt) {
+            printf("warning: heap data corrupt near %p\n", record.usr_ptr);
+        }
+        printf("Leaked object at %p (size %lu, ", record.usr_ptr, (unsigned long)record.size);
+        print_record_position(record);
         printf(")\n");
-
-        ptr = ptr->next;
         ++leak_cnt;
-    }
+    });
     if (new_verbose_flag || leak_cnt) {
         printf("*** %d leaks found\n", leak_cnt);
     }
@@ -197,27 +315,72 @@ int checkLeaks() {
     return leak_cnt;
 }
 
-int checkMemCorruption() {
-    int corrupt_cnt = 0;
-    printf("*** Checking for memory corruption: START\n");
-    for (new_ptr_list_t* ptr = new_ptr_list.next; ptr != &new_ptr_list; ptr = ptr->next) {
-        const char* const usr_ptr = (char*)ptr + ALIGNED_LIST_ITEM_SIZE;
-        if (ptr->magic == DEBUG_NEW_MAGIC
-
-        ) {
-            continue;
-        }
+unsigned takeSnapshot() {
+    std::unique_lock<std::mutex> lock(new_ptr_lock);
+    return ++new_generation;
+}
 
-        printf("Heap data corrupt near %p (size %lu, ", usr_ptr, (unsigned long)ptr->size);
+int checkLeaksSince(unsigned snapshot) {
+    using site_string = std::basic_string<char, std::char_traits<char>, malloc_allocator<char>>;
+    struct site_stat_t {
+        std::size_t blocks = 0;
+        std::size_t bytes = 0;
+    };
+    using site_map = std::map<site_string, site_stat_t, std::less<site_string>,
+                              malloc_allocator<std::pair<const site_string, site_stat_t>>>;
 
-        if (ptr->line != 0) {
-            print_position(ptr->file, ptr->line);
+    site_map sites;
+    int leak_cnt = 0;
+    std::size_t leak_bytes = 0;
+    walk_blocks(snapshot, [&](const block_record_t& record) {
+        char position[_DEBUG_NEW_FILENAME_LEN + 16];
+        if (record.line != 0) {
+            snprintf(position, sizeof(position), "%s:%u", record.file, record.line);
+        } else if (record.addr != nullptr) {
+            snprintf(position, sizeof(position), "%p", record.addr);
         } else {
-            print_position(ptr->addr, ptr->line);
+            snprintf(position, sizeof(position), "<Unknown>");
+        }
+        site_stat_t& stat = sites[site_string(position)];
+        ++stat.blocks;
+        stat.bytes += record.size;
+        ++leak_cnt;
+        leak_bytes += record.size;
+    });
+
+    // 按字节数从大到小输出
+    using site_entry = std::pair<const site_string*, site_stat_t>;
+    std::vector<site_entry, malloc_allocator<site_entry>> sorted;
+    sorted.reserve(sites.size());
+    for (const auto& kv : sites) {
+        sorted.emplace_back(&kv.first, kv.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const site_entry& a, const site_entry& b) {
+        return a.second.bytes != b.second.bytes ? a.second.bytes > b.second.bytes : *a.first < *b.first;
+    });
+    for (const site_entry& entry : sorted) {
+        printf("%10lu bytes in %6lu blocks at %s\n", (unsigned long)entry.second.bytes,
+               (unsigned long)entry.second.blocks, entry.first->c_str());
+    }
+    if (new_verbose_flag || leak_cnt) {
+        printf("*** %d blocks (%lu bytes) from %lu call sites allocated since snapshot %u still alive\n", leak_cnt,
+               (unsigned long)leak_bytes, (unsigned long)sites.size(), snapshot);
+    }
+    return leak_cnt;
+}
+
+int checkMemCorruption() {
+    int corrupt_cnt = 0;
+    printf("*** Checking for memory corruption: START\n");
+    walk_blocks(0, [&corrupt_cnt](const block_record_t& record) {
+        if (!record.corrupt) {
+            return;
         }
+        printf("Heap data corrupt near %p (size %lu, ", record.usr_ptr, (unsigned long)record.size);
+        print_record_position(record);
         printf(")\n");
         ++corrupt_cnt;
-    }
+    });
     printf("*** Checking for memory corruption: %d FOUND\n", corrupt_cnt);
     return corrupt_cnt;
 }
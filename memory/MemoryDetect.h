@@ -10,3 +10,9 @@ void* operator new[](std::size_t size, const char* file, int line);
 #define new new (__FILE__, __LINE__)
 
 int checkLeaks();
+
+// 开始一个新的分配代数，返回它的编号；之后分配的内存块都带上这个编号
+unsigned takeSnapshot();
+
+// 只报告snapshot之后分配且还没释放的内存块，按分配位置汇总个数和字节数，返回块数
+int checkLeaksSince(unsigned snapshot);
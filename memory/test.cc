@@ -23,6 +23,19 @@ int main() {
     delete[] a2;
 
     { std::shared_ptr<A> a = std::make_shared<A>(); }
+
+    // 只看快照之后分配还没释放的
+    unsigned snapshot = takeSnapshot();
+    for (int i = 0; i < 10; ++i) {
+        A *a3 = new A;
+        if (i % 2 == 0) {
+            delete a3;
+        }
+    }
+    int *p3 = new int[16];
+    checkLeaksSince(snapshot);
+    delete[] p3;
+
     checkLeaks();
     return 0;
 }
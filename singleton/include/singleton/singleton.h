@@ -1,33 +1,164 @@
 #ifndef __SINGLETON__
 #define __SINGLETON__
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace wzq {
 
+/**
+ * 单例的析构策略，可以针对某个T特化：
+ * kDestroyPriority: 进程退出(或调用SingletonRegistry::DestroyAll)时，priority大的先析构，
+ *                   相同priority按创建顺序的逆序析构
+ * kLeak: 为true时永不析构，适合可能在其它静态对象析构过程中还会被访问的单例
+ */
+template <typename T>
+struct SingletonTraits {
+    static constexpr int kDestroyPriority = 0;
+    static constexpr bool kLeak = false;
+};
+
+// 记录所有创建出来的单例，按约定的顺序统一析构
+class SingletonRegistry {
+   public:
+    static void Register(int priority, void (*destroy)()) {
+        Registry &registry = GetRegistry();
+        std::unique_lock<std::mutex> lock(registry.mutex);
+        if (!registry.atexit_registered) {
+            registry.atexit_registered = true;
+            std::atexit(&SingletonRegistry::DestroyAll);
+        }
+        registry.entries.push_back({priority, registry.entries.size(), destroy});
+    }
+
+    // 析构所有已创建的单例，之后不能再访问它们
+    static void DestroyAll() {
+        std::vector<Entry> entries;
+        {
+            Registry &registry = GetRegistry();
+            std::unique_lock<std::mutex> lock(registry.mutex);
+            entries.swap(registry.entries);
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+            return a.priority != b.priority ? a.priority > b.priority : a.seq > b.seq;
+        });
+        for (const Entry &entry : entries) {
+            entry.destroy();
+        }
+    }
+
+   private:
+    struct Entry {
+        int priority;
+        std::size_t seq;
+        void (*destroy)();
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<Entry> entries;
+        bool atexit_registered = false;
+    };
+
+    static Registry &GetRegistry() {
+        static Registry *registry = new Registry();
+        return *registry;
+    }
+};
+
+/**
+ * 初始化完成后instance()只有一次acquire load和一次判空，可以内联到调用处；
+ * 只有第一次访问才走call_once
+ */
 template <typename T>
 class SingleTon {
- public:
-  static T& instance() {
-    std::call_once(once_, &SingleTon::init);
-    return *value_;
-  }
+   public:
+    static T &instance() {
+        T *value = value_.load(std::memory_order_acquire);
+        if (__builtin_expect(value != nullptr, 1)) {
+            return *value;
+        }
+        return InstanceSlow();
+    }
+
+   private:
+    SingleTon();
+    ~SingleTon();
+
+    SingleTon(const SingleTon &) = delete;
+    SingleTon &operator=(const SingleTon &) = delete;
+
+    __attribute__((noinline)) static T &InstanceSlow() {
+        std::call_once(once_, &SingleTon::init);
+        T *value = value_.load(std::memory_order_acquire);
+        if (value == nullptr) {
+            // 已经被DestroyAll析构(比如在其它静态对象的析构里访问)，call_once不会再创建，直接报错退出
+            std::fprintf(stderr, "%s: singleton accessed after destruction, use SingletonTraits::kLeak\n",
+                         __PRETTY_FUNCTION__);
+            std::abort();
+        }
+        return *value;
+    }
+
+    static void init() {
+        value_.store(new T(), std::memory_order_release);
+        if (!SingletonTraits<T>::kLeak) {
+            SingletonRegistry::Register(SingletonTraits<T>::kDestroyPriority, &SingleTon::destroy);
+        }
+    }
+
+    static void destroy() { delete value_.exchange(nullptr, std::memory_order_acq_rel); }
+
+    static inline std::atomic<T *> value_{nullptr};
+
+    static inline std::once_flag once_;
+};
+
+/**
+ * 每个线程一个实例，第一次在某个线程访问时创建，线程退出时析构。
+ * 快路径只是一次TLS读取和判空
+ */
+template <typename T>
+class ThreadLocalSingleton {
+   public:
+    static T &instance() {
+        T *value = value_;
+        if (__builtin_expect(value != nullptr, 1)) {
+            return *value;
+        }
+        return InstanceSlow();
+    }
+
+   private:
+    ThreadLocalSingleton();
+    ~ThreadLocalSingleton();
 
- private:
-  SingleTon();
-  ~SingleTon();
+    ThreadLocalSingleton(const ThreadLocalSingleton &) = delete;
+    ThreadLocalSingleton &operator=(const ThreadLocalSingleton &) = delete;
 
-  SingleTon(const SingleTon&) = delete;
-  SingleTon& operator=(const SingleTon&) = delete;
+    struct Holder {
+        ~Holder() {
+            delete value_;
+            value_ = nullptr;
+        }
+    };
 
-  static void init() { value_ = new T(); }
-  static T* value_;
+    __attribute__((noinline)) static T &InstanceSlow() {
+        static thread_local Holder holder;
+        (void)holder;
+        value_ = new T();
+        return *value_;
+    }
 
-  static std::once_flag once_;
+    static inline thread_local T *value_ = nullptr;
 };
 
 }  // namespace wzq
 
-#endif
\ No newline at end of file
+#endif
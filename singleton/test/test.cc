@@ -1,6 +1,29 @@
 #include "singleton/singleton.h"
 
+struct Logger {
+    Logger() { std::cout << "Logger constructor" << std::endl; }
+    ~Logger() { std::cout << "Logger deconstructor" << std::endl; }
+    int level = 1;
+};
+
+struct Config {
+    Config() { std::cout << "Config constructor" << std::endl; }
+    ~Config() { std::cout << "Config deconstructor" << std::endl; }
+};
+
+// Config先析构，Logger最后析构
+template <>
+struct wzq::SingletonTraits<Logger> {
+    static constexpr int kDestroyPriority = -1;
+    static constexpr bool kLeak = false;
+};
+
 int main() {
-  std::cout << "hello world" << std::endl;
-  return 0;
-}
\ No newline at end of file
+    std::cout << "hello world" << std::endl;
+    wzq::SingleTon<Logger>::instance().level = 2;
+    wzq::SingleTon<Config>::instance();
+    std::cout << "level " << wzq::SingleTon<Logger>::instance().level << std::endl;
+    std::thread([] { std::cout << "thread level " << wzq::ThreadLocalSingleton<Logger>::instance().level << std::endl; })
+        .join();
+    return 0;
+}
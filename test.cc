@@ -36,7 +36,7 @@ void TestTimerQueue() {
     for (int i = 5; i < 15; ++i) {
         q.AddFuncAfterDuration(std::chrono::seconds(i + 1), [i]() { std::cout << "this is " << i << std::endl; });
 
-        q.AddFuncAtTimePoint(std::chrono::high_resolution_clock::now() + std::chrono::seconds(1),
+        q.AddFuncAtTimePoint(wzq::TimerQueue::Clock::now() + std::chrono::seconds(1),
                              [i]() { std::cout << "this is " << i << " at " << std::endl; });
     }
 
@@ -0,0 +1,31 @@
+#ifndef __BARRIER__
+#define __BARRIER__
+
+#include "common/noncopyable.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+namespace wzq {
+
+/**
+ * 可重复使用的屏障：每凑齐count个线程调用ArriveAndWait，
+ * 最后到达的线程先执行completion，然后放行这一批线程并进入下一轮
+ */
+class Barrier : NonCopyAble {
+   public:
+    explicit Barrier(uint32_t count, std::function<void()> completion = nullptr);
+
+    // 最后到达(执行了completion)的线程返回true
+    bool ArriveAndWait();
+
+   private:
+    const uint32_t count_;
+    std::function<void()> completion_;
+    std::atomic<uint32_t> arrived_;
+    std::atomic<uint32_t> generation_;
+};
+}  // namespace wzq
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef __CANCELLATION__
+#define __CANCELLATION__
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace wzq {
+
+namespace internal {
+
+// Source和它发出的所有Token共享的状态
+struct CancellationState {
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    std::vector<std::weak_ptr<CancellationState>> children;
+
+    void Cancel() {
+        if (cancelled.exchange(true)) {
+            return;
+        }
+        std::vector<std::weak_ptr<CancellationState>> to_cancel;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            to_cancel.swap(children);
+        }
+        for (auto &weak : to_cancel) {
+            if (auto child = weak.lock()) {
+                child->Cancel();
+            }
+        }
+    }
+
+    // 父节点已经取消时直接取消子节点
+    void AddChild(const std::shared_ptr<CancellationState> &child) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (!cancelled.load()) {
+                // 顺便清理已经销毁的子节点，长期存在的父节点不会无限增长
+                if (children.size() >= 16 && children.size() == children.capacity()) {
+                    children.erase(std::remove_if(children.begin(), children.end(),
+                                                  [](const std::weak_ptr<CancellationState> &w) { return w.expired(); }),
+                                   children.end());
+                }
+                children.push_back(child);
+                return;
+            }
+        }
+        child->Cancel();
+    }
+};
+
+}  // namespace internal
+
+/**
+ * 取消令牌：只能查询是否已经取消，拷贝很便宜(一个shared_ptr)。
+ * 默认构造的令牌永远不会被取消
+ */
+class CancellationToken {
+   public:
+    CancellationToken() = default;
+
+    // 正在执行的任务可以在循环里轮询，只有一次acquire load
+    bool IsCancelled() const { return state_ != nullptr && state_->cancelled.load(std::memory_order_acquire); }
+
+    // 是否关联了某个CancellationSource，不关联时调用方可以省掉检查
+    bool CanBeCancelled() const { return state_ != nullptr; }
+
+   private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(std::shared_ptr<internal::CancellationState> state) : state_(std::move(state)) {}
+
+    std::shared_ptr<internal::CancellationState> state_;
+};
+
+/**
+ * 取消源：Cancel()之后它发出的所有Token都变成已取消。
+ * 用父Token构造的Source是子节点，父节点取消时子节点一起取消，子节点取消不影响父节点。
+ * 交给ThreadPool::Run/Post或TimerQueue的任务，如果在开始执行前Token已经取消，就直接跳过
+ */
+class CancellationSource {
+   public:
+    CancellationSource() : state_(std::make_shared<internal::CancellationState>()) {}
+
+    explicit CancellationSource(const CancellationToken &parent) : CancellationSource() {
+        if (parent.state_ != nullptr) {
+            parent.state_->AddChild(state_);
+        }
+    }
+
+    CancellationToken Token() const { return CancellationToken(state_); }
+
+    void Cancel() { state_->Cancel(); }
+
+    bool IsCancelled() const { return state_->cancelled.load(std::memory_order_acquire); }
+
+   private:
+    std::shared_ptr<internal::CancellationState> state_;
+};
+
+}  // namespace wzq
+
+#endif
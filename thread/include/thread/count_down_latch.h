@@ -2,27 +2,43 @@
 #define __COUNT_DOWN_LATCH__
 
 #include "common/noncopyable.h"
+#include "thread/fiber.h"
 
-#include <condition_variable>
+#include <atomic>
+#include <cstdint>
 #include <iostream>
-#include <mutex>
 
 namespace wzq {
+
+/**
+ * 基于原子计数和futex的倒计时门闩：CountDown只是一次CAS，计数已经是0时不再减，
+ * 只有计数变成0的那一次才会调用futex唤醒等待的线程。
+ * 在fiber里Await只挂起fiber，计数的最高两位用来登记等待的fiber，所以计数不能超过kMaxCount
+ */
 class CountDownLatch : NonCopyAble {
    public:
+    static constexpr uint32_t kMaxCount = (1u << 30) - 1;
+
+    // count不能超过kMaxCount
     explicit CountDownLatch(uint32_t count);
 
     void CountDown();
 
-    void Await(uint32_t time_ms = 0);
+    // 等待计数变成0，time_ms为0表示一直等；超时返回false。fiber里带超时的等待仍然阻塞所在的线程
+    bool Await(uint32_t time_ms = 0);
 
     uint32_t GetCount() const;
 
    private:
-    std::condition_variable cv_;
-    mutable std::mutex mutex_;
-    uint32_t count_ = 0;
+    static constexpr uint32_t kFiberWaiting = 1u << 31;  // fiber_waiters_不为空
+    static constexpr uint32_t kFiberLocked = 1u << 30;   // 保护fiber_waiters_的自旋锁
+
+    void AwaitInFiber();
+    void LockFibers();
+
+    std::atomic<uint32_t> count_;
+    FiberWaitQueue fiber_waiters_;
 };
 }  // namespace wzq
 
-#endif
\ No newline at end of file
+#endif
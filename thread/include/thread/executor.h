@@ -0,0 +1,22 @@
+#ifndef __EXECUTOR__
+#define __EXECUTOR__
+
+#include <functional>
+
+namespace wzq {
+
+/**
+ * 执行器接口：把一个不需要返回值的任务交给某个(某些)线程执行。
+ * ThreadPool实现了这个接口，定时器等组件通过它把任务转交给调用方指定的线程
+ */
+class Executor {
+   public:
+    virtual ~Executor() = default;
+
+    // 返回false表示执行器已经关闭，任务没有被接受
+    virtual bool Execute(std::function<void()> task) = 0;
+};
+
+}  // namespace wzq
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __FIBER__
+#define __FIBER__
+
+#include "common/noncopyable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace wzq {
+
+class ThreadPool;
+class FiberScheduler;
+
+/**
+ * 有栈协程：每个fiber有自己的小栈，跑在线程池的工作线程上。
+ * fiber里调用FiberMutex、CountDownLatch::Await、TimerQueue::SleepFor等会阻塞的操作时，
+ * 只挂起这个fiber，工作线程去执行别的任务；被唤醒后重新投递到线程池，可能换一个工作线程继续执行。
+ * 所以同步写法的旧代码放进fiber里，并发数不再受线程池线程数的限制。
+ *
+ * fiber里不要调用会阻塞线程的系统调用或std::mutex的长时间等待，那样会占住工作线程；
+ * 也不要在挂起前后依赖thread_local，恢复时可能已经换了线程
+ */
+class Fiber : NonCopyAble {
+   public:
+    // 当前线程正在执行的fiber，不在fiber里时为nullptr
+    static Fiber *Current();
+
+    // 让出工作线程，重新排到线程池的队尾
+    static void Yield();
+
+    /**
+     * 挂起当前fiber，切回工作线程后在工作线程上调用after(arg)，after里才把fiber交给唤醒方，
+     * 比如添加一个到期时Schedule它的定时任务，这样唤醒时fiber一定已经切出去了
+     */
+    static void Suspend(void (*after)(void *), void *arg);
+
+    /**
+     * 把挂起的fiber重新投递到它的线程池。线程池已经关闭时返回false，fiber被直接销毁：
+     * func捕获的对象会析构，但fiber栈上的局部对象不会析构，它持有的锁也不会释放
+     */
+    static bool Schedule(Fiber *fiber);
+
+   private:
+    friend class FiberScheduler;
+    friend class FiberWaitQueue;
+
+    Fiber() = default;
+    ~Fiber() = default;
+
+    static void Entry(Fiber *fiber);
+    static void Resume(Fiber *fiber);
+
+    // 等待队列用：登记前把wake_state_设成kParking，Park挂起，Unpark唤醒，Unpark在Park切出去之前发生也不会丢
+    static void Park();
+    static void Unpark(Fiber *fiber);
+
+    enum WakeState { kRunning = 0, kParking = 1, kParked = 2, kNotified = 3 };
+
+    FiberScheduler *scheduler_ = nullptr;
+    std::function<void()> func_;
+    void *stack_ = nullptr;  // 包括最低处的保护页
+    void *context_ = nullptr;
+    void *return_context_ = nullptr;
+    void (*after_)(void *) = nullptr;
+    void *after_arg_ = nullptr;
+    bool finished_ = false;
+    Fiber *wait_next_ = nullptr;
+    std::atomic<int> wake_state_{kRunning};
+    // sanitizer切换栈时需要的状态
+    void *sanitizer_fiber_ = nullptr;
+    void *sanitizer_return_fiber_ = nullptr;
+    void *fake_stack_ = nullptr;
+    const void *return_stack_bottom_ = nullptr;
+    std::size_t return_stack_size_ = 0;
+};
+
+/**
+ * 在pool上创建和调度fiber，栈用mmap分配，最低处一页设为不可访问，栈溢出时直接段错误而不是写坏别的内存；
+ * 结束的fiber的栈缓存起来给下一个fiber用。
+ * 析构时等所有fiber执行完，pool要比它活得久
+ */
+class FiberScheduler : NonCopyAble {
+   public:
+    static constexpr std::size_t kDefaultStackSize = 64 * 1024;
+    static constexpr std::size_t kMaxCachedStacks = 1024;
+
+    explicit FiberScheduler(ThreadPool &pool, std::size_t stack_size = kDefaultStackSize);
+    ~FiberScheduler();
+
+    // func抛出的异常被忽略；线程池已经关闭或者栈分配失败时返回false
+    bool Spawn(std::function<void()> func);
+
+    // 还没有结束的fiber个数
+    std::size_t Alive() const;
+
+    // 等所有fiber结束，不能在fiber里调用
+    void Join();
+
+   private:
+    friend class Fiber;
+
+    void *AllocateStack();
+    void FreeStack(void *stack);
+    void OnFinished(Fiber *fiber);
+
+    ThreadPool &pool_;
+    const std::size_t stack_size_;  // 不包括保护页
+    std::mutex stack_mutex_;
+    std::vector<void *> free_stacks_;
+
+    mutable std::mutex alive_mutex_;
+    std::condition_variable alive_cv_;
+    std::size_t alive_ = 0;
+};
+
+/**
+ * fiber的等待队列，相当于fiber用的条件变量，调用方用自己的锁保护所有操作。
+ * Wait登记当前fiber后释放锁再挂起，被唤醒后重新加锁再返回；在挂起之前就被Notify也不会丢失。
+ * Notify把fiber重新投递到线程池
+ */
+class FiberWaitQueue : NonCopyAble {
+   public:
+    FiberWaitQueue() = default;
+
+    void Wait(std::unique_lock<std::mutex> &lock);
+
+    // 调用方的锁不是std::mutex时用：登记当前fiber，调用unlock(arg)后挂起，返回时不重新加锁
+    void Wait(void (*unlock)(void *), void *arg);
+
+    // 把等待的fiber全部移到other里(other原来是空的)，之后可以在锁外唤醒
+    void MoveTo(FiberWaitQueue &other);
+
+    // 唤醒一个，返回是否有fiber在等
+    bool NotifyOne();
+
+    void NotifyAll();
+
+    bool Empty() const { return head_ == nullptr; }
+
+   private:
+    Fiber *head_ = nullptr;
+    Fiber *tail_ = nullptr;
+};
+
+/**
+ * fiber里用的互斥锁：fiber等锁时挂起而不是阻塞工作线程，普通线程也可以用(阻塞在条件变量上)。
+ * 有fiber在等时Unlock直接把锁交给队首的fiber，不会被后来的抢走。
+ * 提供lock/unlock/try_lock，可以配合std::unique_lock、std::lock_guard使用
+ */
+class FiberMutex : NonCopyAble {
+   public:
+    FiberMutex() = default;
+
+    void Lock();
+    bool TryLock();
+    void Unlock();
+
+    void lock() { Lock(); }
+    bool try_lock() { return TryLock(); }
+    void unlock() { Unlock(); }
+
+   private:
+    std::mutex mutex_;
+    bool locked_ = false;
+    FiberWaitQueue fiber_waiters_;
+    std::condition_variable thread_cv_;
+    int thread_waiters_ = 0;
+};
+
+}  // namespace wzq
+
+#endif
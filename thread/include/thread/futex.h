@@ -0,0 +1,55 @@
+#ifndef __FUTEX__
+#define __FUTEX__
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+
+namespace wzq {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32 bit word");
+
+/**
+ * *addr等于expected时睡眠，直到被FutexWake唤醒或超时；time_ms为0表示不超时。
+ * 返回false表示超时，其余情况(被唤醒、值已经变了、被信号打断)都返回true，调用方需要重新检查条件
+ */
+inline bool FutexWait(std::atomic<uint32_t> *addr, uint32_t expected, std::chrono::nanoseconds timeout) {
+    timespec ts;
+    timespec *pts = nullptr;
+    if (timeout.count() > 0) {
+        ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+        ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+        pts = &ts;
+    }
+    long ret = syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE, expected, pts, nullptr, 0);
+    return !(ret != 0 && errno == ETIMEDOUT);
+}
+
+inline bool FutexWait(std::atomic<uint32_t> *addr, uint32_t expected) {
+    return FutexWait(addr, expected, std::chrono::nanoseconds(0));
+}
+
+// 最多唤醒num个等待在addr上的线程
+inline void FutexWake(std::atomic<uint32_t> *addr, int num = INT_MAX) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE, num, nullptr, nullptr, 0);
+}
+
+// 自旋等待时让出流水线
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+}  // namespace wzq
+
+#endif
@@ -0,0 +1,474 @@
+#ifndef __IO_EXECUTOR__
+#define __IO_EXECUTOR__
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/metrics.h"
+#include "common/noncopyable.h"
+#include "common/object_pool.h"
+#include "thread/mpsc_inbox.h"
+#include "thread/thread_pool.h"
+
+namespace wzq {
+
+/**
+ * 异步文件/管道/socket IO：read、write、fsync、accept提交后立即返回，
+ * 完成时回调(或future)拿到结果：>=0是系统调用的返回值，<0是-errno。
+ *
+ * 默认用io_uring：提交方只把请求放进无锁收件箱，一个内部线程把收件箱里攒的请求一次填进提交队列，
+ * 一次io_uring_enter同时完成提交和等待完成，请求多时自然成批；线程池的工作线程不会阻塞在IO上。
+ * 内核不支持io_uring(或被seccomp禁用)时退回到内部线程池里做阻塞调用，接口和语义不变。
+ *
+ * 回调默认在内部线程上执行，应该很短；Options::completion_pool不为空时投递到那个线程池执行。
+ * 析构会等所有已经提交的操作完成，可能一直不完成的操作(accept、对端不写的管道读)要先关掉对端或shutdown
+ */
+class IoExecutor : NonCopyAble {
+   public:
+    enum class Backend { kAuto = 0, kIoUring = 1, kThreadPool = 2 };
+
+    struct Options {
+        unsigned queue_depth = 256;         // 提交队列长度，同时在途的操作数上限是它的两倍
+        Backend backend = Backend::kAuto;   // kIoUring创建失败时也会退回线程池
+        ThreadPool *completion_pool = nullptr;
+        int fallback_threads = 4;           // 退回线程池时的线程数
+        // 固定缓冲区，在内部线程启动前注册，之后用ReadFixed/WriteFixed按下标使用。
+        // 运行中注册在老内核上会和阻塞在io_uring_enter里的内部线程互相等待，所以只能在这里给
+        std::vector<iovec> fixed_buffers;
+    };
+
+    using Callback = std::function<void(int64_t result)>;
+
+    IoExecutor() : IoExecutor(Options()) {}
+
+    explicit IoExecutor(const Options &options) : completion_pool_(options.completion_pool) {
+        if (options.backend != Backend::kThreadPool && SetupRing(options.queue_depth)) {
+            backend_ = Backend::kIoUring;
+            if (!options.fixed_buffers.empty()) {
+                fixed_buffers_ = syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS,
+                                         options.fixed_buffers.data(),
+                                         static_cast<unsigned>(options.fixed_buffers.size())) == 0;
+            }
+            ring_thread_ = std::thread([this]() { RingLoop(); });
+            return;
+        }
+        backend_ = Backend::kThreadPool;
+        int threads = options.fallback_threads < 1 ? 1 : options.fallback_threads;
+        fallback_pool_.reset(new ThreadPool(ThreadPool::ThreadPoolConfig{threads, threads, 0, std::chrono::seconds(60)}));
+        fallback_pool_->Start();
+    }
+
+    ~IoExecutor() {
+        if (backend_ == Backend::kIoUring) {
+            stopping_.store(true);
+            Wake();
+            ring_thread_.join();
+            CloseRing();
+        } else {
+            fallback_pool_->ShutDown();
+        }
+    }
+
+    Backend GetBackend() const { return backend_; }
+
+    void Read(int fd, void *buf, std::size_t len, int64_t offset, Callback callback) {
+        Submit(NewOp(IORING_OP_READ, fd, buf, len, offset, std::move(callback)));
+    }
+
+    void Write(int fd, const void *buf, std::size_t len, int64_t offset, Callback callback) {
+        Submit(NewOp(IORING_OP_WRITE, fd, const_cast<void *>(buf), len, offset, std::move(callback)));
+    }
+
+    // datasync为true时相当于fdatasync
+    void Fsync(int fd, bool datasync, Callback callback) {
+        Op *op = NewOp(IORING_OP_FSYNC, fd, nullptr, 0, 0, std::move(callback));
+        op->flags = datasync ? IORING_FSYNC_DATASYNC : 0;
+        Submit(op);
+    }
+
+    // 结果是新连接的fd(带SOCK_CLOEXEC)
+    void Accept(int fd, Callback callback) { Submit(NewOp(IORING_OP_ACCEPT, fd, nullptr, 0, 0, std::move(callback))); }
+
+    /**
+     * 用Options::fixed_buffers的第buf_index块缓冲区读写，buf必须落在这块缓冲区里；内核不用每次重新映射页面。
+     * 没有注册成功(包括线程池后端)时和普通读写一样
+     */
+    void ReadFixed(int fd, void *buf, std::size_t len, int64_t offset, int buf_index, Callback callback) {
+        Op *op = NewOp(fixed_buffers_ ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, buf, len, offset,
+                       std::move(callback));
+        op->buf_index = static_cast<uint16_t>(buf_index);
+        Submit(op);
+    }
+
+    void WriteFixed(int fd, const void *buf, std::size_t len, int64_t offset, int buf_index, Callback callback) {
+        Op *op = NewOp(fixed_buffers_ ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, const_cast<void *>(buf), len,
+                       offset, std::move(callback));
+        op->buf_index = static_cast<uint16_t>(buf_index);
+        Submit(op);
+    }
+
+    std::future<int64_t> Read(int fd, void *buf, std::size_t len, int64_t offset) {
+        auto promise = std::make_shared<std::promise<int64_t>>();
+        std::future<int64_t> future = promise->get_future();
+        Read(fd, buf, len, offset, [promise](int64_t result) { promise->set_value(result); });
+        return future;
+    }
+
+    std::future<int64_t> Write(int fd, const void *buf, std::size_t len, int64_t offset) {
+        auto promise = std::make_shared<std::promise<int64_t>>();
+        std::future<int64_t> future = promise->get_future();
+        Write(fd, buf, len, offset, [promise](int64_t result) { promise->set_value(result); });
+        return future;
+    }
+
+    std::future<int64_t> Fsync(int fd, bool datasync = false) {
+        auto promise = std::make_shared<std::promise<int64_t>>();
+        std::future<int64_t> future = promise->get_future();
+        Fsync(fd, datasync, [promise](int64_t result) { promise->set_value(result); });
+        return future;
+    }
+
+    std::future<int64_t> Accept(int fd) {
+        auto promise = std::make_shared<std::promise<int64_t>>();
+        std::future<int64_t> future = promise->get_future();
+        Accept(fd, [promise](int64_t result) { promise->set_value(result); });
+        return future;
+    }
+
+    // Options::fixed_buffers是否已经注册到io_uring
+    bool FixedBuffersRegistered() const { return fixed_buffers_; }
+
+    // 已经提交还没有完成的操作个数
+    int64_t InFlight() const { return in_flight_.load(std::memory_order_relaxed); }
+
+    // 发布prefix.in_flight、prefix.completed，线程池后端的线程池在prefix.pool下
+    void PublishMetrics(const std::string &prefix, MetricsRegistry &registry = MetricsRegistry::Global()) {
+        MetricsRegistry::Registration metrics;
+        metrics.Add(registry, prefix + ".in_flight", [this]() { return InFlight(); });
+        metrics.Add(registry, prefix + ".completed", [this]() { return completed_.Value(); });
+        metrics_ = std::move(metrics);
+        if (fallback_pool_ != nullptr) {
+            fallback_pool_->PublishMetrics(prefix + ".pool", registry);
+        }
+    }
+
+   private:
+    struct Op {
+        uint8_t opcode = IORING_OP_NOP;
+        uint16_t buf_index = 0;
+        uint32_t flags = 0;
+        int fd = -1;
+        void *buf = nullptr;
+        std::size_t len = 0;
+        int64_t offset = 0;
+        Callback callback;
+        Op *next_ = nullptr;
+    };
+
+    static constexpr uint64_t kWakeTag = 0;  // eventfd读的user_data，Op指针不会是0
+
+    Op *NewOp(uint8_t opcode, int fd, void *buf, std::size_t len, int64_t offset, Callback callback) {
+        Op *op = ObjectPool<Op>::New();
+        op->opcode = opcode;
+        op->fd = fd;
+        op->buf = buf;
+        op->len = len;
+        op->offset = offset;
+        op->callback = std::move(callback);
+        return op;
+    }
+
+    void Submit(Op *op) {
+        in_flight_.fetch_add(1, std::memory_order_relaxed);
+        if (backend_ == Backend::kThreadPool) {
+            // 线程池已经关闭时不会执行，直接按取消完成，否则回调永远等不到、in_flight_也减不下来
+            if (!fallback_pool_->Post([this, op]() { Complete(op, RunBlocking(op)); })) {
+                Complete(op, -ECANCELED);
+            }
+            return;
+        }
+        // 收件箱从空变成非空时才需要叫醒内部线程，它清空收件箱之前不会再睡
+        if (inbox_.Push(op)) {
+            Wake();
+        }
+    }
+
+    static int64_t RunBlocking(Op *op) {
+        ssize_t ret = -1;
+        switch (op->opcode) {
+            case IORING_OP_READ:
+            case IORING_OP_READ_FIXED:
+                ret = op->offset < 0 ? read(op->fd, op->buf, op->len) : pread(op->fd, op->buf, op->len, op->offset);
+                break;
+            case IORING_OP_WRITE:
+            case IORING_OP_WRITE_FIXED:
+                ret = op->offset < 0 ? write(op->fd, op->buf, op->len) : pwrite(op->fd, op->buf, op->len, op->offset);
+                break;
+            case IORING_OP_FSYNC:
+                ret = (op->flags & IORING_FSYNC_DATASYNC) ? fdatasync(op->fd) : fsync(op->fd);
+                break;
+            case IORING_OP_ACCEPT:
+                ret = accept4(op->fd, nullptr, nullptr, SOCK_CLOEXEC);
+                break;
+            default:
+                errno = EINVAL;
+                break;
+        }
+        return ret < 0 ? -static_cast<int64_t>(errno) : static_cast<int64_t>(ret);
+    }
+
+    void Complete(Op *op, int64_t result) {
+        Callback callback = std::move(op->callback);
+        ObjectPool<Op>::Delete(op);
+        if (callback) {
+            if (completion_pool_ == nullptr || !completion_pool_->Post([callback, result]() { callback(result); })) {
+                try {
+                    callback(result);
+                } catch (...) {
+                    // 和ThreadPool::Post一样忽略回调的异常
+                }
+            }
+        }
+        completed_.Add();
+        in_flight_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void Wake() {
+        uint64_t one = 1;
+        ssize_t ret = write(wake_fd_, &one, sizeof(one));
+        (void)ret;
+    }
+
+    // 以下是io_uring后端，提交队列和完成队列只由内部线程访问
+
+    bool SetupRing(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return false;
+        }
+        ring_fd_ = fd;
+        sq_map_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+        }
+        sq_map_ = mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cq_map_ = single_mmap ? sq_map_
+                              : mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                     IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(
+            mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        wake_fd_ = eventfd(0, EFD_CLOEXEC);
+        if (sq_map_ == MAP_FAILED || cq_map_ == MAP_FAILED || sqes_ == MAP_FAILED || wake_fd_ < 0) {
+            CloseRing();
+            return false;
+        }
+        char *sq = static_cast<char *>(sq_map_);
+        sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sq_entries_ = params.sq_entries;
+        char *cq = static_cast<char *>(cq_map_);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        cq_entries_ = params.cq_entries;
+        return true;
+    }
+
+    void CloseRing() {
+        if (sqes_ != nullptr && sqes_ != MAP_FAILED) {
+            munmap(sqes_, sqes_size_);
+        }
+        if (cq_map_ != nullptr && cq_map_ != MAP_FAILED && cq_map_ != sq_map_) {
+            munmap(cq_map_, cq_map_size_);
+        }
+        if (sq_map_ != nullptr && sq_map_ != MAP_FAILED) {
+            munmap(sq_map_, sq_map_size_);
+        }
+        sqes_ = nullptr;
+        sq_map_ = cq_map_ = nullptr;
+        for (int *fd : {&ring_fd_, &wake_fd_}) {
+            if (*fd >= 0) {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+
+    // 提交队列满了返回nullptr
+    io_uring_sqe *NextSqe() {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sq_local_tail_ - head >= sq_entries_) {
+            return nullptr;
+        }
+        unsigned index = sq_local_tail_ & sq_mask_;
+        io_uring_sqe *sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        ++sq_local_tail_;
+        return sqe;
+    }
+
+    void Prepare(io_uring_sqe *sqe, Op *op) {
+        sqe->opcode = op->opcode;
+        sqe->fd = op->fd;
+        sqe->addr = reinterpret_cast<uint64_t>(op->buf);
+        sqe->len = static_cast<uint32_t>(op->len);
+        // -1表示用文件当前的偏移(管道、socket)
+        sqe->off = static_cast<uint64_t>(op->offset);
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+        if (op->opcode == IORING_OP_FSYNC) {
+            sqe->fsync_flags = op->flags;
+        } else if (op->opcode == IORING_OP_ACCEPT) {
+            sqe->accept_flags = SOCK_CLOEXEC;
+        } else if (op->opcode == IORING_OP_READ_FIXED || op->opcode == IORING_OP_WRITE_FIXED) {
+            sqe->buf_index = op->buf_index;
+        }
+    }
+
+    // eventfd上一直挂着一个读，Wake写eventfd让它完成，阻塞在io_uring_enter里的内部线程就醒了
+    bool ArmWake() {
+        io_uring_sqe *sqe = NextSqe();
+        if (sqe == nullptr) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = wake_fd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&wake_buf_);
+        sqe->len = sizeof(wake_buf_);
+        sqe->user_data = kWakeTag;
+        return true;
+    }
+
+    void RingLoop() {
+        // 在途的操作数不超过完成队列长度，完成队列不会溢出；eventfd的读占一个
+        const unsigned max_ring_ops = cq_entries_ - 1;
+        unsigned ring_ops = 0;
+        bool wake_armed = ArmWake();
+        Op *pending_head = nullptr;
+        Op *pending_tail = nullptr;
+        for (;;) {
+            // 先取收件箱，之后的Push一定会写eventfd
+            Op *taken = inbox_.TakeAll();
+            if (taken != nullptr) {
+                (pending_tail != nullptr ? pending_tail->next_ : pending_head) = taken;
+                for (pending_tail = taken; pending_tail->next_ != nullptr;) {
+                    pending_tail = pending_tail->next_;
+                }
+            }
+            if (!wake_armed) {
+                wake_armed = ArmWake();
+            }
+            while (pending_head != nullptr && ring_ops < max_ring_ops) {
+                io_uring_sqe *sqe = NextSqe();
+                if (sqe == nullptr) {
+                    break;
+                }
+                Op *op = pending_head;
+                pending_head = op->next_;
+                if (pending_head == nullptr) {
+                    pending_tail = nullptr;
+                }
+                Prepare(sqe, op);
+                ++ring_ops;
+            }
+            if (stopping_.load() && ring_ops == 0 && pending_head == nullptr && inbox_.Empty()) {
+                break;
+            }
+            __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+            unsigned to_submit = sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+            long ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                // 不应该发生：已经取出的操作没法再提交，按失败完成，避免调用方一直等
+                int error = errno;
+                while (pending_head != nullptr) {
+                    Op *op = pending_head;
+                    pending_head = op->next_;
+                    Complete(op, -error);
+                }
+                pending_tail = nullptr;
+            }
+            // 收割完成队列
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            while (head != tail) {
+                io_uring_cqe *cqe = &cqes_[head & cq_mask_];
+                uint64_t user_data = cqe->user_data;
+                int32_t result = cqe->res;
+                ++head;
+                __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+                if (user_data == kWakeTag) {
+                    wake_armed = false;
+                    continue;
+                }
+                --ring_ops;
+                Complete(reinterpret_cast<Op *>(user_data), result);
+            }
+        }
+    }
+
+   private:
+    Backend backend_ = Backend::kThreadPool;
+    bool fixed_buffers_ = false;
+    ThreadPool *completion_pool_;
+    std::atomic<int64_t> in_flight_{0};
+    StripedCounter completed_;
+
+    // 线程池后端
+    std::unique_ptr<ThreadPool> fallback_pool_;
+
+    // io_uring后端
+    MpscInbox<Op> inbox_;
+    std::atomic<bool> stopping_{false};
+    std::thread ring_thread_;
+    int ring_fd_ = -1;
+    int wake_fd_ = -1;
+    uint64_t wake_buf_ = 0;
+    void *sq_map_ = nullptr;
+    void *cq_map_ = nullptr;
+    std::size_t sq_map_size_ = 0;
+    std::size_t cq_map_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+    unsigned cq_entries_ = 0;
+
+    MetricsRegistry::Registration metrics_;
+};
+
+}  // namespace wzq
+
+#endif
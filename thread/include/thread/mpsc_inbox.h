@@ -0,0 +1,49 @@
+#ifndef __MPSC_INBOX__
+#define __MPSC_INBOX__
+
+#include <atomic>
+
+namespace wzq {
+
+/**
+ * 多生产者单消费者的无锁收件箱，侵入式：T需要有一个T* next_成员。
+ * Push只是一次CAS，消费者用TakeAll一次性取走全部节点(按Push的先后顺序)
+ */
+template <typename T>
+class MpscInbox {
+   public:
+    MpscInbox() = default;
+    MpscInbox(const MpscInbox &) = delete;
+    MpscInbox &operator=(const MpscInbox &) = delete;
+
+    // 返回true表示放入前收件箱是空的
+    bool Push(T *node) {
+        T *head = head_.load(std::memory_order_relaxed);
+        do {
+            node->next_ = head;
+        } while (!head_.compare_exchange_weak(head, node, std::memory_order_seq_cst, std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    // 取走所有节点，返回链表头，链表顺序和Push的顺序相同
+    T *TakeAll() {
+        T *head = head_.exchange(nullptr, std::memory_order_seq_cst);
+        T *prev = nullptr;
+        while (head != nullptr) {
+            T *next = head->next_;
+            head->next_ = prev;
+            prev = head;
+            head = next;
+        }
+        return prev;
+    }
+
+    bool Empty() const { return head_.load(std::memory_order_seq_cst) == nullptr; }
+
+   private:
+    std::atomic<T *> head_{nullptr};
+};
+
+}  // namespace wzq
+
+#endif
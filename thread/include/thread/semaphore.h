@@ -0,0 +1,35 @@
+#ifndef __SEMAPHORE__
+#define __SEMAPHORE__
+
+#include "common/noncopyable.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace wzq {
+
+/**
+ * 计数信号量：有余量时Acquire只是一次CAS，Release只有在有线程睡眠时才调用futex唤醒
+ */
+class Semaphore : NonCopyAble {
+   public:
+    explicit Semaphore(uint32_t count = 0);
+
+    void Acquire();
+
+    bool TryAcquire();
+
+    // 最多等待time_ms毫秒，超时返回false
+    bool TryAcquireFor(uint32_t time_ms);
+
+    void Release(uint32_t num = 1);
+
+    uint32_t GetCount() const;
+
+   private:
+    std::atomic<uint32_t> count_;
+    std::atomic<uint32_t> waiters_;
+};
+}  // namespace wzq
+
+#endif
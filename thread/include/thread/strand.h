@@ -0,0 +1,153 @@
+#ifndef __STRAND__
+#define __STRAND__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/noncopyable.h"
+#include "common/object_pool.h"
+#include "thread/executor.h"
+#include "thread/mpsc_inbox.h"
+
+namespace wzq {
+
+/**
+ * 串行执行器：投递到同一个Strand的任务按投递顺序一个接一个执行，不会并发，
+ * 但不独占线程，任务由底层执行器(比如ThreadPool)的任意工作线程执行。
+ * 投递是一次CAS加一次原子加；只有Strand从空闲变成忙时才向底层执行器提交一次
+ */
+class Strand : public Executor, wzq::NonCopyAble {
+   public:
+    // 一次最多连续执行的任务数，超过后重新提交给底层执行器，让其它Strand的任务也有机会执行
+    static constexpr int kMaxBatch = 64;
+
+    explicit Strand(Executor &executor) : executor_(executor) {}
+
+    // 等待已投递的任务全部执行完，在自己的任务里析构会死锁
+    ~Strand() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_cv_.wait(lock, [this]() { return pending_.load() == 0; });
+    }
+
+    void Post(std::function<void()> task) {
+        Node *node = ObjectPool<Node>::New();
+        node->task = std::move(task);
+        inbox_.Push(node);
+        if (pending_.fetch_add(1) == 0) {
+            Schedule();
+        }
+    }
+
+    bool Execute(std::function<void()> task) override {
+        Post(std::move(task));
+        return true;
+    }
+
+    // 当前线程是否正在执行这个Strand的任务
+    bool RunningInThisThread() const { return current_ == this; }
+
+   private:
+    struct Node {
+        std::function<void()> task;
+        Node *next_ = nullptr;
+    };
+
+    /**
+     * 底层执行器已经关闭时直接在当前线程循环执行，保证任务不会丢；
+     * 用循环而不是在Drain末尾再调Schedule，否则每kMaxBatch个任务栈就深一层
+     */
+    void Schedule() {
+        if (executor_.Execute([this]() {
+                if (Drain()) {
+                    Schedule();
+                }
+            })) {
+            return;
+        }
+        while (Drain()) {
+        }
+    }
+
+    // 同一时刻只有一个线程在Drain，local_只由它访问。返回true表示还有任务没执行，需要再调度一次
+    bool Drain() {
+        const Strand *prev = current_;
+        current_ = this;
+        int done = 0;
+        while (done < kMaxBatch) {
+            if (local_ == nullptr) {
+                local_ = inbox_.TakeAll();
+                if (local_ == nullptr) {
+                    break;
+                }
+            }
+            Node *node = local_;
+            local_ = node->next_;
+            try {
+                node->task();
+            } catch (...) {
+                // 和ThreadPool::Post一样忽略异常，不影响后面的任务
+            }
+            ObjectPool<Node>::Delete(node);
+            ++done;
+        }
+        current_ = prev;
+        /**
+         * Post是先放进inbox_再加计数，所以这里可能执行了还没计数的任务，计数会暂时小于0，
+         * 那个Post加计数时看到的不是0，不会再提交。只有减完之后仍大于0才说明还有任务没执行
+         */
+        int64_t left = 0;
+        {
+            // 在锁里减计数，析构只能在解锁之后看到0，解锁后不能再访问成员。每批加一次锁
+            std::lock_guard<std::mutex> lock(mutex_);
+            left = pending_.fetch_sub(done) - done;
+            if (left == 0) {
+                idle_cv_.notify_all();
+            }
+        }
+        return left > 0;
+    }
+
+   private:
+    static inline thread_local const Strand *current_ = nullptr;
+
+    Executor &executor_;
+    MpscInbox<Node> inbox_;
+    Node *local_ = nullptr;
+    std::atomic<int64_t> pending_{0};
+    std::mutex mutex_;
+    std::condition_variable idle_cv_;
+};
+
+/**
+ * 按key串行：相同key的任务按投递顺序执行且不会并发，不同key的任务在线程池里并行执行，
+ * 调用方不需要为每个key的状态加锁。key按hash分到固定个数的Strand上，
+ * 不同key落到同一个Strand时也会串行，strand_num取并发key数的几倍可以减少这种情况
+ */
+template <typename K, typename Hash = std::hash<K>>
+class KeyedStrands : wzq::NonCopyAble {
+   public:
+    explicit KeyedStrands(Executor &executor, std::size_t strand_num = 256) {
+        strands_.reserve(strand_num == 0 ? 1 : strand_num);
+        for (std::size_t i = 0; i < strand_num || strands_.empty(); ++i) {
+            strands_.emplace_back(new Strand(executor));
+        }
+    }
+
+    void Post(const K &key, std::function<void()> task) { GetStrand(key).Post(std::move(task)); }
+
+    Strand &GetStrand(const K &key) { return *strands_[Hash()(key) % strands_.size()]; }
+
+    std::size_t Size() const { return strands_.size(); }
+
+   private:
+    std::vector<std::unique_ptr<Strand>> strands_;
+};
+
+}  // namespace wzq
+
+#endif
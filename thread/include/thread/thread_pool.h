@@ -1,6 +1,11 @@
 #ifndef __THREAD_POOL__
 #define __THREAD_POOL__
 
+#include "common/metrics.h"
+#include "common/object_pool.h"
+#include "thread/cancellation.h"
+#include "thread/executor.h"
+
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
@@ -11,6 +16,7 @@
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
 #include <tuple>
 #include <utility>
@@ -21,7 +27,7 @@ using std::endl;
 
 namespace wzq {
 
-class ThreadPool {
+class ThreadPool : public Executor {
    public:
     using PoolSeconds = std::chrono::seconds;
 
@@ -35,12 +41,19 @@ class ThreadPool {
      *
      * time_out: Cache线程的超时时间，Cache线程指的是max_threads-core_threads的线程,
      * 当time_out时间内没有执行任务，此线程就会被自动回收
+     *
+     * prewarm: 线程启动后先预热(摸一遍栈页、初始化malloc的线程缓存)再开始等任务，
+     * 缺页和首次分配的开销留在Start里，而不是落在最先提交的那批任务上
+     *
+     * verbose: 往std::cout打印线程的创建、等待、退出等调试日志，默认关闭
      */
     struct ThreadPoolConfig {
         int core_threads;
         int max_threads;
         int max_task_size;
         PoolSeconds time_out;
+        bool prewarm = false;
+        bool verbose = false;
     };
 
     /**
@@ -66,21 +79,23 @@ class ThreadPool {
         ThreadId id;
         ThreadFlagAtomic flag;
         ThreadStateAtomic state;
+        bool exited;  // 线程函数已经返回，由worker_mutex_保护
 
         ThreadWrapper() {
             ptr = nullptr;
             id = 0;
             state.store(ThreadState::kInit);
+            exited = false;
         }
     };
     using ThreadWrapperPtr = std::shared_ptr<ThreadWrapper>;
     using ThreadPoolLock = std::unique_lock<std::mutex>;
 
     ThreadPool(ThreadPoolConfig config) : config_(config) {
-        this->total_function_num_.store(0);
         this->waiting_thread_num_.store(0);
 
         this->thread_id_.store(0);
+        this->thread_num_.store(0);
         this->is_shutdown_.store(false);
         this->is_shutdown_now_.store(false);
 
@@ -91,6 +106,7 @@ class ThreadPool {
         }
     }
 
+    // 等所有工作线程执行完剩下的任务并退出，在线程池自己的任务里析构是未定义行为
     ~ThreadPool() { ShutDown(); }
 
     bool Reset(ThreadPoolConfig config) {
@@ -104,29 +120,57 @@ class ThreadPool {
         return true;
     }
 
-    // 开启线程池功能
+    /**
+     * 开启线程池功能。有核心线程创建失败(EAGAIN、RLIMIT_NPROC等)时返回false，
+     * 已经启动的线程照常工作，调用方可以用ShutDown关掉
+     */
     bool Start() {
         if (!IsAvailable()) {
             return false;
         }
         int core_thread_num = config_.core_threads;
-        cout << "Init thread num " << core_thread_num << endl;
-        while (core_thread_num-- > 0) {
-            AddThread(GetNextThreadId());
+        int ready_target = 0;
+        int failed_before = 0;
+        {
+            ThreadPoolLock lock(this->worker_mutex_);
+            ready_target = this->ready_thread_num_ + core_thread_num;
+            failed_before = this->failed_core_num_;
         }
-        cout << "Init thread end" << endl;
-        return true;
+        Log("Init thread num ", core_thread_num);
+        // 创建线程要进内核，已经启动的线程帮忙创建剩下的，核心线程多时启动时间是log级别的
+        if (!AddThread(GetNextThreadId(), ThreadFlag::kCore, core_thread_num - 1)) {
+            ThreadPoolLock lock(this->worker_mutex_);
+            this->failed_core_num_ += core_thread_num;
+        }
+        // 等所有核心线程都进入等待任务的状态(或者确定创建失败)再返回
+        bool ok = false;
+        {
+            ThreadPoolLock lock(this->worker_mutex_);
+            this->worker_cv_.wait(lock, [this, ready_target, failed_before] {
+                return this->ready_thread_num_ + this->failed_core_num_ - failed_before >= ready_target;
+            });
+            ok = this->failed_core_num_ == failed_before;
+        }
+        Log("Init thread end");
+        return ok;
     }
 
     // 获取正在处于等待状态的线程的个数
     int GetWaitingThreadSize() { return this->waiting_thread_num_.load(); }
 
     // 获取线程池中当前线程的总个数
-    int GetTotalThreadSize() { return this->worker_threads_.size(); }
+    int GetTotalThreadSize() { return this->thread_num_.load(); }
 
     // 放在线程池中执行函数
     template <typename F, typename... Args>
     auto Run(F &&f, Args &&... args) -> std::shared_ptr<std::future<std::result_of_t<F(Args...)>>> {
+        return Run(CancellationToken(), std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // 任务开始执行前token已经取消时直接跳过，对应的future.get()抛出std::future_error(broken_promise)
+    template <typename F, typename... Args>
+    auto Run(const CancellationToken &token, F &&f, Args &&... args)
+        -> std::shared_ptr<std::future<std::result_of_t<F(Args...)>>> {
         if (this->is_shutdown_.load() || this->is_shutdown_now_.load() || !IsAvailable()) {
             return nullptr;
         }
@@ -135,39 +179,106 @@ class ThreadPool {
         }
 
         using return_type = std::result_of_t<F(Args...)>;
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
+        // 任务和future的控制块从对象池分配，避免每个任务都走一次malloc
+        auto task = std::allocate_shared<std::packaged_task<return_type()>>(
+            PoolAllocator<std::packaged_task<return_type()>>(),
             std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-        total_function_num_++;
+        total_function_num_.Add();
 
         std::future<return_type> res = task->get_future();
         {
             ThreadPoolLock lock(this->task_mutex_);
-            this->tasks_.emplace([task]() { (*task)(); });
+            if (token.CanBeCancelled()) {
+                this->tasks_.emplace([task, token]() {
+                    if (!token.IsCancelled()) {
+                        (*task)();
+                    }
+                });
+            } else {
+                this->tasks_.emplace([task]() { (*task)(); });
+            }
         }
         this->task_cv_.notify_one();
-        return std::make_shared<std::future<std::result_of_t<F(Args...)>>>(std::move(res));
+        return std::allocate_shared<std::future<return_type>>(PoolAllocator<std::future<return_type>>(), std::move(res));
     }
 
+    // 放在线程池中执行，不需要返回值时使用，省掉了packaged_task和future；任务抛出的异常被忽略
+    bool Post(std::function<void()> task) {
+        if (this->is_shutdown_.load() || this->is_shutdown_now_.load() || !IsAvailable()) {
+            return false;
+        }
+        if (GetWaitingThreadSize() == 0 && GetTotalThreadSize() < config_.max_threads) {
+            AddThread(GetNextThreadId(), ThreadFlag::kCache);
+        }
+        total_function_num_.Add();
+        {
+            ThreadPoolLock lock(this->task_mutex_);
+            this->tasks_.emplace(std::move(task));
+        }
+        this->task_cv_.notify_one();
+        return true;
+    }
+
+    // 任务开始执行前token已经取消时直接跳过
+    bool Post(const CancellationToken &token, std::function<void()> task) {
+        if (!token.CanBeCancelled()) {
+            return Post(std::move(task));
+        }
+        return Post([token, task = std::move(task)]() {
+            if (!token.IsCancelled()) {
+                task();
+            }
+        });
+    }
+
+    bool Execute(std::function<void()> task) override { return Post(std::move(task)); }
+
     // 获取当前线程池已经执行过的函数个数
-    int GetRunnedFuncNum() { return total_function_num_.load(); }
+    int64_t GetRunnedFuncNum() { return total_function_num_.Value(); }
 
-    // 关掉线程池，内部还没有执行的任务会继续执行
+    // 关掉线程池，内部还没有执行的任务会继续执行，返回时所有工作线程都已经退出并join
     void ShutDown() {
-        ShutDown(false);
-        cout << "shutdown" << endl;
+        SetShutDown(false);
+        JoinWorkers(false, std::chrono::milliseconds(0));
+        Log("shutdown");
     }
 
-    // 执行关掉线程池，内部还没有执行的任务直接取消，不会再执行
+    // 执行关掉线程池，内部还没有执行的任务直接取消，不会再执行；正在执行的任务会执行完
     void ShutDownNow() {
-        ShutDown(true);
-        cout << "shutdown now" << endl;
+        SetShutDown(true);
+        JoinWorkers(false, std::chrono::milliseconds(0));
+        Log("shutdown now");
+    }
+
+    // 最多等timeout，超时返回false，线程池已经不再接收任务，剩下的线程由之后的ShutDown或析构join
+    bool ShutDown(std::chrono::milliseconds timeout) {
+        SetShutDown(false);
+        return JoinWorkers(true, timeout);
+    }
+
+    bool ShutDownNow(std::chrono::milliseconds timeout) {
+        SetShutDown(true);
+        return JoinWorkers(true, timeout);
     }
 
     // 当前线程池是否可用
     bool IsAvailable() { return is_available_.load(); }
 
+    // 把线程池的指标以prefix.xxx的名字发布到registry，重复调用会替换之前的注册
+    void PublishMetrics(const std::string &prefix, MetricsRegistry &registry = MetricsRegistry::Global()) {
+        MetricsRegistry::Registration metrics;
+        metrics.Add(registry, prefix + ".submitted", [this]() { return GetRunnedFuncNum(); });
+        metrics.Add(registry, prefix + ".threads", [this]() { return GetTotalThreadSize(); });
+        metrics.Add(registry, prefix + ".waiting_threads", [this]() { return GetWaitingThreadSize(); });
+        metrics.Add(registry, prefix + ".queue_size", [this]() {
+            ThreadPoolLock lock(this->task_mutex_);
+            return static_cast<int64_t>(this->tasks_.size());
+        });
+        metrics_ = std::move(metrics);
+    }
+
    private:
-    void ShutDown(bool is_now) {
+    void SetShutDown(bool is_now) {
         if (is_available_.load()) {
             if (is_now) {
                 this->is_shutdown_now_.store(true);
@@ -179,14 +290,91 @@ class ThreadPool {
         }
     }
 
+    // 等工作线程全部退出后join；在工作线程里调用时不等自己，自己留给之后的ShutDown或析构join
+    bool JoinWorkers(bool has_timeout, std::chrono::milliseconds timeout) {
+        const int self_num = current_pool_ == this ? 1 : 0;
+        std::list<ThreadWrapperPtr> threads;
+        {
+            ThreadPoolLock lock(this->worker_mutex_);
+            auto all_exited = [this, self_num] {
+                return this->thread_num_.load() <= self_num && this->adding_thread_num_ == 0;
+            };
+            if (has_timeout) {
+                if (!this->worker_cv_.wait_for(lock, timeout, all_exited)) {
+                    return false;
+                }
+            } else {
+                this->worker_cv_.wait(lock, all_exited);
+            }
+            threads.swap(this->worker_threads_);
+            const std::thread::id self = std::this_thread::get_id();
+            for (auto iter = threads.begin(); iter != threads.end(); ++iter) {
+                if ((*iter)->ptr->get_id() == self) {
+                    this->worker_threads_.splice(this->worker_threads_.end(), threads, iter);
+                    break;
+                }
+            }
+        }
+        for (auto &thread_ptr : threads) {
+            thread_ptr->ptr->join();
+        }
+        return true;
+    }
+
+    // 调用方持有worker_mutex_，已经退出的Cache线程在这里join掉，链表不会无限增长
+    void ReapExitedThreads() {
+        auto iter = worker_threads_.begin();
+        while (iter != worker_threads_.end()) {
+            if ((*iter)->exited) {
+                (*iter)->ptr->join();
+                iter = worker_threads_.erase(iter);
+            } else {
+                ++iter;
+            }
+        }
+    }
+
+    static void Prewarm() {
+        volatile char stack[kPrewarmStackBytes];
+        for (std::size_t i = 0; i < sizeof(stack); i += kPageSize) {
+            stack[i] = 0;
+        }
+        ::operator delete(::operator new(kPageSize));
+        std::function<void()> noop = []() {};
+        noop();
+    }
+
     void AddThread(int id) { AddThread(id, ThreadFlag::kCore); }
 
-    void AddThread(int id, ThreadFlag thread_flag) {
-        cout << "AddThread " << id << " flag " << static_cast<int>(thread_flag) << endl;
+    /**
+     * spawn_num: 新线程启动后再负责创建的同类线程个数，每次把一半交给自己创建的子线程。
+     * 创建线程失败时返回false，不抛异常(可能在工作线程的线程函数里调用)
+     */
+    bool AddThread(int id, ThreadFlag thread_flag, int spawn_num = 0) {
+        Log("AddThread ", id, " flag ", static_cast<int>(thread_flag));
         ThreadWrapperPtr thread_ptr = std::make_shared<ThreadWrapper>();
         thread_ptr->id.store(id);
         thread_ptr->flag.store(thread_flag);
-        auto func = [this, thread_ptr]() {
+        auto func = [this, thread_ptr, spawn_num]() {
+            current_pool_ = this;
+            int remain = spawn_num;
+            while (remain > 0) {
+                int child = remain / 2;
+                if (!AddThread(GetNextThreadId(), thread_ptr->flag.load(), child)) {
+                    // 异常不能逃出线程函数，停止创建，剩下的都记为失败，Start据此返回false
+                    {
+                        ThreadPoolLock lock(this->worker_mutex_);
+                        this->failed_core_num_ += remain;
+                    }
+                    this->worker_cv_.notify_all();
+                    break;
+                }
+                remain -= child + 1;
+            }
+            if (this->config_.prewarm) {
+                Prewarm();
+            }
+            bool report_ready = thread_ptr->flag.load() == ThreadFlag::kCore;
             for (;;) {
                 std::function<void()> task;
                 {
@@ -194,9 +382,18 @@ class ThreadPool {
                     if (thread_ptr->state.load() == ThreadState::kStop) {
                         break;
                     }
-                    cout << "thread id " << thread_ptr->id.load() << " running start" << endl;
+                    Log("thread id ", thread_ptr->id.load(), " running start");
                     thread_ptr->state.store(ThreadState::kWaiting);
                     ++this->waiting_thread_num_;
+                    if (report_ready) {
+                        // 第一次进入等待时通知Start
+                        report_ready = false;
+                        {
+                            ThreadPoolLock worker_lock(this->worker_mutex_);
+                            ++this->ready_thread_num_;
+                        }
+                        this->worker_cv_.notify_all();
+                    }
                     bool is_timeout = false;
                     if (thread_ptr->flag.load() == ThreadFlag::kCore) {
                         this->task_cv_.wait(lock, [this, thread_ptr] {
@@ -212,49 +409,84 @@ class ThreadPool {
                                        thread_ptr->state.load() == ThreadState::kStop);
                     }
                     --this->waiting_thread_num_;
-                    cout << "thread id " << thread_ptr->id.load() << " running wait end" << endl;
+                    Log("thread id ", thread_ptr->id.load(), " running wait end");
 
                     if (is_timeout) {
                         thread_ptr->state.store(ThreadState::kStop);
                     }
 
                     if (thread_ptr->state.load() == ThreadState::kStop) {
-                        cout << "thread id " << thread_ptr->id.load() << " state stop" << endl;
+                        Log("thread id ", thread_ptr->id.load(), " state stop");
                         break;
                     }
                     if (this->is_shutdown_ && this->tasks_.empty()) {
-                        cout << "thread id " << thread_ptr->id.load() << " shutdown" << endl;
+                        Log("thread id ", thread_ptr->id.load(), " shutdown");
                         break;
                     }
                     if (this->is_shutdown_now_) {
-                        cout << "thread id " << thread_ptr->id.load() << " shutdown now" << endl;
+                        Log("thread id ", thread_ptr->id.load(), " shutdown now");
                         break;
                     }
                     thread_ptr->state.store(ThreadState::kRunning);
                     task = std::move(this->tasks_.front());
                     this->tasks_.pop();
                 }
-                task();
+                // Post的任务没有future接收异常，这里忽略，避免工作线程退出
+                try {
+                    task();
+                } catch (...) {
+                }
+            }
+            Log("thread id ", thread_ptr->id.load(), " running end");
+            {
+                ThreadPoolLock lock(this->worker_mutex_);
+                thread_ptr->state.store(ThreadState::kStop);
+                thread_ptr->exited = true;
+                --this->thread_num_;
             }
-            cout << "thread id " << thread_ptr->id.load() << " running end" << endl;
+            this->worker_cv_.notify_all();
         };
-        thread_ptr->ptr = std::make_shared<std::thread>(std::move(func));
-        if (thread_ptr->ptr->joinable()) {
-            thread_ptr->ptr->detach();
+        /**
+         * 先计数再在锁外创建线程，多个线程可以同时创建；
+         * adding_thread_num_不为0时JoinWorkers会等这个线程放进worker_threads_
+         */
+        {
+            ThreadPoolLock lock(this->worker_mutex_);
+            ReapExitedThreads();
+            ++this->thread_num_;
+            ++this->adding_thread_num_;
         }
-        this->worker_threads_.emplace_back(std::move(thread_ptr));
+        try {
+            thread_ptr->ptr = std::make_shared<std::thread>(std::move(func));
+        } catch (...) {
+            {
+                ThreadPoolLock lock(this->worker_mutex_);
+                --this->thread_num_;
+                --this->adding_thread_num_;
+            }
+            this->worker_cv_.notify_all();
+            return false;
+        }
+        {
+            ThreadPoolLock lock(this->worker_mutex_);
+            this->worker_threads_.emplace_back(std::move(thread_ptr));
+            --this->adding_thread_num_;
+        }
+        this->worker_cv_.notify_all();
+        return true;
     }
 
     void Resize(int thread_num) {
         if (thread_num < config_.core_threads) return;
-        int old_thread_num = worker_threads_.size();
-        cout << "old num " << old_thread_num << " resize " << thread_num << endl;
+        int old_thread_num = GetTotalThreadSize();
+        Log("old num ", old_thread_num, " resize ", thread_num);
         if (thread_num > old_thread_num) {
             while (thread_num-- > old_thread_num) {
                 AddThread(GetNextThreadId());
             }
         } else {
             int diff = old_thread_num - thread_num;
+            ThreadPoolLock lock(this->worker_mutex_);
             auto iter = worker_threads_.begin();
             while (iter != worker_threads_.end()) {
                 if (diff == 0) {
@@ -265,17 +497,24 @@ class ThreadPool {
                     thread_ptr->state.load() == ThreadState::kWaiting) {  // wait
                     thread_ptr->state.store(ThreadState::kStop);          // stop;
                     --diff;
-                    iter = worker_threads_.erase(iter);
-                } else {
-                    ++iter;
                 }
+                // 线程自己退出后由ReapExitedThreads或JoinWorkers从链表移除并join
+                ++iter;
             }
+            lock.unlock();
             this->task_cv_.notify_all();
         }
     }
 
     int GetNextThreadId() { return this->thread_id_++; }
 
+    template <typename... Args>
+    void Log(const Args &... args) {
+        if (this->config_.verbose) {
+            (cout << ... << args) << endl;
+        }
+    }
+
     bool IsValidConfig(ThreadPoolConfig config) {
         if (config.core_threads < 1 || config.max_threads < config.core_threads || config.time_out.count() < 1) {
             return false;
@@ -284,21 +523,38 @@ class ThreadPool {
     }
 
    private:
+    static constexpr std::size_t kPageSize = 4096;
+    static constexpr std::size_t kPrewarmStackBytes = 64 * 1024;
+
+    // 当前线程所属的线程池，用来识别在工作线程里调用ShutDown的情况
+    static inline thread_local const ThreadPool *current_pool_ = nullptr;
+
     ThreadPoolConfig config_;
 
+    // 工作线程都是joinable的，以下四个由worker_mutex_保护
     std::list<ThreadWrapperPtr> worker_threads_;
+    int adding_thread_num_ = 0;
+    int ready_thread_num_ = 0;
+    int failed_core_num_ = 0;  // 创建失败、永远不会就绪的核心线程个数
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
 
     std::queue<std::function<void()>> tasks_;
     std::mutex task_mutex_;
     std::condition_variable task_cv_;
 
-    std::atomic<int> total_function_num_;
+    // 每次提交都要加，分片避免所有提交线程争同一条缓存行
+    StripedCounter total_function_num_;
     std::atomic<int> waiting_thread_num_;
     std::atomic<int> thread_id_;
+    std::atomic<int> thread_num_;
 
     std::atomic<bool> is_shutdown_now_;
     std::atomic<bool> is_shutdown_;
     std::atomic<bool> is_available_;
+
+    // 最后一个成员，析构时最先注销，Dump不会再访问这个线程池
+    MetricsRegistry::Registration metrics_;
 };
 
 }  // namespace wzq
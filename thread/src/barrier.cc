@@ -0,0 +1,29 @@
+#include "thread/barrier.h"
+#include "thread/futex.h"
+
+#include <utility>
+
+namespace wzq {
+
+Barrier::Barrier(uint32_t count, std::function<void()> completion)
+    : count_(count), completion_(std::move(completion)), arrived_(0), generation_(0) {}
+
+bool Barrier::ArriveAndWait() {
+    // 自己还没到达，这一轮不可能结束，所以读到的一定是当前轮次
+    uint32_t generation = generation_.load(std::memory_order_acquire);
+    if (arrived_.fetch_add(1, std::memory_order_acq_rel) + 1 == count_) {
+        if (completion_) {
+            completion_();
+        }
+        arrived_.store(0, std::memory_order_relaxed);
+        generation_.fetch_add(1, std::memory_order_release);
+        FutexWake(&generation_);
+        return true;
+    }
+    while (generation_.load(std::memory_order_acquire) == generation) {
+        FutexWait(&generation_, generation);
+    }
+    return false;
+}
+
+}  // namespace wzq
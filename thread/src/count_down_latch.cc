@@ -1,33 +1,114 @@
 #include "thread/count_down_latch.h"
-#include <thread>
+#include "thread/futex.h"
+
+#include <cassert>
 #include <chrono>
+#include <thread>
 
 namespace wzq {
 
-CountDownLatch::CountDownLatch(uint32_t count) : count_(count) {}
+namespace {
+// 计数很快就会到0时，先自旋一会儿再睡眠
+constexpr int kSpinCount = 100;
+}  // namespace
+
+CountDownLatch::CountDownLatch(uint32_t count) : count_(count) { assert(count <= kMaxCount); }
 
-void CountDownLatch::CountDown() { 
-  std::unique_lock<std::mutex> lock(mutex_);
-  --count_;
-  if (count_ == 0) {
-    cv_.notify_all();
-  }
+void CountDownLatch::CountDown() {
+    // 已经是0时多调用的CountDown不生效，计数不能减到0以下，否则会借位到标志位
+    uint32_t prev = count_.load(std::memory_order_relaxed);
+    do {
+        if ((prev & kMaxCount) == 0) {
+            return;
+        }
+    } while (!count_.compare_exchange_weak(prev, prev - 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+    if (prev == 1) {
+        FutexWake(&count_);
+    } else if ((prev & kMaxCount) == 1) {
+        /**
+         * 有fiber在等：先取走等待队列，再一次把标志位清掉让计数真正变成0。
+         * 计数变成0后等待方随时可能返回并销毁门闩，之后只能访问局部变量
+         */
+        LockFibers();
+        FiberWaitQueue waiters;
+        fiber_waiters_.MoveTo(waiters);
+        count_.store(0, std::memory_order_release);
+        FutexWake(&count_);
+        waiters.NotifyAll();
+    }
 }
 
-void CountDownLatch::Await(uint32_t time_ms) { 
-   std::unique_lock<std::mutex> lock(mutex_);
-   while (count_ > 0) {
-     if (time_ms > 0) {
-       cv_.wait_for(lock, std::chrono::milliseconds(time_ms));
-     } else {
-       cv_.wait(lock);
-     }
-   }
+bool CountDownLatch::Await(uint32_t time_ms) {
+    if (time_ms == 0 && Fiber::Current() != nullptr) {
+        AwaitInFiber();
+        return true;
+    }
+    for (int i = 0; i < kSpinCount; ++i) {
+        if (count_.load(std::memory_order_acquire) == 0) {
+            return true;
+        }
+        CpuRelax();
+    }
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + std::chrono::milliseconds(time_ms);
+    for (;;) {
+        uint32_t count = count_.load(std::memory_order_acquire);
+        if (count == 0) {
+            return true;
+        }
+        if (time_ms == 0) {
+            FutexWait(&count_, count);
+            continue;
+        }
+        auto remain = deadline - Clock::now();
+        if (remain <= Clock::duration::zero()) {
+            return false;
+        }
+        FutexWait(&count_, count, remain);
+    }
+}
+
+uint32_t CountDownLatch::GetCount() const { return count_.load(std::memory_order_acquire) & kMaxCount; }
+
+void CountDownLatch::LockFibers() {
+    uint32_t count = count_.load(std::memory_order_relaxed);
+    for (;;) {
+        if (count & kFiberLocked) {
+            // 持有者只在登记等待和切出fiber之间持有，很快就会释放
+            std::this_thread::yield();
+            count = count_.load(std::memory_order_relaxed);
+            continue;
+        }
+        if (count_.compare_exchange_weak(count, count | kFiberLocked, std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+            return;
+        }
+    }
 }
 
-uint32_t CountDownLatch::GetCount() const{ 
-  std::unique_lock<std::mutex> lock(mutex_);
-  return count_; 
+void CountDownLatch::AwaitInFiber() {
+    uint32_t count = count_.load(std::memory_order_acquire);
+    for (;;) {
+        if ((count & kMaxCount) == 0) {
+            return;
+        }
+        if (count & kFiberLocked) {
+            std::this_thread::yield();
+            count = count_.load(std::memory_order_acquire);
+            continue;
+        }
+        // 加锁的同时登记有fiber在等，计数已经到0时CAS会失败
+        if (count_.compare_exchange_weak(count, count | kFiberLocked | kFiberWaiting, std::memory_order_acquire,
+                                         std::memory_order_acquire)) {
+            break;
+        }
+    }
+    // 解锁后CountDown才能取走队列；只有最后一次CountDown会唤醒
+    fiber_waiters_.Wait(
+        [](void *count) {
+            static_cast<std::atomic<uint32_t> *>(count)->fetch_and(~kFiberLocked, std::memory_order_release);
+        },
+        &count_);
 }
 
-}  // namespace wzq
\ No newline at end of file
+}  // namespace wzq
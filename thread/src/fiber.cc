@@ -0,0 +1,427 @@
+#include "thread/fiber.h"
+#include "thread/thread_pool.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cassert>
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#define WZQ_FIBER_ASAN 1
+#elif defined(__SANITIZE_THREAD__)
+#define WZQ_FIBER_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define WZQ_FIBER_ASAN 1
+#elif __has_feature(thread_sanitizer)
+#define WZQ_FIBER_TSAN 1
+#endif
+#endif
+
+#if defined(WZQ_FIBER_ASAN)
+#include <sanitizer/common_interface_defs.h>
+#elif defined(WZQ_FIBER_TSAN)
+#include <sanitizer/tsan_interface.h>
+#endif
+
+#if defined(__x86_64__)
+/**
+ * 保存当前的callee-saved寄存器和浮点控制字到当前栈上，*from记下栈顶，切到to保存的栈上恢复。
+ * 新fiber的栈按同样的布局预先填好，ret直接跳到wzq_fiber_trampoline，r12是Fiber*，r13是入口函数
+ */
+extern "C" void wzq_fiber_switch(void **from, void *to);
+
+asm(R"(
+    .text
+    .globl wzq_fiber_switch
+    .hidden wzq_fiber_switch
+    .type wzq_fiber_switch, @function
+wzq_fiber_switch:
+    pushq %rbp
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    pushq %r14
+    pushq %r15
+    subq $16, %rsp
+    stmxcsr 8(%rsp)
+    fnstcw 12(%rsp)
+    movq %rsp, (%rdi)
+    movq %rsi, %rsp
+    ldmxcsr 8(%rsp)
+    fldcw 12(%rsp)
+    addq $16, %rsp
+    popq %r15
+    popq %r14
+    popq %r13
+    popq %r12
+    popq %rbx
+    popq %rbp
+    ret
+    .size wzq_fiber_switch, .-wzq_fiber_switch
+
+    .globl wzq_fiber_trampoline
+    .hidden wzq_fiber_trampoline
+    .type wzq_fiber_trampoline, @function
+wzq_fiber_trampoline:
+    movq %r12, %rdi
+    callq *%r13
+    ud2
+    .size wzq_fiber_trampoline, .-wzq_fiber_trampoline
+)");
+
+extern "C" void wzq_fiber_trampoline();
+#endif
+
+namespace wzq {
+
+namespace {
+
+thread_local Fiber *current_fiber = nullptr;
+
+std::size_t PageSize() {
+    static const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+}
+
+#if defined(__x86_64__)
+void InitContext(Fiber *fiber, void **context, char *stack_top, void (*entry)(Fiber *)) {
+    // 栈顶16字节对齐，ret之后rsp对齐到16，trampoline里call进入口函数时和正常调用一样
+    uintptr_t top = reinterpret_cast<uintptr_t>(stack_top) & ~static_cast<uintptr_t>(15);
+    void **sp = reinterpret_cast<void **>(top - 8 - 64);
+    uint32_t *control = reinterpret_cast<uint32_t *>(sp + 1);
+    control[0] = 0x1f80;  // mxcsr默认值
+    control[1] = 0x037f;  // x87控制字默认值
+    sp[2] = nullptr;                                           // r15
+    sp[3] = nullptr;                                           // r14
+    sp[4] = reinterpret_cast<void *>(entry);                   // r13
+    sp[5] = fiber;                                             // r12
+    sp[6] = nullptr;                                           // rbx
+    sp[7] = nullptr;                                           // rbp
+    sp[8] = reinterpret_cast<void *>(&wzq_fiber_trampoline);   // 返回地址
+    *context = sp;
+}
+
+void SwitchContext(void **from, void **to) { wzq_fiber_switch(from, *to); }
+
+void FreeContext(void *, void *) {}
+#else
+void UcontextEntry(unsigned int hi, unsigned int lo, unsigned int entry_hi, unsigned int entry_lo) {
+    Fiber *fiber = reinterpret_cast<Fiber *>((static_cast<uintptr_t>(hi) << 32) | lo);
+    auto entry = reinterpret_cast<void (*)(Fiber *)>((static_cast<uintptr_t>(entry_hi) << 32) | entry_lo);
+    entry(fiber);
+}
+
+void InitContext(Fiber *fiber, void **context, char *stack_top, std::size_t stack_size, void **return_context,
+                 void (*entry)(Fiber *)) {
+    ucontext_t *ctx = new ucontext_t();
+    getcontext(ctx);
+    ctx->uc_stack.ss_sp = stack_top - stack_size;
+    ctx->uc_stack.ss_size = stack_size;
+    ctx->uc_link = nullptr;
+    uintptr_t arg = reinterpret_cast<uintptr_t>(fiber);
+    uintptr_t func = reinterpret_cast<uintptr_t>(entry);
+    makecontext(ctx, reinterpret_cast<void (*)()>(&UcontextEntry), 4, static_cast<unsigned int>(arg >> 32),
+                static_cast<unsigned int>(arg), static_cast<unsigned int>(func >> 32),
+                static_cast<unsigned int>(func));
+    *context = ctx;
+    *return_context = new ucontext_t();
+}
+
+void SwitchContext(void **from, void **to) {
+    swapcontext(static_cast<ucontext_t *>(*from), static_cast<ucontext_t *>(*to));
+}
+
+void FreeContext(void *context, void *return_context) {
+    delete static_cast<ucontext_t *>(context);
+    delete static_cast<ucontext_t *>(return_context);
+}
+#endif
+
+}  // namespace
+
+Fiber *Fiber::Current() { return current_fiber; }
+
+void Fiber::Yield() {
+    Suspend([](void *fiber) { Schedule(static_cast<Fiber *>(fiber)); }, Current());
+}
+
+void Fiber::Suspend(void (*after)(void *), void *arg) {
+    Fiber *fiber = current_fiber;
+    assert(fiber != nullptr);
+    fiber->after_ = after;
+    fiber->after_arg_ = arg;
+#if defined(WZQ_FIBER_ASAN)
+    __sanitizer_start_switch_fiber(&fiber->fake_stack_, fiber->return_stack_bottom_, fiber->return_stack_size_);
+#elif defined(WZQ_FIBER_TSAN)
+    __tsan_switch_to_fiber(fiber->sanitizer_return_fiber_, 0);
+#endif
+    SwitchContext(&fiber->context_, &fiber->return_context_);
+    // 被Resume切回来，可能已经换了工作线程
+#if defined(WZQ_FIBER_ASAN)
+    __sanitizer_finish_switch_fiber(fiber->fake_stack_, &fiber->return_stack_bottom_, &fiber->return_stack_size_);
+#endif
+}
+
+void Fiber::Park() {
+    Fiber *fiber = current_fiber;
+    Suspend(
+        [](void *arg) {
+            // 已经完全切出去了，Unpark先到的话由这里投递
+            Fiber *fiber = static_cast<Fiber *>(arg);
+            if (fiber->wake_state_.exchange(kParked, std::memory_order_acq_rel) == kNotified) {
+                fiber->wake_state_.store(kRunning, std::memory_order_relaxed);
+                Schedule(fiber);
+            }
+        },
+        fiber);
+}
+
+void Fiber::Unpark(Fiber *fiber) {
+    if (fiber->wake_state_.exchange(kNotified, std::memory_order_acq_rel) == kParked) {
+        fiber->wake_state_.store(kRunning, std::memory_order_relaxed);
+        Schedule(fiber);
+    }
+}
+
+bool Fiber::Schedule(Fiber *fiber) {
+    if (fiber->scheduler_->pool_.Post([fiber]() { Resume(fiber); })) {
+        return true;
+    }
+    // 线程池已经关闭，fiber不会再被恢复，直接销毁，否则Join和调度器的析构会一直等下去
+    fiber->scheduler_->OnFinished(fiber);
+    return false;
+}
+
+void Fiber::Entry(Fiber *fiber) {
+#if defined(WZQ_FIBER_ASAN)
+    __sanitizer_finish_switch_fiber(nullptr, &fiber->return_stack_bottom_, &fiber->return_stack_size_);
+#endif
+    try {
+        fiber->func_();
+    } catch (...) {
+        // 和ThreadPool::Post一样忽略异常
+    }
+    // 捕获的对象在fiber自己的上下文里析构，析构函数里也可以挂起
+    fiber->func_ = nullptr;
+    fiber->finished_ = true;
+#if defined(WZQ_FIBER_ASAN)
+    __sanitizer_start_switch_fiber(nullptr, fiber->return_stack_bottom_, fiber->return_stack_size_);
+#elif defined(WZQ_FIBER_TSAN)
+    __tsan_switch_to_fiber(fiber->sanitizer_return_fiber_, 0);
+#endif
+    SwitchContext(&fiber->context_, &fiber->return_context_);
+    // 结束的fiber不会再被切回来
+    abort();
+}
+
+void Fiber::Resume(Fiber *fiber) {
+    Fiber *prev = current_fiber;
+    current_fiber = fiber;
+#if defined(WZQ_FIBER_ASAN)
+    void *fake_stack = nullptr;
+    char *bottom = static_cast<char *>(fiber->stack_) + PageSize();
+    __sanitizer_start_switch_fiber(&fake_stack, bottom, fiber->scheduler_->stack_size_);
+#elif defined(WZQ_FIBER_TSAN)
+    fiber->sanitizer_return_fiber_ = __tsan_get_current_fiber();
+    __tsan_switch_to_fiber(fiber->sanitizer_fiber_, 0);
+#endif
+    SwitchContext(&fiber->return_context_, &fiber->context_);
+#if defined(WZQ_FIBER_ASAN)
+    __sanitizer_finish_switch_fiber(fake_stack, nullptr, nullptr);
+#endif
+    current_fiber = prev;
+    if (fiber->finished_) {
+        fiber->scheduler_->OnFinished(fiber);
+        return;
+    }
+    // fiber已经完全切出去了，after里把它交给唤醒方之后就可能在别的线程上恢复，不能再访问fiber
+    void (*after)(void *) = fiber->after_;
+    void *arg = fiber->after_arg_;
+    fiber->after_ = nullptr;
+    fiber->after_arg_ = nullptr;
+    if (after != nullptr) {
+        after(arg);
+    }
+}
+
+FiberScheduler::FiberScheduler(ThreadPool &pool, std::size_t stack_size)
+    : pool_(pool), stack_size_((stack_size + PageSize() - 1) / PageSize() * PageSize()) {}
+
+FiberScheduler::~FiberScheduler() {
+    Join();
+    for (void *stack : free_stacks_) {
+        munmap(stack, stack_size_ + PageSize());
+    }
+}
+
+bool FiberScheduler::Spawn(std::function<void()> func) {
+    void *stack = AllocateStack();
+    if (stack == nullptr) {
+        return false;
+    }
+    Fiber *fiber = new Fiber();
+    fiber->scheduler_ = this;
+    fiber->func_ = std::move(func);
+    fiber->stack_ = stack;
+    char *stack_top = static_cast<char *>(stack) + PageSize() + stack_size_;
+#if defined(__x86_64__)
+    InitContext(fiber, &fiber->context_, stack_top, &Fiber::Entry);
+#else
+    InitContext(fiber, &fiber->context_, stack_top, stack_size_, &fiber->return_context_, &Fiber::Entry);
+#endif
+#if defined(WZQ_FIBER_TSAN)
+    fiber->sanitizer_fiber_ = __tsan_create_fiber(0);
+#endif
+    {
+        std::unique_lock<std::mutex> lock(alive_mutex_);
+        ++alive_;
+    }
+    return Fiber::Schedule(fiber);
+}
+
+std::size_t FiberScheduler::Alive() const {
+    std::unique_lock<std::mutex> lock(alive_mutex_);
+    return alive_;
+}
+
+void FiberScheduler::Join() {
+    std::unique_lock<std::mutex> lock(alive_mutex_);
+    alive_cv_.wait(lock, [this]() { return alive_ == 0; });
+}
+
+void *FiberScheduler::AllocateStack() {
+    {
+        std::unique_lock<std::mutex> lock(stack_mutex_);
+        if (!free_stacks_.empty()) {
+            void *stack = free_stacks_.back();
+            free_stacks_.pop_back();
+            return stack;
+        }
+    }
+    // 只保留地址空间，用到的页才真正分配
+    std::size_t size = stack_size_ + PageSize();
+    void *stack = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stack == MAP_FAILED) {
+        return nullptr;
+    }
+    if (mprotect(stack, PageSize(), PROT_NONE) != 0) {
+        munmap(stack, size);
+        return nullptr;
+    }
+    return stack;
+}
+
+void FiberScheduler::FreeStack(void *stack) {
+    {
+        std::unique_lock<std::mutex> lock(stack_mutex_);
+        if (free_stacks_.size() < kMaxCachedStacks) {
+            free_stacks_.push_back(stack);
+            return;
+        }
+    }
+    munmap(stack, stack_size_ + PageSize());
+}
+
+void FiberScheduler::OnFinished(Fiber *fiber) {
+#if defined(WZQ_FIBER_TSAN)
+    __tsan_destroy_fiber(fiber->sanitizer_fiber_);
+#endif
+    FreeContext(fiber->context_, fiber->return_context_);
+    FreeStack(fiber->stack_);
+    delete fiber;
+    // 在锁里通知，Join返回(调度器可能随即析构)之前这里已经不再访问成员
+    std::unique_lock<std::mutex> lock(alive_mutex_);
+    if (--alive_ == 0) {
+        alive_cv_.notify_all();
+    }
+}
+
+void FiberWaitQueue::Wait(std::unique_lock<std::mutex> &lock) {
+    Wait([](void *lock) { static_cast<std::unique_lock<std::mutex> *>(lock)->unlock(); }, &lock);
+    lock.lock();
+}
+
+void FiberWaitQueue::Wait(void (*unlock)(void *), void *arg) {
+    Fiber *fiber = Fiber::Current();
+    assert(fiber != nullptr);
+    // 登记之前就设好，解锁之后到挂起之前的Unpark会留下kNotified
+    fiber->wake_state_.store(Fiber::kParking, std::memory_order_relaxed);
+    fiber->wait_next_ = nullptr;
+    if (tail_ == nullptr) {
+        head_ = tail_ = fiber;
+    } else {
+        tail_->wait_next_ = fiber;
+        tail_ = fiber;
+    }
+    unlock(arg);
+    Fiber::Park();
+}
+
+void FiberWaitQueue::MoveTo(FiberWaitQueue &other) {
+    other.head_ = head_;
+    other.tail_ = tail_;
+    head_ = tail_ = nullptr;
+}
+
+bool FiberWaitQueue::NotifyOne() {
+    Fiber *fiber = head_;
+    if (fiber == nullptr) {
+        return false;
+    }
+    head_ = fiber->wait_next_;
+    if (head_ == nullptr) {
+        tail_ = nullptr;
+    }
+    fiber->wait_next_ = nullptr;
+    Fiber::Unpark(fiber);
+    return true;
+}
+
+void FiberWaitQueue::NotifyAll() {
+    while (NotifyOne()) {
+    }
+}
+
+void FiberMutex::Lock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!locked_) {
+        locked_ = true;
+        return;
+    }
+    if (Fiber::Current() != nullptr) {
+        // Unlock直接把锁交给被唤醒的fiber，locked_一直是true
+        fiber_waiters_.Wait(lock);
+        return;
+    }
+    ++thread_waiters_;
+    thread_cv_.wait(lock, [this]() { return !locked_; });
+    --thread_waiters_;
+    locked_ = true;
+}
+
+bool FiberMutex::TryLock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (locked_) {
+        return false;
+    }
+    locked_ = true;
+    return true;
+}
+
+void FiberMutex::Unlock() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (fiber_waiters_.NotifyOne()) {
+        return;
+    }
+    locked_ = false;
+    if (thread_waiters_ > 0) {
+        thread_cv_.notify_one();
+    }
+}
+
+}  // namespace wzq
@@ -0,0 +1,53 @@
+#include "thread/semaphore.h"
+#include "thread/futex.h"
+
+#include <chrono>
+
+namespace wzq {
+
+Semaphore::Semaphore(uint32_t count) : count_(count), waiters_(0) {}
+
+bool Semaphore::TryAcquire() {
+    uint32_t count = count_.load(std::memory_order_relaxed);
+    while (count > 0) {
+        if (count_.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Semaphore::Acquire() {
+    while (!TryAcquire()) {
+        // 先登记再检查，Release看到waiters_就一定会唤醒；count_已经不是0时FutexWait直接返回
+        waiters_.fetch_add(1);
+        FutexWait(&count_, 0);
+        waiters_.fetch_sub(1);
+    }
+}
+
+bool Semaphore::TryAcquireFor(uint32_t time_ms) {
+    using Clock = std::chrono::steady_clock;
+    const auto deadline = Clock::now() + std::chrono::milliseconds(time_ms);
+    while (!TryAcquire()) {
+        auto remain = deadline - Clock::now();
+        if (remain <= Clock::duration::zero()) {
+            return false;
+        }
+        waiters_.fetch_add(1);
+        FutexWait(&count_, 0, remain);
+        waiters_.fetch_sub(1);
+    }
+    return true;
+}
+
+void Semaphore::Release(uint32_t num) {
+    count_.fetch_add(num);
+    if (waiters_.load() > 0) {
+        FutexWake(&count_, static_cast<int>(num));
+    }
+}
+
+uint32_t Semaphore::GetCount() const { return count_.load(std::memory_order_relaxed); }
+
+}  // namespace wzq
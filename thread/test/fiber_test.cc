@@ -0,0 +1,224 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "thread/fiber.h"
+#include "thread/thread_pool.h"
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::abort();                                                                 \
+        }                                                                                 \
+    } while (0)
+
+// 只有一个工作线程时Yield按投递顺序轮转：每个fiber执行一步就排到队尾
+void TestYieldOrder() {
+    wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{1, 1, 0, std::chrono::seconds(10)});
+    CHECK(pool.Start());
+    std::string trace;
+    {
+        wzq::FiberScheduler scheduler(pool);
+        // 先占住唯一的工作线程，三个fiber都投递完再一起开始
+        std::promise<void> start;
+        std::shared_future<void> started = start.get_future().share();
+        CHECK(pool.Post([started]() { started.wait(); }));
+        for (char id = 'a'; id <= 'c'; ++id) {
+            CHECK(scheduler.Spawn([&trace, id]() {
+                CHECK(wzq::Fiber::Current() != nullptr);
+                for (int step = 0; step < 3; ++step) {
+                    trace += id;
+                    trace += static_cast<char>('0' + step);
+                    wzq::Fiber::Yield();
+                }
+            }));
+        }
+        CHECK(scheduler.Alive() == 3);
+        start.set_value();
+        scheduler.Join();
+        CHECK(scheduler.Alive() == 0);
+    }
+    pool.ShutDown();
+    std::printf("yield order: %s\n", trace.c_str());
+    CHECK(trace == "a0b0c0a1b1c1a2b2c2");
+    CHECK(wzq::Fiber::Current() == nullptr);
+}
+
+struct Parked {
+    wzq::Fiber *fiber = nullptr;
+    std::atomic<bool> suspended{false};
+};
+
+// Suspend切出去之后才调用after，别的线程Schedule之后接着执行，栈上的局部变量还在
+void TestSuspendResume() {
+    wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{2, 2, 0, std::chrono::seconds(10)});
+    CHECK(pool.Start());
+    Parked parked;
+    std::atomic<int> step{0};
+    std::atomic<int> local_after{0};
+    {
+        wzq::FiberScheduler scheduler(pool);
+        CHECK(scheduler.Spawn([&parked, &step, &local_after]() {
+            int local = 42;
+            parked.fiber = wzq::Fiber::Current();
+            step.store(1);
+            wzq::Fiber::Suspend([](void *arg) { static_cast<Parked *>(arg)->suspended.store(true); }, &parked);
+            local_after.store(local);
+            step.store(2);
+        }));
+        while (!parked.suspended.load()) {
+            std::this_thread::yield();
+        }
+        // 挂起期间不会自己恢复
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(step.load() == 1 && scheduler.Alive() == 1);
+        CHECK(wzq::Fiber::Schedule(parked.fiber));
+        scheduler.Join();
+    }
+    pool.ShutDown();
+    CHECK(step.load() == 2);
+    CHECK(local_after.load() == 42);
+}
+
+// 很多fiber在两个工作线程上交替执行，用FiberMutex保护的计数不会丢
+void TestManyFibers() {
+    constexpr int kFibers = 1000;
+    constexpr int kRounds = 20;
+    wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{2, 2, 0, std::chrono::seconds(10)});
+    CHECK(pool.Start());
+    wzq::FiberMutex mutex;
+    int64_t counter = 0;
+    {
+        wzq::FiberScheduler scheduler(pool);
+        for (int i = 0; i < kFibers; ++i) {
+            CHECK(scheduler.Spawn([&mutex, &counter]() {
+                for (int round = 0; round < kRounds; ++round) {
+                    std::lock_guard<wzq::FiberMutex> lock(mutex);
+                    int64_t value = counter;
+                    // 拿着锁让出，别的fiber要等锁
+                    wzq::Fiber::Yield();
+                    counter = value + 1;
+                }
+            }));
+        }
+        scheduler.Join();
+    }
+    pool.ShutDown();
+    CHECK(counter == kFibers * kRounds);
+}
+
+// 在栈上用掉大约bytes字节
+int UseStack(std::size_t bytes) {
+    volatile char buf[1024];
+    for (std::size_t i = 0; i < sizeof(buf); ++i) {
+        buf[i] = static_cast<char>(i);
+    }
+    if (bytes <= sizeof(buf)) {
+        return buf[bytes % sizeof(buf)];
+    }
+    return UseStack(bytes - sizeof(buf)) + buf[7];
+}
+
+constexpr std::size_t kStackSize = 64 * 1024;
+
+// /proc/self/maps里addr所在映射的正下方是否紧挨着一页不可访问的映射
+bool GuardPageBelow(const void *addr) {
+    FILE *maps = std::fopen("/proc/self/maps", "r");
+    CHECK(maps != nullptr);
+    const uintptr_t target = reinterpret_cast<uintptr_t>(addr);
+    std::vector<std::pair<uintptr_t, uintptr_t>> none;
+    uintptr_t start = 0;
+    char line[512];
+    while (std::fgets(line, sizeof(line), maps) != nullptr) {
+        unsigned long begin = 0;
+        unsigned long end = 0;
+        char perms[8] = {};
+        if (std::sscanf(line, "%lx-%lx %7s", &begin, &end, perms) != 3) {
+            continue;
+        }
+        if (begin <= target && target < end) {
+            start = begin;
+        }
+        if (std::string(perms) == "---p") {
+            none.emplace_back(begin, end);
+        }
+    }
+    std::fclose(maps);
+    const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    for (const auto &range : none) {
+        if (range.second == start && range.second - range.first == page) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// fiber栈的最低处是一页保护页
+void TestGuardPage() {
+    wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{1, 1, 0, std::chrono::seconds(10)});
+    CHECK(pool.Start());
+    std::atomic<bool> guarded{false};
+    {
+        wzq::FiberScheduler scheduler(pool, kStackSize);
+        CHECK(scheduler.Spawn([&guarded]() {
+            char local = 0;
+            guarded.store(GuardPageBelow(&local));
+        }));
+        scheduler.Join();
+    }
+    pool.ShutDown();
+    CHECK(guarded.load());
+}
+
+// 在子进程里跑一个用掉stack_bytes字节栈的fiber，返回waitpid的status
+int RunInChild(std::size_t stack_bytes) {
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+        // 去掉sanitizer装的处理函数，按默认动作被信号杀掉
+        signal(SIGSEGV, SIG_DFL);
+        wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{1, 1, 0, std::chrono::seconds(10)});
+        pool.Start();
+        wzq::FiberScheduler scheduler(pool, kStackSize);
+        scheduler.Spawn([stack_bytes]() { UseStack(stack_bytes); });
+        scheduler.Join();
+        pool.ShutDown();
+        _exit(0);
+    }
+    int status = 0;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    return status;
+}
+
+// 用到栈的一半没问题；超出栈大小的递归碰到保护页直接SIGSEGV
+void TestStackOverflow() {
+    int status = RunInChild(kStackSize / 2);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    status = RunInChild(kStackSize * 4);
+    CHECK(WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV);
+}
+
+int main() {
+    // 先fork，子进程里没有别的测试留下的线程
+    TestStackOverflow();
+    TestGuardPage();
+    TestYieldOrder();
+    TestSuspendResume();
+    TestManyFibers();
+    std::printf("fiber_test passed\n");
+    return 0;
+}
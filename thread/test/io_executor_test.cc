@@ -0,0 +1,180 @@
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "thread/io_executor.h"
+#include "thread/thread_pool.h"
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::abort();                                                                 \
+        }                                                                                 \
+    } while (0)
+
+using Backend = wzq::IoExecutor::Backend;
+
+// 打开就删掉的临时文件，关闭fd后自动回收
+int TempFile() {
+    char path[] = "/tmp/io_executor_testXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+    return fd;
+}
+
+std::string Pattern(std::size_t len, char seed) {
+    std::string data(len, '\0');
+    for (std::size_t i = 0; i < len; ++i) {
+        data[i] = static_cast<char>(seed + i % 26);
+    }
+    return data;
+}
+
+// 按偏移写、读回、fsync，错误的fd返回-EBADF
+void TestFileRoundTrip(Backend backend) {
+    wzq::IoExecutor::Options options;
+    options.backend = backend;
+    wzq::IoExecutor io(options);
+    int fd = TempFile();
+
+    const std::string data = Pattern(5000, 'a');
+    CHECK(io.Write(fd, data.data(), data.size(), 0).get() == 5000);
+    CHECK(io.Write(fd, data.data(), 100, 5000).get() == 100);
+    std::string back(5100, '\0');
+    CHECK(io.Read(fd, &back[0], back.size(), 0).get() == 5100);
+    CHECK(back.compare(0, 5000, data) == 0 && back.compare(5000, 100, data, 0, 100) == 0);
+    // 读到文件末尾之后返回0
+    CHECK(io.Read(fd, &back[0], 10, 5100).get() == 0);
+    CHECK(io.Fsync(fd).get() == 0);
+    CHECK(io.Fsync(fd, true).get() == 0);
+
+    CHECK(io.Read(-1, &back[0], 1, 0).get() == -EBADF);
+    CHECK(io.Write(-1, data.data(), 1, 0).get() == -EBADF);
+    close(fd);
+}
+
+// offset为-1时用文件当前位置，管道只能这样读写
+void TestPipe(Backend backend) {
+    wzq::IoExecutor::Options options;
+    options.backend = backend;
+    wzq::IoExecutor io(options);
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+    const std::string data = Pattern(300, 'A');
+    CHECK(io.Write(fds[1], data.data(), data.size(), -1).get() == 300);
+    std::string back(300, '\0');
+    CHECK(io.Read(fds[0], &back[0], back.size(), -1).get() == 300);
+    CHECK(back == data);
+
+    // 先提交读，再写，读在写完之后完成
+    std::future<int64_t> pending = io.Read(fds[0], &back[0], 5, -1);
+    CHECK(io.Write(fds[1], "hello", 5, -1).get() == 5);
+    CHECK(pending.get() == 5 && back.compare(0, 5, "hello") == 0);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// 两种后端下固定缓冲区的读写结果一样，只是线程池后端不会注册
+void TestFixedBuffers(Backend backend) {
+    std::vector<char> fixed(8192);
+    wzq::IoExecutor::Options options;
+    options.backend = backend;
+    options.fixed_buffers = {iovec{fixed.data(), fixed.size()}};
+    wzq::IoExecutor io(options);
+    std::printf("backend %d, fixed buffers registered %d\n", static_cast<int>(io.GetBackend()),
+                io.FixedBuffersRegistered() ? 1 : 0);
+    if (io.GetBackend() == Backend::kThreadPool) {
+        CHECK(!io.FixedBuffersRegistered());
+    }
+    int fd = TempFile();
+
+    const std::string data = Pattern(4000, 'k');
+    std::memcpy(fixed.data() + 4096, data.data(), data.size());
+    std::promise<int64_t> written;
+    io.WriteFixed(fd, fixed.data() + 4096, data.size(), 0, 0, [&written](int64_t r) { written.set_value(r); });
+    CHECK(written.get_future().get() == 4000);
+
+    std::promise<int64_t> read;
+    io.ReadFixed(fd, fixed.data() + 100, 3000, 1000, 0, [&read](int64_t r) { read.set_value(r); });
+    CHECK(read.get_future().get() == 3000);
+    CHECK(std::string(fixed.data() + 100, 3000) == data.substr(1000, 3000));
+    close(fd);
+}
+
+// 多个线程同时提交，每个回调恰好执行一次；回调投递到completion_pool；析构等所有操作完成
+void TestConcurrentSubmit(Backend backend) {
+    constexpr int kThreads = 4;
+    constexpr int kOps = 500;
+    static constexpr int kBlock = 64;
+    wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{2, 2, 0, std::chrono::seconds(10)});
+    CHECK(pool.Start());
+    int fd = TempFile();
+    // 写的缓冲区要活到操作完成，比提交线程活得久
+    std::vector<std::string> blocks;
+    for (int t = 0; t < kThreads; ++t) {
+        blocks.emplace_back(kBlock, static_cast<char>('a' + t));
+    }
+    std::atomic<int> completed{0};
+    std::atomic<int> failed{0};
+    {
+        wzq::IoExecutor::Options options;
+        options.backend = backend;
+        options.queue_depth = 32;
+        options.completion_pool = &pool;
+        wzq::IoExecutor io(options);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t]() {
+                for (int i = 0; i < kOps; ++i) {
+                    int64_t offset = static_cast<int64_t>(t * kOps + i) * kBlock;
+                    io.Write(fd, blocks[t].data(), kBlock, offset, [&completed, &failed](int64_t result) {
+                        if (result != kBlock) {
+                            failed.fetch_add(1);
+                        }
+                        completed.fetch_add(1);
+                    });
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+    // 析构返回时操作都完成了，回调可能还在线程池里排队，ShutDown会把它们执行完
+    pool.ShutDown();
+    CHECK(completed.load() == kThreads * kOps);
+    CHECK(failed.load() == 0);
+    std::vector<char> back(kBlock);
+    for (int t = 0; t < kThreads; ++t) {
+        for (int i = 0; i < kOps; ++i) {
+            int64_t offset = static_cast<int64_t>(t * kOps + i) * kBlock;
+            CHECK(pread(fd, back.data(), kBlock, offset) == kBlock);
+            CHECK(back[0] == 'a' + t && back[kBlock - 1] == 'a' + t);
+        }
+    }
+    close(fd);
+}
+
+int main() {
+    for (Backend backend : {Backend::kIoUring, Backend::kThreadPool}) {
+        TestFileRoundTrip(backend);
+        TestPipe(backend);
+        TestFixedBuffers(backend);
+        TestConcurrentSubmit(backend);
+    }
+    std::printf("io_executor_test passed\n");
+    return 0;
+}
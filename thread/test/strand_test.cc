@@ -0,0 +1,178 @@
+#include <pthread.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+#include "thread/strand.h"
+#include "thread/thread_pool.h"
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            std::abort();                                                                 \
+        }                                                                                 \
+    } while (0)
+
+// 什么都不接受的执行器，相当于已经关闭的线程池
+class RejectingExecutor : public wzq::Executor {
+   public:
+    bool Execute(std::function<void()>) override { return false; }
+};
+
+// 多个线程同时投递：任务不并发，每个投递线程自己的任务按投递顺序执行
+void TestOrderAndExclusion(wzq::ThreadPool &pool) {
+    constexpr int kProducers = 4;
+    constexpr int kTasks = 5000;
+    std::vector<int> last(kProducers, -1);
+    std::atomic<int> inside{0};
+    std::atomic<int> overlaps{0};
+    std::atomic<int> disorders{0};
+    std::atomic<int> executed{0};
+    {
+        // last等在Strand之前定义，Strand析构等任务执行完时它们还在
+        wzq::Strand strand(pool);
+        std::vector<std::thread> producers;
+        for (int p = 0; p < kProducers; ++p) {
+            producers.emplace_back([&, p]() {
+                for (int i = 0; i < kTasks; ++i) {
+                    strand.Post([&, p, i]() {
+                        if (inside.fetch_add(1) != 0) {
+                            overlaps.fetch_add(1);
+                        }
+                        if (!strand.RunningInThisThread()) {
+                            overlaps.fetch_add(1);
+                        }
+                        // 不加锁读写last，同一个Strand的任务之间有happens-before
+                        if (last[p] != i - 1) {
+                            disorders.fetch_add(1);
+                        }
+                        last[p] = i;
+                        executed.fetch_add(1);
+                        inside.fetch_sub(1);
+                    });
+                }
+            });
+        }
+        for (auto &producer : producers) {
+            producer.join();
+        }
+        CHECK(!strand.RunningInThisThread());
+    }
+    CHECK(executed.load() == kProducers * kTasks);
+    CHECK(overlaps.load() == 0);
+    CHECK(disorders.load() == 0);
+    for (int p = 0; p < kProducers; ++p) {
+        CHECK(last[p] == kTasks - 1);
+    }
+}
+
+// 析构等已经投递的任务执行完，等的时候不占CPU
+void TestDestructorWaits(wzq::ThreadPool &pool) {
+    std::atomic<bool> done{false};
+    auto start = std::chrono::steady_clock::now();
+    std::clock_t cpu_start = std::clock();
+    {
+        wzq::Strand strand(pool);
+        strand.Post([&done]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            done.store(true);
+        });
+    }
+    auto wall_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    long cpu_ms = static_cast<long>((std::clock() - cpu_start) * 1000 / CLOCKS_PER_SEC);
+    std::printf("destructor waited %lld ms, cpu %ld ms\n", static_cast<long long>(wall_ms), cpu_ms);
+    CHECK(done.load());
+    CHECK(wall_ms >= 190);
+    CHECK(cpu_ms < 100);
+}
+
+// 相同key串行且有序，不同key都能执行
+void TestKeyedStrands(wzq::ThreadPool &pool) {
+    constexpr int kKeys = 32;
+    constexpr int kTasks = 500;
+    std::vector<int> last(kKeys, -1);
+    std::vector<std::atomic<int>> inside(kKeys);
+    std::atomic<int> errors{0};
+    {
+        wzq::KeyedStrands<int> strands(pool, 8);
+        CHECK(strands.Size() == 8);
+        CHECK(&strands.GetStrand(3) == &strands.GetStrand(3 + 8));
+        for (int i = 0; i < kTasks; ++i) {
+            for (int key = 0; key < kKeys; ++key) {
+                strands.Post(key, [&, key, i]() {
+                    if (inside[key].fetch_add(1) != 0 || last[key] != i - 1) {
+                        errors.fetch_add(1);
+                    }
+                    last[key] = i;
+                    inside[key].fetch_sub(1);
+                });
+            }
+        }
+    }
+    CHECK(errors.load() == 0);
+    for (int key = 0; key < kKeys; ++key) {
+        CHECK(last[key] == kTasks - 1);
+    }
+}
+
+// 底层执行器拒绝时在投递线程里循环执行，任务再多栈也不会越来越深；在256KB的栈上跑
+void *RunRejected(void *arg) {
+    auto *executed = static_cast<int64_t *>(arg);
+    RejectingExecutor executor;
+    wzq::Strand strand(executor);
+    for (int i = 0; i < 1000000; ++i) {
+        strand.Post([executed, i]() {
+            if (*executed == i) {
+                ++*executed;
+            }
+        });
+    }
+    return nullptr;
+}
+
+void TestRejectedExecutorRunsInline() {
+    int64_t executed = 0;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 256 * 1024);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, &attr, RunRejected, &executed) == 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+    CHECK(executed == 1000000);
+}
+
+// 线程池关闭之后投递的任务也不会丢
+void TestAfterPoolShutdown() {
+    wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{1, 1, 0, std::chrono::seconds(10)});
+    CHECK(pool.Start());
+    pool.ShutDown();
+    int executed = 0;
+    {
+        wzq::Strand strand(pool);
+        for (int i = 0; i < 100; ++i) {
+            strand.Post([&executed]() { ++executed; });
+        }
+    }
+    CHECK(executed == 100);
+}
+
+int main() {
+    wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{4, 4, 0, std::chrono::seconds(10)});
+    CHECK(pool.Start());
+    TestOrderAndExclusion(pool);
+    TestDestructorWaits(pool);
+    TestKeyedStrands(pool);
+    pool.ShutDown();
+    TestRejectedExecutorRunsInline();
+    TestAfterPoolShutdown();
+    std::printf("strand_test passed\n");
+    return 0;
+}
@@ -7,8 +7,8 @@
 void TestThreadPool() {
     cout << "hello" << endl;
     wzq::ThreadPool pool(wzq::ThreadPool::ThreadPoolConfig{4, 5, 6, std::chrono::seconds(4)});
+    // Start返回时核心线程都已经在等任务了
     pool.Start();
-    std::this_thread::sleep_for(std::chrono::seconds(4));
     cout << "thread size " << pool.GetTotalThreadSize() << endl;
     std::atomic<int> index;
     index.store(0);
@@ -22,7 +22,7 @@ void TestThreadPool() {
             // std::this_thread::sleep_for(std::chrono::seconds(2));
         }
     });
-    t.detach();
+    t.join();
     cout << "=================" << endl;
 
     std::this_thread::sleep_for(std::chrono::seconds(4));
@@ -31,8 +31,9 @@ void TestThreadPool() {
     cout << "thread size " << pool.GetTotalThreadSize() << endl;
     cout << "waiting size " << pool.GetWaitingThreadSize() << endl;
     cout << "---------------" << endl;
-    // pool.ShutDownNow();
-    getchar();
+    // ShutDown返回时剩下的任务都已经执行完，工作线程都已经退出
+    pool.ShutDown();
+    cout << "index " << index.load() << endl;
     cout << "world" << endl;
 }
 
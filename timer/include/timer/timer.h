@@ -1,75 +1,234 @@
 #ifndef __TIMER__
 #define __TIMER__
 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
+#include "common/defer.h"
 #include "common/map.h"
+#include "common/metrics.h"
+#include "common/noncopyable.h"
+#include "common/object_pool.h"
+#include "thread/cancellation.h"
+#include "thread/executor.h"
+#include "thread/fiber.h"
+#include "thread/futex.h"
+#include "thread/mpsc_inbox.h"
 #include "thread/thread_pool.h"
 
 namespace wzq {
+
+/**
+ * 添加定时任务时只把节点放进无锁收件箱(一次CAS)，由分发线程取出放进自己的最小堆。
+ * 只有新任务比分发线程当前等待的到期时间更早时才需要唤醒它(一次系统调用)
+ */
 class TimerQueue {
    public:
+    // 单调时钟，修改系统时间(NTP跳变、手动设置)不会让到期时间提前或推后
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * 分发线程的等待方式：
+     * kFutex: futex带纳秒超时等待最早的到期时间
+     * kTimerFd: CLOCK_MONOTONIC的timerfd(TFD_TIMER_ABSTIME)加epoll，绝对时间到期不受等待前的调度延迟影响，
+     *           以后也可以在同一个epoll里等待其它fd
+     */
+    enum class DispatcherType { kFutex = 0, kTimerFd = 1 };
+
+    /**
+     * 定时任务到期后在哪里执行：
+     * Pool(): 默认，交给内部的线程池
+     * Inline(): 直接在分发线程上执行，适合只是设置标志、往别的队列里放东西的简单回调，
+     *           不能阻塞，否则会推迟其它定时任务
+     * On(executor): 交给调用方的执行器，比如另一个ThreadPool
+     */
+    struct ExecutionPolicy {
+        enum class Kind { kPool = 0, kInline = 1, kExecutor = 2 };
+        Kind kind = Kind::kPool;
+        Executor* executor = nullptr;
+
+        static ExecutionPolicy Pool() { return {Kind::kPool, nullptr}; }
+        static ExecutionPolicy Inline() { return {Kind::kInline, nullptr}; }
+        static ExecutionPolicy On(Executor& executor) { return {Kind::kExecutor, &executor}; }
+    };
+
     struct InternalS {
-        std::chrono::time_point<std::chrono::high_resolution_clock> time_point_;
+        std::chrono::time_point<Clock> time_point_;
         std::function<void()> func_;
-        int repeated_id;
-        bool operator<(const InternalS& b) const { return time_point_ > b.time_point_; }
+        int repeated_id = -1;
+        ExecutionPolicy policy_;
+        CancellationToken token_;
+        InternalS* next_ = nullptr;
     };
 
    public:
     bool Run() {
-        bool ret = thread_pool_.Start();
-        if (!ret) {
+        if (dispatcher_type_ == DispatcherType::kTimerFd && !InitTimerFd()) {
+            return false;
+        }
+        if (own_pool_ != nullptr && !own_pool_->Start()) {
             return false;
         }
-        std::thread([this]() { RunLocal(); }).detach();
+        if (dispatcher_type_ == DispatcherType::kTimerFd) {
+            dispatcher_ = std::thread([this]() { RunTimerFd(); });
+        } else {
+            dispatcher_ = std::thread([this]() { RunLocal(); });
+        }
         return true;
     }
 
-    bool IsAvailable() { return thread_pool_.IsAvailable(); }
+    bool IsAvailable() { return own_pool_ != nullptr ? own_pool_->IsAvailable() : running_.load(); }
 
-    int Size() { return queue_.size(); }
+    // 还没有到期的任务个数
+    int Size() { return size_.load(); }
+
+    // 发布prefix.size(未到期的任务数)、prefix.fired(已经到期分发的任务数)，自己的线程池发布为prefix.pool.xxx
+    void PublishMetrics(const std::string& prefix, MetricsRegistry& registry = MetricsRegistry::Global()) {
+        MetricsRegistry::Registration metrics;
+        metrics.Add(registry, prefix + ".size", [this]() { return Size(); });
+        metrics.Add(registry, prefix + ".fired", [this]() { return fired_.load(std::memory_order_relaxed); });
+        metrics_ = std::move(metrics);
+        if (own_pool_ != nullptr) {
+            own_pool_->PublishMetrics(prefix + ".pool", registry);
+        }
+    }
 
     void Stop() {
         running_.store(false);
-        cond_.notify_all();
-        thread_pool_.ShutDown();
+        Wake();
+        if (dispatcher_.joinable() && dispatcher_.get_id() != std::this_thread::get_id()) {
+            dispatcher_.join();
+        }
+        // 外部的执行器由调用方负责关闭
+        if (own_pool_ != nullptr) {
+            own_pool_->ShutDown();
+        }
     }
 
     template <typename R, typename P, typename F, typename... Args>
     void AddFuncAfterDuration(const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
-        InternalS s;
-        s.time_point_ = std::chrono::high_resolution_clock::now() + time;
-        s.func_ = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-        std::unique_lock<std::mutex> lock(mutex_);
-        queue_.push(s);
-        cond_.notify_all();
+        AddFuncAfterDuration(ExecutionPolicy::Pool(), CancellationToken(), time, std::forward<F>(f),
+                             std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    void AddFuncAfterDuration(ExecutionPolicy policy, const std::chrono::duration<R, P>& time, F&& f,
+                              Args&&... args) {
+        AddFuncAfterDuration(policy, CancellationToken(), time, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // token取消后，还没执行的任务到期时直接丢弃
+    template <typename R, typename P, typename F, typename... Args>
+    void AddFuncAfterDuration(const CancellationToken& token, const std::chrono::duration<R, P>& time, F&& f,
+                              Args&&... args) {
+        AddFuncAfterDuration(ExecutionPolicy::Pool(), token, time, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    void AddFuncAfterDuration(ExecutionPolicy policy, const CancellationToken& token,
+                              const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
+        AddTimer(policy, token, Clock::now() + time, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    }
+
+    template <typename F, typename... Args>
+    void AddFuncAtTimePoint(const std::chrono::time_point<Clock>& time_point, F&& f, Args&&... args) {
+        AddFuncAtTimePoint(ExecutionPolicy::Pool(), CancellationToken(), time_point, std::forward<F>(f),
+                           std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    void AddFuncAtTimePoint(ExecutionPolicy policy, const std::chrono::time_point<Clock>& time_point, F&& f,
+                            Args&&... args) {
+        AddFuncAtTimePoint(policy, CancellationToken(), time_point, std::forward<F>(f), std::forward<Args>(args)...);
     }
 
     template <typename F, typename... Args>
-    void AddFuncAtTimePoint(const std::chrono::time_point<std::chrono::high_resolution_clock>& time_point, F&& f,
+    void AddFuncAtTimePoint(const CancellationToken& token, const std::chrono::time_point<Clock>& time_point, F&& f,
                             Args&&... args) {
-        InternalS s;
-        s.time_point_ = time_point;
-        s.func_ = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-        std::unique_lock<std::mutex> lock(mutex_);
-        queue_.push(s);
-        cond_.notify_all();
+        AddFuncAtTimePoint(ExecutionPolicy::Pool(), token, time_point, std::forward<F>(f),
+                           std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    void AddFuncAtTimePoint(ExecutionPolicy policy, const CancellationToken& token,
+                            const std::chrono::time_point<Clock>& time_point, F&& f, Args&&... args) {
+        AddTimer(policy, token, time_point, std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    }
+
+    /**
+     * 在fiber里调用时只挂起当前fiber，到期后由分发线程重新投递到fiber的线程池，工作线程可以去执行别的任务；
+     * 不在fiber里时就是std::this_thread::sleep_for。队列要一直运行到fiber醒来
+     */
+    template <typename R, typename P>
+    void SleepFor(const std::chrono::duration<R, P>& time) {
+        Fiber* fiber = Fiber::Current();
+        if (fiber == nullptr) {
+            std::this_thread::sleep_for(time);
+            return;
+        }
+        struct SleepArg {
+            TimerQueue* queue;
+            Fiber* fiber;
+            std::chrono::time_point<Clock> time_point;
+        };
+        SleepArg arg{this, fiber, Clock::now() + time};
+        // 切出去之后再添加定时任务，到期时fiber一定已经挂起了
+        Fiber::Suspend(
+            [](void* p) {
+                SleepArg* arg = static_cast<SleepArg*>(p);
+                Fiber* fiber = arg->fiber;
+                arg->queue->AddTimer(ExecutionPolicy::Inline(), CancellationToken(), arg->time_point,
+                                     [fiber]() { Fiber::Schedule(fiber); });
+            },
+            &arg);
     }
 
     template <typename R, typename P, typename F, typename... Args>
     int AddRepeatedFunc(int repeat_num, const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
+        return AddRepeatedFunc(ExecutionPolicy::Pool(), CancellationToken(), repeat_num, time, std::forward<F>(f),
+                               std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    int AddRepeatedFunc(ExecutionPolicy policy, int repeat_num, const std::chrono::duration<R, P>& time, F&& f,
+                        Args&&... args) {
+        return AddRepeatedFunc(policy, CancellationToken(), repeat_num, time, std::forward<F>(f),
+                               std::forward<Args>(args)...);
+    }
+
+    // token取消和CancelRepeatedFuncId效果相同
+    template <typename R, typename P, typename F, typename... Args>
+    int AddRepeatedFunc(const CancellationToken& token, int repeat_num, const std::chrono::duration<R, P>& time, F&& f,
+                        Args&&... args) {
+        return AddRepeatedFunc(ExecutionPolicy::Pool(), token, repeat_num, time, std::forward<F>(f),
+                               std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    int AddRepeatedFunc(ExecutionPolicy policy, const CancellationToken& token, int repeat_num,
+                        const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
         int id = GetNextRepeatedFuncId();
         repeated_id_state_map_.Emplace(id, RepeatedIdState::kRunning);
         auto tem_func = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-        AddRepeatedFuncLocal(repeat_num - 1, time, id, std::move(tem_func));
+        AddRepeatedFuncLocal(policy, token, repeat_num - 1, time, id,
+                             std::make_shared<decltype(tem_func)>(std::move(tem_func)));
         return id;
     }
 
@@ -77,68 +236,491 @@ class TimerQueue {
 
     int GetNextRepeatedFuncId() { return repeated_func_id_++; }
 
-    TimerQueue() : thread_pool_(wzq::ThreadPool::ThreadPoolConfig{4, 4, 40, std::chrono::seconds(4)}) {
+    static constexpr ThreadPool::ThreadPoolConfig kDefaultPoolConfig{4, 4, 40, std::chrono::seconds(4)};
+
+    explicit TimerQueue(DispatcherType dispatcher_type = DispatcherType::kFutex)
+        : TimerQueue(kDefaultPoolConfig, dispatcher_type) {}
+
+    // 自己创建一个按config配置的线程池，Run时启动
+    explicit TimerQueue(const ThreadPool::ThreadPoolConfig& config,
+                        DispatcherType dispatcher_type = DispatcherType::kFutex)
+        : dispatcher_type_(dispatcher_type), own_pool_(new ThreadPool(config)), executor_(own_pool_.get()) {
+        repeated_func_id_.store(0);
+        running_.store(true);
+    }
+
+    /**
+     * 不创建线程池，ExecutionPolicy::Pool()的任务都交给executor(比如已有的ThreadPool)，
+     * executor的生命周期要长于TimerQueue
+     */
+    explicit TimerQueue(Executor& executor, DispatcherType dispatcher_type = DispatcherType::kFutex)
+        : dispatcher_type_(dispatcher_type), executor_(&executor) {
         repeated_func_id_.store(0);
         running_.store(true);
     }
 
-    ~TimerQueue() { Stop(); }
+    /**
+     * 进程内共享的定时器：一个分发线程加一个线程池(核心线程2个，空闲时多出来的线程会被回收)，
+     * 各个模块通过SharedTimerQueue使用它，而不是每个模块都自己创建TimerQueue和线程。
+     * 永不析构，进程退出时其它静态对象的析构里仍然可以使用。
+     * 线程池或分发线程启动失败时抛出std::runtime_error，不会缓存一个不工作的队列，下次调用会重新创建
+     */
+    static TimerQueue& Shared() {
+        static TimerQueue* shared = []() {
+            int max_threads = std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+            std::unique_ptr<TimerQueue> timer(
+                new TimerQueue(ThreadPool::ThreadPoolConfig{2, max_threads, 0, std::chrono::seconds(60)}));
+            if (!timer->Run()) {
+                throw std::runtime_error("TimerQueue::Shared: failed to start the shared timer queue");
+            }
+            return timer.release();
+        }();
+        return *shared;
+    }
+
+    ~TimerQueue() {
+        Stop();
+        for (InternalS* s : heap_) {
+            ObjectPool<InternalS>::Delete(s);
+        }
+        for (InternalS* s = inbox_.TakeAll(); s != nullptr;) {
+            InternalS* next = s->next_;
+            ObjectPool<InternalS>::Delete(s);
+            s = next;
+        }
+        for (int fd : {timer_fd_, wake_fd_, epoll_fd_}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
 
     enum class RepeatedIdState { kInit = 0, kRunning = 1, kStop = 2 };
 
    private:
+    static constexpr int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+
+    static int64_t ToNs(const std::chrono::time_point<Clock>& time_point) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count();
+    }
+
+    struct Later {
+        bool operator()(const InternalS* a, const InternalS* b) const { return a->time_point_ > b->time_point_; }
+    };
+
+    void AddTimer(ExecutionPolicy policy, const CancellationToken& token, const std::chrono::time_point<Clock>& time_point,
+                  std::function<void()> func) {
+        InternalS* s = ObjectPool<InternalS>::New();
+        s->time_point_ = time_point;
+        s->func_ = std::move(func);
+        s->policy_ = policy;
+        s->token_ = token;
+        Push(s);
+    }
+
+    void Push(InternalS* s) {
+        int64_t deadline = ToNs(s->time_point_);
+        size_.fetch_add(1);
+        inbox_.Push(s);
+        // 只有比分发线程正在等的时间更早才唤醒，多个生产者同时更早时只有CAS成功的那个去唤醒
+        int64_t next = next_deadline_.load();
+        while (deadline < next) {
+            if (next_deadline_.compare_exchange_weak(next, deadline)) {
+                Wake();
+                break;
+            }
+        }
+    }
+
+    void Wake() {
+        if (wake_fd_ >= 0) {
+            uint64_t one = 1;
+            ssize_t ret = write(wake_fd_, &one, sizeof(one));
+            (void)ret;
+            return;
+        }
+        wake_seq_.fetch_add(1);
+        FutexWake(&wake_seq_, 1);
+    }
+
+    void Execute(InternalS* s) {
+        if (s->token_.IsCancelled()) {
+            if (s->repeated_id >= 0) {
+                repeated_id_state_map_.EraseKey(s->repeated_id);
+            }
+            return;
+        }
+        if (s->token_.CanBeCancelled() && s->policy_.kind != ExecutionPolicy::Kind::kInline && s->repeated_id < 0) {
+            // 交给其它线程后到真正执行之间也可能被取消；周期任务在自己的回调里检查
+            s->func_ = [token = std::move(s->token_), func = std::move(s->func_)]() {
+                if (!token.IsCancelled()) {
+                    func();
+                }
+            };
+        }
+        switch (s->policy_.kind) {
+            case ExecutionPolicy::Kind::kInline:
+                try {
+                    s->func_();
+                } catch (...) {
+                    // 和交给线程池执行时一样，回调抛出的异常被忽略
+                }
+                break;
+            case ExecutionPolicy::Kind::kExecutor:
+                s->policy_.executor->Execute(std::move(s->func_));
+                break;
+            default:
+                executor_->Execute(std::move(s->func_));
+                break;
+        }
+    }
+
+    // 取出收件箱里的新任务，执行到期的任务，发布并返回最早的到期时间
+    int64_t DispatchOnce() {
+        for (InternalS* s = inbox_.TakeAll(); s != nullptr;) {
+            InternalS* next = s->next_;
+            heap_.push_back(s);
+            std::push_heap(heap_.begin(), heap_.end(), Later());
+            s = next;
+        }
+        auto now = Clock::now();
+        while (!heap_.empty() && heap_.front()->time_point_ <= now) {
+            std::pop_heap(heap_.begin(), heap_.end(), Later());
+            InternalS* s = heap_.back();
+            heap_.pop_back();
+            size_.fetch_sub(1);
+            fired_.fetch_add(1, std::memory_order_relaxed);
+            Execute(s);
+            ObjectPool<InternalS>::Delete(s);
+        }
+        int64_t next_deadline = heap_.empty() ? kNoDeadline : ToNs(heap_.front()->time_point_);
+        next_deadline_.store(next_deadline);
+        return next_deadline;
+    }
+
+    /**
+     * 先读wake_seq_再检查收件箱和running_：在这之后的Wake都会改变wake_seq_，FutexWait会立即返回，不会丢唤醒。
+     * 发布next_deadline_之后再检查一次收件箱，覆盖生产者读到旧的next_deadline_而没有唤醒的情况
+     */
     void RunLocal() {
-        while (running_.load()) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            if (queue_.empty()) {
-                cond_.wait(lock);
+        for (;;) {
+            uint32_t seq = wake_seq_.load();
+            if (!running_.load()) {
+                break;
+            }
+            int64_t next_deadline = DispatchOnce();
+            if (!inbox_.Empty()) {
                 continue;
             }
-            auto s = queue_.top();
-            auto diff = s.time_point_ - std::chrono::high_resolution_clock::now();
-            if (std::chrono::duration_cast<std::chrono::milliseconds>(diff).count() > 0) {
-                cond_.wait_for(lock, diff);
+            if (next_deadline == kNoDeadline) {
+                FutexWait(&wake_seq_, seq);
                 continue;
-            } else {
-                queue_.pop();
-                lock.unlock();
-                thread_pool_.Run(std::move(s.func_));
+            }
+            int64_t wait = next_deadline - ToNs(Clock::now());
+            if (wait > 0) {
+                FutexWait(&wake_seq_, seq, std::chrono::nanoseconds(wait));
+            }
+        }
+    }
+
+    bool InitTimerFd() {
+        if (epoll_fd_ >= 0) {
+            return true;
+        }
+        int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+        int wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (epoll_fd < 0 || timer_fd < 0 || wake_fd < 0) {
+            for (int fd : {epoll_fd, timer_fd, wake_fd}) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            return false;
+        }
+        for (int fd : {timer_fd, wake_fd}) {
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = fd;
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        }
+        epoll_fd_ = epoll_fd;
+        timer_fd_ = timer_fd;
+        wake_fd_ = wake_fd;
+        return true;
+    }
+
+    // Clock(steady_clock)就是CLOCK_MONOTONIC，到期时间直接作为timerfd的绝对时间，kNoDeadline表示停掉timerfd
+    void ArmTimerFd(int64_t deadline) {
+        itimerspec spec{};
+        if (deadline != kNoDeadline) {
+            // it_value全为0表示停掉，已经过期的时间也至少设成1ns
+            int64_t abs_ns = std::max<int64_t>(deadline, 1);
+            spec.it_value.tv_sec = static_cast<time_t>(abs_ns / 1000000000);
+            spec.it_value.tv_nsec = static_cast<long>(abs_ns % 1000000000);
+        }
+        timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+
+    /**
+     * eventfd的信号在读之前一直有效，所以只要先读掉eventfd再处理收件箱，就不会丢唤醒；
+     * 到期时间没变时不重新设置timerfd
+     */
+    void RunTimerFd() {
+        int64_t armed = kNoDeadline;
+        epoll_event events[2];
+        while (running_.load()) {
+            int64_t next_deadline = DispatchOnce();
+            if (!inbox_.Empty()) {
+                continue;
+            }
+            if (next_deadline != armed) {
+                ArmTimerFd(next_deadline);
+                armed = next_deadline;
+            }
+            int n = epoll_wait(epoll_fd_, events, 2, -1);
+            for (int i = 0; i < n; ++i) {
+                uint64_t value;
+                ssize_t ret = read(events[i].data.fd, &value, sizeof(value));
+                (void)ret;
+                if (events[i].data.fd == timer_fd_) {
+                    armed = kNoDeadline;
+                }
             }
         }
     }
 
     template <typename R, typename P, typename F>
-    void AddRepeatedFuncLocal(int repeat_num, const std::chrono::duration<R, P>& time, int id, F&& f) {
+    void AddRepeatedFuncLocal(ExecutionPolicy policy, const CancellationToken& token, int repeat_num,
+                              const std::chrono::duration<R, P>& time, int id, std::shared_ptr<F> f) {
         if (!this->repeated_id_state_map_.IsKeyExist(id)) {
             return;
         }
-        InternalS s;
-        s.time_point_ = std::chrono::high_resolution_clock::now() + time;
-        auto tem_func = std::move(f);
-        s.repeated_id = id;
-        s.func_ = [this, &tem_func, repeat_num, time, id]() {
-            tem_func();
-            if (!this->repeated_id_state_map_.IsKeyExist(id) || repeat_num == 0) {
+        InternalS* s = ObjectPool<InternalS>::New();
+        s->time_point_ = Clock::now() + time;
+        s->repeated_id = id;
+        s->policy_ = policy;
+        s->token_ = token;
+        s->func_ = [this, policy, token, f, repeat_num, time, id]() {
+            if (token.IsCancelled()) {
+                this->repeated_id_state_map_.EraseKey(id);
                 return;
             }
-            AddRepeatedFuncLocal(repeat_num - 1, time, id, std::move(tem_func));
+            if (!this->repeated_id_state_map_.IsKeyExist(id)) {
+                return;
+            }
+            (*f)();
+            if (repeat_num == 0) {
+                this->repeated_id_state_map_.EraseKey(id);
+                return;
+            }
+            AddRepeatedFuncLocal(policy, token, repeat_num - 1, time, id, f);
         };
-        std::unique_lock<std::mutex> lock(mutex_);
-        queue_.push(s);
-        lock.unlock();
-        cond_.notify_all();
+        Push(s);
     }
 
    private:
-    std::priority_queue<InternalS> queue_;
+    MpscInbox<InternalS> inbox_;
+    // 以下只由分发线程访问
+    std::vector<InternalS*> heap_;
+
+    std::atomic<int64_t> next_deadline_{kNoDeadline};
+    std::atomic<uint32_t> wake_seq_{0};
+    std::atomic<int> size_{0};
+    std::atomic<int64_t> fired_{0};  // 只有分发线程写
     std::atomic<bool> running_;
-    std::mutex mutex_;
-    std::condition_variable cond_;
+    std::thread dispatcher_;
 
-    wzq::ThreadPool thread_pool_;
+    DispatcherType dispatcher_type_;
+    int epoll_fd_ = -1;
+    int timer_fd_ = -1;
+    int wake_fd_ = -1;
+
+    // 为nullptr时使用外部的执行器
+    std::unique_ptr<ThreadPool> own_pool_;
+    Executor* executor_;
 
     std::atomic<int> repeated_func_id_;
     wzq::ThreadSafeMap<int, RepeatedIdState> repeated_id_state_map_;
+
+    MetricsRegistry::Registration metrics_;
+};
+
+/**
+ * 逻辑上独立的定时器队列，所有实例共用同一个TimerQueue(默认是TimerQueue::Shared())的分发线程和线程池。
+ * 添加和取消任务的接口和TimerQueue相同(包括带CancellationToken的重载)。
+ * Stop只影响自己添加的任务：还没执行的不再执行，并等待正在执行的回调结束(在自己的回调里调用Stop时不等待)
+ */
+class SharedTimerQueue : wzq::NonCopyAble {
+   public:
+    using ExecutionPolicy = TimerQueue::ExecutionPolicy;
+
+    explicit SharedTimerQueue(TimerQueue& service = TimerQueue::Shared())
+        : service_(service), state_(std::make_shared<State>()) {}
+
+    ~SharedTimerQueue() { Stop(); }
+
+    bool IsAvailable() { return !state_->stopped.load() && service_.IsAvailable(); }
+
+    // 还没有到期的任务个数，只统计自己添加的
+    int Size() { return state_->pending.load(); }
+
+    void Stop() {
+        state_->stopped.store(true);
+        std::vector<int> ids;
+        {
+            std::unique_lock<std::mutex> lock(state_->mutex);
+            ids.swap(state_->repeated_ids);
+        }
+        for (int id : ids) {
+            service_.CancelRepeatedFuncId(id);
+        }
+        if (current_state_ == state_.get()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->idle_cv.wait(lock, [this]() { return state_->running.load() == 0; });
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    void AddFuncAfterDuration(const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
+        AddFuncAfterDuration(ExecutionPolicy::Pool(), CancellationToken(), time, std::forward<F>(f),
+                             std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    void AddFuncAfterDuration(ExecutionPolicy policy, const std::chrono::duration<R, P>& time, F&& f,
+                              Args&&... args) {
+        AddFuncAfterDuration(policy, CancellationToken(), time, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // token取消后，还没执行的任务到期时直接丢弃
+    template <typename R, typename P, typename F, typename... Args>
+    void AddFuncAfterDuration(const CancellationToken& token, const std::chrono::duration<R, P>& time, F&& f,
+                              Args&&... args) {
+        AddFuncAfterDuration(ExecutionPolicy::Pool(), token, time, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    void AddFuncAfterDuration(ExecutionPolicy policy, const CancellationToken& token,
+                              const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
+        state_->pending.fetch_add(1);
+        service_.AddFuncAfterDuration(policy, time,
+                                      Wrap(true, token, std::forward<F>(f), std::forward<Args>(args)...));
+    }
+
+    template <typename F, typename... Args>
+    void AddFuncAtTimePoint(const std::chrono::time_point<TimerQueue::Clock>& time_point, F&& f, Args&&... args) {
+        AddFuncAtTimePoint(ExecutionPolicy::Pool(), CancellationToken(), time_point, std::forward<F>(f),
+                           std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    void AddFuncAtTimePoint(ExecutionPolicy policy, const std::chrono::time_point<TimerQueue::Clock>& time_point,
+                            F&& f, Args&&... args) {
+        AddFuncAtTimePoint(policy, CancellationToken(), time_point, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    void AddFuncAtTimePoint(const CancellationToken& token,
+                            const std::chrono::time_point<TimerQueue::Clock>& time_point, F&& f, Args&&... args) {
+        AddFuncAtTimePoint(ExecutionPolicy::Pool(), token, time_point, std::forward<F>(f),
+                           std::forward<Args>(args)...);
+    }
+
+    template <typename F, typename... Args>
+    void AddFuncAtTimePoint(ExecutionPolicy policy, const CancellationToken& token,
+                            const std::chrono::time_point<TimerQueue::Clock>& time_point, F&& f, Args&&... args) {
+        state_->pending.fetch_add(1);
+        service_.AddFuncAtTimePoint(policy, time_point,
+                                    Wrap(true, token, std::forward<F>(f), std::forward<Args>(args)...));
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    int AddRepeatedFunc(int repeat_num, const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
+        return AddRepeatedFunc(ExecutionPolicy::Pool(), CancellationToken(), repeat_num, time, std::forward<F>(f),
+                               std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    int AddRepeatedFunc(ExecutionPolicy policy, int repeat_num, const std::chrono::duration<R, P>& time, F&& f,
+                        Args&&... args) {
+        return AddRepeatedFunc(policy, CancellationToken(), repeat_num, time, std::forward<F>(f),
+                               std::forward<Args>(args)...);
+    }
+
+    // token取消和CancelRepeatedFuncId效果相同
+    template <typename R, typename P, typename F, typename... Args>
+    int AddRepeatedFunc(const CancellationToken& token, int repeat_num, const std::chrono::duration<R, P>& time, F&& f,
+                        Args&&... args) {
+        return AddRepeatedFunc(ExecutionPolicy::Pool(), token, repeat_num, time, std::forward<F>(f),
+                               std::forward<Args>(args)...);
+    }
+
+    template <typename R, typename P, typename F, typename... Args>
+    int AddRepeatedFunc(ExecutionPolicy policy, const CancellationToken& token, int repeat_num,
+                        const std::chrono::duration<R, P>& time, F&& f, Args&&... args) {
+        // 周期任务没有pending计数，token直接交给底层队列，取消后不再安排下一次
+        int id = service_.AddRepeatedFunc(policy, token, repeat_num, time,
+                                          Wrap(false, CancellationToken(), std::forward<F>(f),
+                                               std::forward<Args>(args)...));
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->repeated_ids.push_back(id);
+        return id;
+    }
+
+    void CancelRepeatedFuncId(int func_id) {
+        service_.CancelRepeatedFuncId(func_id);
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        auto& ids = state_->repeated_ids;
+        ids.erase(std::remove(ids.begin(), ids.end(), func_id), ids.end());
+    }
+
+   private:
+    // 回调可能在SharedTimerQueue析构之后才到期，状态放在shared_ptr里由回调共同持有
+    struct State {
+        std::atomic<bool> stopped{false};
+        std::atomic<int> pending{0};
+        std::atomic<int> running{0};
+        std::mutex mutex;
+        std::condition_variable idle_cv;  // 停止后running降到0时通知
+        std::vector<int> repeated_ids;
+    };
+
+    /**
+     * one_shot: 一次性任务，执行(或被跳过)时减少pending计数。
+     * 一次性任务的token在这里检查而不交给底层队列，否则底层队列丢弃任务时pending不会减少
+     */
+    template <typename F, typename... Args>
+    std::function<void()> Wrap(bool one_shot, const CancellationToken& token, F&& f, Args&&... args) {
+        return [state = state_, one_shot, token,
+                func = std::bind(std::forward<F>(f), std::forward<Args>(args)...)]() mutable {
+            state->running.fetch_add(1);
+            State* prev = current_state_;
+            WZQ_DEFER {
+                current_state_ = prev;
+                if (one_shot) {
+                    state->pending.fetch_sub(1);
+                }
+                // 只有已经停止时才可能有Stop在等，没停止时不加锁
+                if (state->running.fetch_sub(1) == 1 && state->stopped.load()) {
+                    std::unique_lock<std::mutex> lock(state->mutex);
+                    state->idle_cv.notify_all();
+                }
+            };
+            if (!state->stopped.load() && !token.IsCancelled()) {
+                current_state_ = state.get();
+                func();
+            }
+        };
+    }
+
+   private:
+    // 当前线程正在执行哪个队列的回调，用来识别在回调里调用Stop
+    static inline thread_local State* current_state_ = nullptr;
+
+    TimerQueue& service_;
+    std::shared_ptr<State> state_;
 };
 
 }  // namespace wzq